@@ -14,6 +14,9 @@
 #include <lightwave/registry.hpp>
 
 // MARK: - utilities
+#include <lightwave/arena.hpp>
+#include <lightwave/cache.hpp>
+#include <lightwave/distribution.hpp>
 #include <lightwave/iterators.hpp>
 #include <lightwave/parallel.hpp>
 #include <lightwave/streaming.hpp>
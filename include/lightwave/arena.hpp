@@ -0,0 +1,113 @@
+/**
+ * @file arena.hpp
+ * @brief Contains a simple bump allocator for short-lived temporary data.
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+
+#include <cassert>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A bump allocator that hands out memory from large blocks and frees all of it at once.
+ * This is meant for temporary data that only lives for the duration of a single sample (e.g., path vertices),
+ * where calling @c new and @c delete for each allocation would be wasteful. Objects allocated from the arena
+ * are never destructed, hence only trivially destructible types are supported.
+ * @note The arena is not thread-safe; each thread is expected to use its own arena.
+ */
+class MemoryArena {
+    /// @brief The alignment of each block, which is also the maximum alignment supported for allocations.
+    static constexpr size_t BlockAlignment = 64;
+
+    struct BlockDeleter {
+        void operator()(std::byte *block) const {
+            ::operator delete[](block, std::align_val_t(BlockAlignment));
+        }
+    };
+    using Block = std::unique_ptr<std::byte[], BlockDeleter>;
+
+    /// @brief All blocks allocated so far, the last one being the one we currently allocate from.
+    std::vector<Block> m_blocks;
+    /// @brief The size of the block we currently allocate from.
+    size_t m_blockSize = 0;
+    /// @brief The number of bytes used in the current block.
+    size_t m_offset = 0;
+    /// @brief The total size of all blocks.
+    size_t m_capacity = 0;
+    /// @brief The minimum size of newly allocated blocks.
+    size_t m_minimumBlockSize;
+
+    void allocateBlock(size_t size) {
+        m_blocks.emplace_back(static_cast<std::byte *>(
+            ::operator new[](size, std::align_val_t(BlockAlignment))));
+        m_blockSize = size;
+        m_offset    = 0;
+        m_capacity += size;
+    }
+
+public:
+    /// @brief Creates an arena that allocates memory in blocks of (at least) the given size.
+    explicit MemoryArena(size_t blockSize = 64 * 1024)
+        : m_minimumBlockSize(blockSize) {}
+
+    MemoryArena(MemoryArena &&) = default;
+    MemoryArena &operator=(MemoryArena &&) = default;
+
+    /// @brief Returns uninitialized memory of the given size and alignment.
+    void *allocate(size_t size, size_t alignment = alignof(std::max_align_t)) {
+        assert(alignment <= BlockAlignment);
+        size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+        if (m_blocks.empty() || start + size > m_blockSize) {
+            allocateBlock(std::max(size, m_minimumBlockSize));
+            start = 0;
+        }
+        m_offset = start + size;
+        return m_blocks.back().get() + start;
+    }
+
+    /// @brief Allocates an array of @c count default-initialized objects of type @c T .
+    template <typename T> T *allocate(size_t count) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "the arena does not run destructors");
+        T *result = static_cast<T *>(allocate(count * sizeof(T), alignof(T)));
+        for (size_t i = 0; i < count; i++)
+            new (result + i) T();
+        return result;
+    }
+
+    /// @brief Constructs a single object of type @c T in the arena.
+    template <typename T, typename... Args> T *create(Args &&...args) {
+        static_assert(std::is_trivially_destructible_v<T>,
+                      "the arena does not run destructors");
+        return new (allocate(sizeof(T), alignof(T)))
+            T(std::forward<Args>(args)...);
+    }
+
+    /**
+     * @brief Releases all allocations at once.
+     * The memory is kept around for subsequent allocations. If the previous allocations did not fit into a
+     * single block, the blocks are merged into one so that future use does not need to allocate again.
+     */
+    void reset() {
+        if (m_blocks.size() > 1) {
+            const size_t capacity = m_capacity;
+            m_blocks.clear();
+            m_capacity = 0;
+            allocateBlock(capacity);
+        }
+        m_offset = 0;
+    }
+
+    /// @brief Returns the total amount of memory reserved by this arena in bytes.
+    size_t capacity() const { return m_capacity; }
+};
+
+} // namespace lightwave
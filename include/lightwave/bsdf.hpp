@@ -66,6 +66,31 @@ public:
         NOT_IMPLEMENTED
     }
     virtual Color getAlbedo(const Point2 &uv, const Vector &wo) const {NOT_IMPLEMENTED}
+    /**
+     * @brief Returns how rough the surface appears when seen from @c wo , ranging from zero (perfectly specular) to
+     * one (diffuse, i.e., the reflected radiance does not depend on the viewing direction).
+     * @param uv The texture coordinates of the surface.
+     * @param wo The outgoing direction light is scattered in, pointing away
+     * from the surface, in local coordinates.
+     */
+    virtual float roughness(const Point2 &uv, const Vector &wo) const {
+        return 0;
+    }
+    /**
+     * @brief Returns the probability density (with respect to solid angle) of
+     * @ref sample producing the direction @c wi , in local coordinates.
+     * Directions that can only be sampled by delta components (e.g., perfect
+     * mirrors) have a density of zero.
+     * @param uv The texture coordinates of the surface.
+     * @param wo The outgoing direction light is scattered in, pointing away
+     * from the surface, in local coordinates.
+     * @param wi The incoming direction light comes from, pointing away
+     * from the surface, in local coordinates.
+     */
+    virtual float pdf(const Point2 &uv, const Vector &wo,
+                      const Vector &wi) const {
+        NOT_IMPLEMENTED
+    }
     /**
      * @brief Samples a direction according to the distribution of the Bsdf in
      * local coordinates (i.e., the normal is assumed to be [0,0,1]).
@@ -0,0 +1,104 @@
+/**
+ * @file cache.hpp
+ * @brief Contains a process-wide cache for assets loaded from disk (e.g., meshes and images).
+ */
+
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/logger.hpp>
+
+#include <atomic>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+
+namespace lightwave {
+
+/**
+ * @brief Shares assets that have been loaded from disk, so that objects referencing the same files (e.g., many
+ * shapes of a scene instancing the same mesh, or many scenes rendered in batch mode) do not need to load and
+ * preprocess them again.
+ * Assets are identified by their type, the canonical path of the file they were loaded from and an optional variant
+ * string (for assets that depend on further options), and are reloaded whenever the modification time of the file
+ * changes.
+ * Assets that are still in use are always shared. Keeping assets around once they are no longer used is disabled by
+ * default, as keeping all assets around would only waste memory unless multiple scenes are rendered.
+ */
+class AssetCache {
+    struct Entry {
+        std::filesystem::file_time_type modificationTime;
+        /// @brief Keeps the asset alive while caching is enabled.
+        std::shared_ptr<const void> asset;
+        /// @brief Refers to the asset as long as it is in use.
+        std::weak_ptr<const void> weakAsset;
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_entries;
+    /// @brief Whether unused assets are kept around (atomic, as it is also queried without holding the lock).
+    std::atomic<bool> m_enabled = false;
+
+public:
+    /// @brief Returns the cache shared by the entire process.
+    static AssetCache &global() {
+        static AssetCache cache;
+        return cache;
+    }
+
+    /// @brief Enables or disables keeping unused assets around (disabling also releases all cached assets).
+    void setEnabled(bool enabled) {
+        std::lock_guard lock(m_mutex);
+        m_enabled = enabled;
+        if (!enabled)
+            m_entries.clear();
+    }
+
+    /// @brief Returns whether unused assets are being kept around.
+    bool isEnabled() const { return m_enabled; }
+
+    /**
+     * @brief Returns the asset of type @c T for the given file, invoking @c load to create it if it is neither in use
+     * nor cached (or if the file has been modified since it was loaded).
+     * @note Callers need to hold on to the returned pointer for as long as they use the asset, so that it can be
+     * shared with others.
+     * @param path The file the asset is loaded from.
+     * @param variant Distinguishes different assets of the same type derived from the same file.
+     * @param load A function returning the asset (by value) if it needs to be loaded.
+     */
+    template <typename T, typename Load>
+    std::shared_ptr<const T> get(const std::filesystem::path &path, const std::string &variant, Load &&load) {
+        std::error_code canonicalError, timeError;
+        const auto canonicalPath = std::filesystem::weakly_canonical(path, canonicalError);
+        const auto modificationTime = std::filesystem::last_write_time(path, timeError);
+        const std::string key = std::string(typeid(T).name()) + '|' + (canonicalError ? path : canonicalPath).string() +
+                                '|' + variant;
+
+        {
+            std::lock_guard lock(m_mutex);
+            auto it = m_entries.find(key);
+            if (it != m_entries.end() && !timeError && it->second.modificationTime == modificationTime) {
+                if (auto asset = it->second.weakAsset.lock()) {
+                    logger(EDebug, "reusing cached %s", path);
+                    return std::static_pointer_cast<const T>(asset);
+                }
+            }
+        }
+
+        // load outside of the lock, so that different assets can be loaded concurrently
+        auto asset = std::make_shared<const T>(load());
+        // assets whose file has no modification time cannot be told apart from newer versions, and are not shared
+        if (!timeError) {
+            std::lock_guard lock(m_mutex);
+            // entries of assets that are no longer in use (and not kept around) would otherwise accumulate
+            std::erase_if(m_entries, [](const auto &entry) { return entry.second.weakAsset.expired(); });
+            m_entries[key] = { modificationTime, m_enabled ? asset : nullptr, asset };
+        }
+        return asset;
+    }
+};
+
+}
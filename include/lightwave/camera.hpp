@@ -22,6 +22,37 @@ struct CameraSample {
     Color weight;
 };
 
+/// @brief The result of connecting a point in the scene to a Camera using @ref Camera::sampleImportance .
+struct CameraImportanceSample {
+    /// @brief The direction from the point towards the camera.
+    Vector wi;
+    /// @brief The distance from the point to the camera.
+    float distance;
+    /// @brief The pixel that the point is seen through.
+    Point2i pixel;
+    /**
+     * @brief The importance the camera emits towards the point, divided by the probability of sampling the connection.
+     * Splatting the radiance leaving the point towards the camera times this weight yields an estimate of the image
+     * for a single light path per pixel.
+     */
+    Color weight;
+
+    /// @brief Return an invalid sample, used to denote that the point is not seen by the camera.
+    static CameraImportanceSample invalid() {
+        return {
+            .wi = Vector(),
+            .distance = 0,
+            .pixel = Point2i(),
+            .weight = Color(),
+        };
+    }
+
+    /// @brief Tests whether the sample is invalid (i.e., the point is not seen by the camera).
+    bool isInvalid() const {
+        return weight == Color(0);
+    }
+};
+
 /// @brief A Camera, representing the relationship between pixel coordinates and rays.
 class Camera : public Object {
 protected:
@@ -31,7 +62,15 @@ protected:
     /// @brief The transform that leads from local coordinates to world space coordinates.
     ref<Transform> m_transform;
 
+    /// @brief The number of random numbers drawn for each camera sample, which cameras with a lens raise to
+    /// @ref MaxSampleDimensions .
+    int m_sampleDimensions = 2;
+
 public:
+    /// @brief The maximum number of random numbers drawn for each camera sample: two for the position within the
+    /// pixel, followed by two for the position on the lens (for cameras that have one).
+    static constexpr int MaxSampleDimensions = 4;
+
     Camera(const Properties &properties) {
         m_resolution.x() = properties.get<int>("width");
         m_resolution.y() = properties.get<int>("height");
@@ -45,6 +84,8 @@ public:
      * @brief Helper function to sample the camera model for a given pixel.
      * This function samples a random position within the given pixel, normalizes the pixel coordinates, and
      * then calls the @c CameraSample::sample method for normalized pixel coordinates.
+     * All random numbers of the sample are drawn at once (see @ref MaxSampleDimensions ), using a single call of
+     * @ref Sampler::nextN .
      * 
      * @param pixel The pixel coordinates ranging from [0,0] to [resolution().x() - 1, resolution.y() - 1].
      * @param rng A random number generator used to steer the sampling.
@@ -57,9 +98,30 @@ public:
      * then transforms the ray into world coordinates using the supplied @c m_transform object.
      * 
      * @param normalized Normalized coordinates ranging from [-1, -1] (bottom left of the image) to [+1, +1] (top right of the image).
-     * @param rng A random number generator used to steer the sampling.
+     * @param lensSample A uniformly distributed point in [0,1)^2 that selects the position on the lens (which is
+     * only random for cameras that draw @ref MaxSampleDimensions random numbers).
+     */
+    virtual CameraSample sample(const Point2 &normalized, const Point2 &lensSample) const = 0;
+
+    /**
+     * @brief Connects a point in world space coordinates to the camera, i.e., finds the pixel it is seen through and
+     * the importance the camera emits towards it (which is needed to trace paths starting at light sources).
+     * Cameras that do not support this report all points as invalid.
+     *
+     * @param origin The point that should be connected to the camera.
+     * @param rng A random number generator used to steer the sampling (e.g., of a point on the lens).
+     */
+    virtual CameraImportanceSample sampleImportance(const Point &origin, Sampler &rng) const {
+        return CameraImportanceSample::invalid();
+    }
+
+protected:
+    /**
+     * @brief Finds the pixel corresponding to normalized image coordinates, as the inverse of the mapping used by
+     * @ref sample .
+     * @return Whether the coordinates lie within the image.
      */
-    virtual CameraSample sample(const Point2 &normalized, Sampler &rng) const = 0;
+    bool toPixel(const Point2 &normalized, Point2i &pixel) const;
 };
 
 }
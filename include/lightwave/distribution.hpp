@@ -0,0 +1,178 @@
+/**
+ * @file distribution.hpp
+ * @brief Contains helpers to sample from discrete probability distributions.
+ */
+
+#pragma once
+
+#include <lightwave/math.hpp>
+
+#include <algorithm>
+#include <vector>
+
+namespace lightwave {
+
+/// @brief The largest float that is smaller than one, used to keep remapped random numbers in [0,1).
+static constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+
+/**
+ * @brief Samples indices proportional to a list of non-negative weights in constant time using Walker's alias method.
+ * Each entry of the table is split between the entry itself and one other ("alias") entry, so that sampling only
+ * requires picking a random entry and deciding between it and its alias.
+ * @see "An Efficient Method for Generating Discrete Random Variables with General Distributions" [Walker 1977]
+ */
+class AliasTable {
+    struct Bin {
+        /// @brief The probability of returning this bin (instead of its alias) when the bin is picked.
+        float q;
+        /// @brief The normalized probability of sampling this bin.
+        float pmf;
+        /// @brief The index that is returned if the bin itself is not returned.
+        int alias;
+    };
+
+    std::vector<Bin> m_bins;
+    /// @brief The sum of all weights the table was built from.
+    double m_total = 0;
+
+public:
+    AliasTable() = default;
+
+    /**
+     * @brief Builds an alias table for the given weights.
+     * If all weights are zero, the table falls back to sampling all indices uniformly.
+     */
+    explicit AliasTable(const std::vector<float> &weights) {
+        const int n = int(weights.size());
+        m_bins.resize(n);
+        if (n == 0)
+            return;
+
+        for (float weight : weights)
+            m_total += weight;
+        for (int i = 0; i < n; i++) {
+            m_bins[i].pmf = m_total > 0 ? float(weights[i] / m_total) : 1.f / n;
+        }
+
+        // split the bins into those that have less and more probability mass than the average
+        std::vector<std::pair<int, double>> under, over;
+        for (int i = 0; i < n; i++) {
+            const double scaled = double(m_bins[i].pmf) * n;
+            (scaled < 1 ? under : over).emplace_back(i, scaled);
+        }
+
+        // fill each underfull bin with the excess mass of an overfull bin
+        while (!under.empty() && !over.empty()) {
+            const auto [small, smallMass] = under.back();
+            under.pop_back();
+            auto [large, largeMass] = over.back();
+            over.pop_back();
+
+            m_bins[small].q     = float(smallMass);
+            m_bins[small].alias = large;
+
+            largeMass -= 1 - smallMass;
+            (largeMass < 1 ? under : over).emplace_back(large, largeMass);
+        }
+
+        // remaining bins are (up to round-off) exactly full
+        for (const auto &[index, mass] : under) {
+            m_bins[index].q     = 1;
+            m_bins[index].alias = index;
+        }
+        for (const auto &[index, mass] : over) {
+            m_bins[index].q     = 1;
+            m_bins[index].alias = index;
+        }
+    }
+
+    /**
+     * @brief Samples an index proportional to its weight.
+     * @param rnd A uniformly distributed random number in [0,1).
+     * @param remapped If not null, receives a uniformly distributed random number in [0,1) that is independent of the
+     * sampled index, which allows reusing the random number for subsequent sampling decisions.
+     */
+    int sample(float rnd, float *remapped = nullptr) const {
+        const int n = int(m_bins.size());
+        const float scaled = rnd * n;
+        const int offset = std::min(int(scaled), n - 1);
+        const float up = std::min(scaled - offset, OneMinusEpsilon);
+
+        const Bin &bin = m_bins[offset];
+        if (up < bin.q) {
+            if (remapped)
+                *remapped = std::min(up / bin.q, OneMinusEpsilon);
+            return offset;
+        }
+        if (remapped)
+            *remapped = std::min((up - bin.q) / (1 - bin.q), OneMinusEpsilon);
+        return bin.alias;
+    }
+
+    /// @brief Returns the probability of sampling the given index.
+    float pmf(int index) const { return m_bins[index].pmf; }
+    /// @brief Returns the sum of all weights the table was built from.
+    double total() const { return m_total; }
+    /// @brief Returns the number of entries in the table.
+    int size() const { return int(m_bins.size()); }
+    /// @brief Returns whether the table has no entries.
+    bool empty() const { return m_bins.empty(); }
+};
+
+/**
+ * @brief Samples points in the unit square proportional to a piecewise constant function given on a regular grid.
+ * A row is picked first from the marginal distribution over rows, followed by a cell within that row from the
+ * conditional distribution of that row, and the position within the cell is chosen uniformly.
+ */
+class PiecewiseConstant2D {
+    /// @brief The number of cells in x and y direction.
+    Point2i m_resolution;
+    /// @brief The distribution over rows, proportional to the sum of the cells of each row.
+    AliasTable m_marginal;
+    /// @brief The distribution over cells within each row.
+    std::vector<AliasTable> m_conditional;
+
+public:
+    PiecewiseConstant2D() = default;
+
+    /**
+     * @brief Builds the distribution from non-negative cell values, given in row-major order.
+     * If all values are zero, points are sampled uniformly.
+     */
+    PiecewiseConstant2D(const std::vector<float> &values, const Point2i &resolution)
+        : m_resolution(resolution) {
+        std::vector<float> rowSums(resolution.y());
+        m_conditional.reserve(resolution.y());
+        for (int y = 0; y < resolution.y(); y++) {
+            const auto row = values.begin() + size_t(y) * resolution.x();
+            m_conditional.emplace_back(std::vector<float>(row, row + resolution.x()));
+            rowSums[y] = float(m_conditional.back().total());
+        }
+        m_marginal = AliasTable(rowSums);
+    }
+
+    /**
+     * @brief Samples a point in the unit square.
+     * @param rnd A uniformly distributed random point in [0,1)^2.
+     * @param pdf Receives the probability density of the sampled point with respect to area in the unit square.
+     */
+    Point2 sample(const Point2 &rnd, float &pdf) const {
+        float rx, ry;
+        const int y = m_marginal.sample(rnd.y(), &ry);
+        const int x = m_conditional[y].sample(rnd.x(), &rx);
+        pdf = m_marginal.pmf(y) * m_conditional[y].pmf(x) * m_resolution.x() * m_resolution.y();
+        return { (x + rx) / m_resolution.x(), (y + ry) / m_resolution.y() };
+    }
+
+    /// @brief Returns the probability density of sampling a given point in the unit square.
+    float pdf(const Point2 &point) const {
+        const int x = std::clamp(int(point.x() * m_resolution.x()), 0, m_resolution.x() - 1);
+        const int y = std::clamp(int(point.y() * m_resolution.y()), 0, m_resolution.y() - 1);
+        return m_marginal.pmf(y) * m_conditional[y].pmf(x) * m_resolution.x() * m_resolution.y();
+    }
+
+    /// @brief Returns whether the distribution has been built.
+    bool empty() const { return m_marginal.empty(); }
+};
+
+} // namespace lightwave
@@ -21,15 +21,35 @@ class Image final : public Object {
 
     /// @brief A sequence of the pixel colors of this image.
     std::vector<Color> m_data;
+    /**
+     * @brief The pixels of an image loaded from a file, which are shared with all other images loaded from the same
+     * file (see @ref AssetCache ). They are used instead of @c m_data , and only copied once the image is modified.
+     */
+    std::shared_ptr<const std::vector<Color>> m_sharedData;
 
     /// @brief The folder the image was loaded from or should be stored to.
     std::filesystem::path m_basePath;
 
+    /// @brief Reads the pixels of an image file (bypassing the asset cache).
+    static void readImage(const std::filesystem::path &path, bool isLinearSpace, Point2i &resolution,
+                          std::vector<Color> &pixels);
+
     /**
      * @brief Converts a normalized position from [0,0]..[+1,+1] to a pixel
      * index [0,0]..[resolution.x-1, resolution.y-1]. Input positions outside
      * the unit square will be clamped to the edges.
      */
+    /// @brief Returns the pixels of this image, which might be shared with other images.
+    const std::vector<Color> &pixels() const { return m_sharedData ? *m_sharedData : m_data; }
+    /// @brief Returns the pixels of this image for modification, copying them first if they are shared.
+    std::vector<Color> &modifiablePixels() {
+        if (m_sharedData) {
+            m_data = *m_sharedData;
+            m_sharedData = nullptr;
+        }
+        return m_data;
+    }
+
     Point2i pixelFromNormalized(const Point2 &normalized) const {
         return { std::clamp(int(normalized.x() * m_resolution.x()), 0,
                             m_resolution.x() - 1),
@@ -70,6 +90,7 @@ public:
     void copy(const Image &image) {
         m_resolution = image.m_resolution;
         m_data       = image.m_data;
+        m_sharedData = image.m_sharedData;
     }
 
     /**
@@ -83,6 +104,7 @@ public:
     /// @brief Changes the resolution and sets all pixels to black.
     void initialize(const Point2i &resolution) {
         m_resolution = resolution;
+        m_sharedData = nullptr;
         m_data.resize(resolution.x() * resolution.y());
         std::fill(m_data.begin(), m_data.end(), Color());
     }
@@ -97,7 +119,7 @@ public:
     /// @brief Multiplies the color of all pixels component-wise by a given
     /// scalar.
     void operator*=(float v) {
-        for (auto &pixel : m_data)
+        for (auto &pixel : modifiablePixels())
             pixel *= v;
     }
 
@@ -108,7 +130,7 @@ public:
      * undefined behavior!
      */
     const Color &operator()(const Point2i &pixel) const {
-        return m_data[pixel.y() * m_resolution.x() + pixel.x()];
+        return pixels()[pixel.y() * m_resolution.x() + pixel.x()];
     }
     /**
      * @brief Returns a reference to the color at a given pixel coordinate in
@@ -117,7 +139,7 @@ public:
      * undefined behavior!
      */
     Color &operator()(const Point2i &pixel) {
-        return m_data[pixel.y() * m_resolution.x() + pixel.x()];
+        return modifiablePixels()[pixel.y() * m_resolution.x() + pixel.x()];
     }
 
     /**
@@ -182,10 +204,10 @@ public:
 
     /// @brief Returns a pointer to the sequence of pixels constituting this
     /// image.
-    const Color *data() const { return m_data.data(); }
+    const Color *data() const { return pixels().data(); }
     /// @brief Returns a modifiable pointer to the sequence of pixels
     /// constituting this image.
-    Color *data() { return m_data.data(); }
+    Color *data() { return modifiablePixels().data(); }
 };
 
 } // namespace lightwave
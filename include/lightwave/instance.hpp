@@ -36,9 +36,16 @@ class Instance : public Shape {
     bool m_flipNormal;
     /// @brief Tracks whether this instance has been added to the scene, i.e., could be hit by ray tracing.
     bool m_visible;
+    /// @brief The index of this instance within its scene (see @ref assignInstanceIndices ), which allows identifying
+    /// it in image outputs.
+    int m_index;
     
     /// @brief Transforms the frame from object coordinates to world coordinates.
     inline void transformFrame(SurfaceEvent &surf) const;
+    /// @brief Returns the shading normal perturbed by the normal map, in the coordinates of the surface event.
+    Vector applyNormalMap(const SurfaceEvent &surf) const;
+    /// @brief Completes a hit that has been reported by a nested instance, given the ray in object coordinates.
+    void completeNested(const Ray &localRay, Intersection &its) const;
 
 public:
     Instance(const Properties &properties) 
@@ -52,6 +59,7 @@ public:
 
 
         m_visible = false;
+        m_index = -1;
         
         m_flipNormal = false;
         if (m_transform && m_transform->determinant() < 0) {
@@ -59,12 +67,43 @@ public:
         }
     }
 
+    /// @brief Returns the index of this instance within its scene (or -1 if the scene has not numbered it).
+    int index() const { return m_index; }
+
     /// @brief Returns the material that the shape should be rendered with (can be null for non-reflecting objects).
     Bsdf *bsdf() const { return m_bsdf.get(); }
     /// @brief Returns the distribution of light the shape should emit (can be null for non-emissive objects).
     Emission *emission() const { return m_emission.get(); }
     Texture *alpha() const { return m_alpha.get(); }
 
+    /// @brief Returns the shape wrapped by the instance (null once its geometry has been flattened, see @ref flatten ).
+    Shape *shape() const { return m_shape.get(); }
+    /// @brief Returns the transformation applied to the shape (can be null if the shape is not transformed).
+    Transform *transform() const { return m_transform.get(); }
+
+    /// @brief Replaces the wrapped shape by a simplified version that suffices for the given area on screen (see
+    /// @ref Shape::levelOfDetail ).
+    void selectLevelOfDetail(float pixelArea) {
+        if (ref<Shape> simplified = m_shape->levelOfDetail(pixelArea))
+            m_shape = simplified;
+    }
+
+    /**
+     * @brief Returns whether the wrapped shape can be baked into world coordinates, which is not the case if it is
+     * shaded with a normal map (whose tangent frame would change), masked by an alpha texture, or sampled by an area light.
+     */
+    bool isFlattenable() const { return !m_normal && !m_alpha && !m_light; }
+    /**
+     * @brief Hands the geometry of this instance over to a shape that stores it in world coordinates.
+     * Afterwards, the instance can no longer be intersected itself, and only provides materials to the hits of that
+     * shape (which report this instance as theirs).
+     */
+    void flatten() {
+        m_shape = nullptr;
+        m_transform = nullptr;
+        m_flipNormal = false;
+    }
+
     /// @brief Returns the light object that contains this instance (or null if this instance is not part of any area light).
     Light *light() const { return m_light; }
 
@@ -74,6 +113,18 @@ public:
     void markAsVisible() override {
         m_visible = true;
     }
+    /// @brief Numbers this instance (unless it has already been numbered through another reference) and all
+    /// instances nested within it.
+    void assignInstanceIndices(int &nextIndex) override {
+        if (m_index < 0)
+            m_index = nextIndex++;
+        if (m_shape)
+            m_shape->assignInstanceIndices(nextIndex);
+    }
+    void countAssetUses(std::unordered_map<const void *, int> &uses) const override {
+        if (m_shape)
+            m_shape->countAssetUses(uses);
+    }
 
     /// @brief Sets the parent light object that contains this instance.
     void setLight(Light *light) {
@@ -91,6 +142,12 @@ public:
      * @return @c true if an intersection was found.
      */
     bool intersect(const Ray &ray, Intersection &its, Sampler &rng) const override;
+    /**
+     * @brief Completes the closest intersection found by @ref intersect , which computes the surface of the shape that
+     * was hit and transforms it (along with the normal map) into world coordinates.
+     * @param ray The ray that was intersected, in world coordinates.
+     */
+    void computeSurfaceInteraction(const Ray &ray, Intersection &its) const override;
     /// @brief Returns the bounding box of the instance in world coordinates. 
     Bounds getBoundingBox() const override;
     /// @brief Returns the centroid of the instance in world coordinates. 
@@ -100,7 +157,6 @@ public:
      * @param rng A random number generator used to steer sampling decisions.
      */
     AreaSample sampleArea(Sampler &rng) const override;
-    Vector applyNormal(SurfaceEvent &surf) const;
 
     /// @brief Returns a textual representation of this image.
     std::string toString() const override {
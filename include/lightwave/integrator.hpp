@@ -6,6 +6,7 @@
 #pragma once
 
 #include <lightwave/core.hpp>
+#include <lightwave/arena.hpp>
 #include <lightwave/color.hpp>
 #include <lightwave/math.hpp>
 #include <lightwave/sampler.hpp>
@@ -26,6 +27,85 @@ public:
     }
 };
 
+/**
+ * @brief Computes the weight of a sample when combining two sampling techniques by multiple importance sampling,
+ * using the balance heuristic.
+ * @param pdf The density of the technique that produced the sample.
+ * @param otherPdf The density of the other technique producing the same sample.
+ */
+inline float balanceHeuristic(float pdf, float otherPdf) {
+    return pdf + otherPdf > 0 ? pdf / (pdf + otherPdf) : 0;
+}
+
+/**
+ * @brief Auxiliary quantities ("arbitrary output variables") of the first surface seen by a camera ray, which are
+ * written to additional images alongside the rendered image (e.g., as inputs for denoising).
+ */
+struct AovSample {
+    /// @brief The albedo of the surface (or black if the ray escaped the scene).
+    Color albedo;
+    /// @brief The shading normal of the surface in world coordinates (or zero if the ray escaped the scene).
+    Vector normal;
+    /// @brief The distance from the camera to the surface (or zero if the ray escaped the scene).
+    float distance = 0;
+    /// @brief The index of the instance that was hit (or -1 if the ray escaped the scene).
+    int instanceId = -1;
+    /// @brief Whether the quantities have already been recorded for the current camera sample.
+    bool recorded = false;
+};
+
+/// @brief Sums up the auxiliary quantities of the camera samples of a pixel.
+struct AovSum {
+    Color albedo;
+    /// @brief The sum of the normals remapped to [0,1], like the output of the normals integrator.
+    Color normal;
+    float distance = 0;
+    /// @brief The instance index of the first sample (since averaging indices would be meaningless).
+    int instanceId = -1;
+    /// @brief The number of samples that have been added.
+    int count = 0;
+
+    void add(const AovSample &aov) {
+        albedo += aov.albedo;
+        normal += Color((aov.normal + Vector(1)) / 2);
+        distance += aov.distance;
+        if (count++ == 0) instanceId = aov.instanceId;
+    }
+};
+
+/**
+ * @brief State that is owned by a single worker thread during rendering.
+ * Contexts are created once per thread (instead of once per work item) and handed to each invocation of
+ * @ref SamplingIntegrator::Li on that thread, which allows integrators to reuse resources without any locking.
+ */
+struct RenderContext {
+    /// @brief Statistics that are gathered per thread and summed up after rendering.
+    struct Statistics {
+        /// @brief The number of image blocks rendered by this thread.
+        int64_t blocks = 0;
+        /// @brief The number of camera samples traced by this thread.
+        int64_t samples = 0;
+    };
+
+    /// @brief The index of the worker thread that owns this context.
+    int threadIndex = 0;
+    /// @brief The random number generator used by this thread (a clone of the integrator's sampler).
+    ref<Sampler> sampler;
+    /// @brief Scratch memory for temporary per-sample data, which is released after each sample.
+    MemoryArena arena;
+    /// @brief Counters that are gathered while rendering.
+    Statistics stats;
+    /// @brief The auxiliary outputs of the current camera sample (or @c nullptr if none have been requested).
+    AovSample *aov = nullptr;
+
+    /**
+     * @brief Records the auxiliary outputs for the first intersection of a camera ray.
+     * Integrators should call this with the first intersection they find, so that the intersection does not need
+     * to be recomputed. Subsequent calls for the same camera sample are ignored.
+     */
+    void recordPrimaryHit(const Intersection &its);
+};
+
 /**
  * @brief A sampling integrator uses random numbers to solve the integration problem, e.g., by using Monte Carlo integration.
  */
@@ -37,6 +117,9 @@ protected:
     ref<Image> m_image;
     /// @brief The scene that should be rendered.
     ref<Scene> m_scene;
+    /// @brief Optional auxiliary outputs containing the albedo, normal, distance and instance index of the surfaces
+    /// seen by the camera.
+    ref<Image> m_albedoImage, m_normalsImage, m_distanceImage, m_instanceIdImage;
 
 public:
     SamplingIntegrator(const Properties &properties)
@@ -44,6 +127,10 @@ public:
         m_sampler = properties.getChild<Sampler>();
         m_image = properties.getOptionalChild<Image>();
         m_scene = properties.getChild<Scene>();
+        m_albedoImage = properties.get<Image>("albedo", nullptr);
+        m_normalsImage = properties.get<Image>("normals", nullptr);
+        m_distanceImage = properties.get<Image>("distance", nullptr);
+        m_instanceIdImage = properties.get<Image>("instanceId", nullptr);
     }
 
     /// @brief Sets the output image that should be populated by rendering.
@@ -58,6 +145,30 @@ public:
 
     /// @brief Computes all pixels of the image by constructing camera rays for them and invoking the @ref Li method.
     void execute() override;
+
+protected:
+    /// @brief Allocates the output image (and auxiliary outputs) at the resolution of the camera.
+    void initializeImages();
+    /**
+     * @brief Renders the given range of samples for each pixel, overwriting the output image (and auxiliary outputs)
+     * with their average.
+     * Integrators that render in multiple passes (e.g., to learn from previous passes) can use this in their
+     * @ref execute method to render each pass.
+     */
+    void renderSamples(int firstSample, int sampleCount);
+    /// @brief Writes the output image (and auxiliary outputs) to disk.
+    void saveImages();
+    /// @brief Returns whether any auxiliary outputs have been requested.
+    bool hasAovs() const { return m_albedoImage || m_normalsImage || m_distanceImage || m_instanceIdImage; }
+    /// @brief Overwrites the auxiliary outputs of a pixel with the average of its samples.
+    void writeAovs(const Point2i &pixel, const AovSum &sum);
+    /**
+     * @brief Computes the auxiliary outputs for the given range of samples for each pixel by intersecting the camera
+     * rays with the scene, for integrators whose @ref execute method does not render through @ref renderSamples .
+     */
+    void renderAovs(int firstSample, int sampleCount);
+
+public:
     
     /**
      * @brief Returns (an estimate of) the incident radiance for a given ray.
@@ -66,6 +177,16 @@ public:
      * @ref execute function of the integrator.
      */
     virtual Color Li(const Ray &ray, Sampler &rng) = 0;
+
+    /**
+     * @brief Returns (an estimate of) the incident radiance for a given ray, with access to the state of the
+     * calling thread (e.g., its scratch memory).
+     * By default, this simply invokes @ref Li with the sampler of the context. Integrators that need temporary
+     * memory or gather statistics can override this method instead.
+     */
+    virtual Color Li(const Ray &ray, RenderContext &context) {
+        return Li(ray, *context.sampler);
+    }
 };
 
 }
@@ -19,6 +19,9 @@ struct DirectLightSample {
     Color weight;
     /// @brief The distance from the query point to the sampled point on the light source.
     float distance;
+    /// @brief The density of sampling @c wi with respect to solid angle, which is only reported by light sources that
+    /// can be intersected (as only those need to be weighted against Bsdf sampling).
+    float pdf = 0;
 
     /// @brief Return an invalid sample, used to denote that sampling has failed.
     static DirectLightSample invalid() {
@@ -35,6 +38,55 @@ struct DirectLightSample {
     }
 };
 
+/// @brief The result of sampling a ray leaving a light source using @ref Light::sampleEmission .
+struct EmissionSample {
+    /// @brief The ray leaving the light source.
+    Ray ray;
+    /// @brief The weight of the sample, given by @code Le(ray) * cos(theta) / p(ray) @endcode (i.e., the power carried by the ray).
+    Color weight;
+    /**
+     * @brief The surface point the ray leaves from, with the density of sampling it in area units.
+     * The instance is @c nullptr for light sources without a surface (e.g., point lights), which can not be seen directly.
+     */
+    SurfaceEvent surface;
+
+    /// @brief Return an invalid sample, used to denote that sampling has failed.
+    static EmissionSample invalid() {
+        return {
+            .ray = Ray(),
+            .weight = Color(),
+            .surface = SurfaceEvent(),
+        };
+    }
+
+    /// @brief Tests whether the sample is invalid (i.e., sampling has failed).
+    bool isInvalid() const {
+        return weight == Color(0);
+    }
+};
+
+/**
+ * @brief Conservatively describes where a light source is located, in which directions it emits and how much,
+ * which allows building a hierarchy over light sources (see @ref Scene::sampleLight ).
+ * The emission directions are described by a cone of surface normals (given by @c axis and @c cosThetaO ),
+ * around which light is emitted up to an additional angle of @c acos(cosThetaE) (e.g., @code pi/2 @endcode for
+ * diffuse emitters).
+ */
+struct LightBounds {
+    /// @brief The bounding box of all points that emit light.
+    Bounds bounds;
+    /// @brief The central axis of the cone of surface normals.
+    Vector axis = Vector(0, 0, 1);
+    /// @brief The cosine of the half opening angle of the cone of surface normals.
+    float cosThetaO = -1;
+    /// @brief The cosine of the angle around the surface normal in which light is emitted.
+    float cosThetaE = 0;
+    /// @brief The total power emitted by the light source (as scalar luminance).
+    float phi = 0;
+    /// @brief Whether the light source emits light on both sides of its surface.
+    bool twoSided = false;
+};
+
 /**
  * @brief A light source that can be sampled for direct connections.
  * Some light sources can also be intersected by rays (e.g., area lights or the background light),
@@ -49,8 +101,40 @@ public:
      */
     virtual DirectLightSample sampleDirect(const Point &origin, Sampler &rng) const = 0;
 
+    /**
+     * @brief Samples a random ray leaving the light source, which is needed to trace paths starting at light sources.
+     * Light sources that do not support this report all samples as invalid.
+     * @param sceneBounds The bounding box of the scene, needed by light sources that are infinitely far away (e.g.,
+     * directional lights), which only need to emit rays towards the scene.
+     * @param rng A random number generator used to steer the sampling.
+     */
+    virtual EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const {
+        return EmissionSample::invalid();
+    }
+
     /// @brief Returns whether this light source can be hit by rays (i.e., has an area that has been placed within the scene).
     virtual bool canBeIntersected() const { return false; }
+
+    /**
+     * @brief Returns the probability density (with respect to solid angle) of @ref sampleDirect sampling a point on the
+     * light source that has been found by intersection, which is needed to combine light sampling with Bsdf sampling.
+     * @param origin The light receiving point from which the ray was traced.
+     * @param its The intersection of the ray with the light source.
+     */
+    virtual float pdf(const Point &origin, const Intersection &its) const { return 0; }
+
+    /**
+     * @brief Returns the total power emitted by the light source.
+     * @param sceneBounds The bounding box of the scene, needed by light sources that are infinitely far away (e.g.,
+     * directional lights), whose power is only defined with respect to the region they illuminate.
+     */
+    virtual Color power(const Bounds &sceneBounds) const = 0;
+
+    /**
+     * @brief Returns the spatial and directional bounds of the emission of this light source.
+     * Light sources that are infinitely far away (e.g., directional lights or environment maps) do not have bounds.
+     */
+    virtual std::optional<LightBounds> bounds() const { return std::nullopt; }
 };
 
 /// @brief The result of evaluating a @ref BackgroundLight for a incident direction.
@@ -77,6 +161,14 @@ public:
         return DirectLightSample::invalid();
     }
 
+    /**
+     * @brief Returns the probability density (with respect to solid angle) of @ref sampleDirect sampling a given
+     * direction, which is needed to combine light sampling with Bsdf sampling for rays that escape the scene.
+     * @param direction The direction in world coordinates, pointing away from the scene.
+     */
+    virtual float pdf(const Vector &direction) const { return 0; }
+    using Light::pdf;
+
     bool canBeIntersected() const override { return true; }
 };
 
@@ -737,6 +737,10 @@ struct SurfaceEvent {
     float pdf;
     /// @brief The instance object associated with the surface.
     const Instance *instance = nullptr;
+    /// @brief A color that modulates the material and emission of the surface, which allows shapes to carry colors
+    /// per primitive (e.g., the per-sphere colors of sphere sets). White for most shapes.
+    /// Stored as RGB vector, as @ref Color is defined on top of this header.
+    Vector tint = Vector(1);
 };
 
 /// @brief Describes an intersection of a ray with a surface.
@@ -746,6 +750,18 @@ struct Intersection : public SurfaceEvent {
     /// @brief The intersection distance, which can also be used to specify a maximum distance when querying intersections.
     float t;
     Texture* alphaMasking;
+    /// @brief The innermost shape that was hit (e.g., a triangle mesh rather than a group containing it), which
+    /// completes the intersection via @ref Shape::computeSurfaceInteraction (or null if it has been completed already).
+    const Shape *shape = nullptr;
+    /// @brief The index of the primitive within @ref shape that was hit (e.g., the index of a triangle).
+    int primitiveIndex = -1;
+    /// @brief The barycentric coordinates of the hit within the primitive, for shapes that are made of triangles.
+    Vector2 barycentrics;
+    /// @brief For shapes that place many copies of another shape (see shapes/instances.cpp): the index of the copy
+    /// that was hit, and the innermost shape that was hit within it (which is completed once the transform of the copy
+    /// has been applied).
+    int placementIndex = -1;
+    const Shape *placedShape = nullptr;
     /// @brief Statistics recorded while traversing acceleration structures.
     struct {
         /// @brief The number of BVH nodes that have been tested for intersection.
@@ -771,6 +787,13 @@ struct Intersection : public SurfaceEvent {
     BsdfSample sampleBsdf(Sampler &rng) const;
     /// @brief Evaluates the Bsdf of the underlying surface.
     BsdfEval evaluateBsdf(const Vector &wi) const;
+    /// @brief Returns the albedo of the underlying surface (or its emission if it does not reflect light).
+    Color evaluateAlbedo() const;
+    /// @brief Returns the probability density of @ref sampleBsdf sampling a given direction.
+    float pdfBsdf(const Vector &wi) const;
+    /// @brief Returns the roughness of the underlying surface (see @ref Bsdf::roughness ), or zero if it does not
+    /// reflect light.
+    float evaluateRoughness() const;
 };
 
 /// @brief Print a given point to an output stream.
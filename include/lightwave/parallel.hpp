@@ -5,8 +5,12 @@
 
 #pragma once
 
+#include <algorithm>
+#include <condition_variable>
+#include <functional>
 #include <mutex>
 #include <thread>
+#include <vector>
 
 #include <lightwave/color.hpp>
 #include <lightwave/logger.hpp>
@@ -19,46 +23,166 @@
 
 namespace lightwave {
 
-/// @brief Invokes @c f for each element of the iterator, parallelized across
-/// all available cores.
-template <class ForwardIt, class UnaryFunction>
-void for_each_parallel(ForwardIt first, ForwardIt last, UnaryFunction f) {
+/// @brief Returns the number of worker threads used by @ref for_each_parallel .
+inline int numWorkerThreads() {
 #ifdef SINGLE_THREADED
-    std::for_each(first, last, f);
+    return 1;
+#else
+    return std::max(1u, std::thread::hardware_concurrency());
+#endif
+}
+
+/**
+ * @brief A fixed set of worker threads that lives for the duration of the
+ * process, so that parallel loops (e.g., when rendering many scenes in a row)
+ * do not need to spawn new threads each time.
+ */
+class ThreadPool {
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    /// @brief Serializes jobs that are submitted from different threads.
+    std::mutex m_submitMutex;
+    std::condition_variable m_wakeup;
+    std::condition_variable m_finished;
+    /// @brief The job that the workers currently execute.
+    const std::function<void(int)> *m_job = nullptr;
+    /// @brief Incremented for each job, which allows workers to tell whether
+    /// they have already executed the current job.
+    uint64_t m_generation = 0;
+    /// @brief The number of workers that have not yet finished the current job.
+    int m_running = 0;
+    bool m_shutdown = false;
+
+    /// @brief The index of the calling thread within its thread pool (or -1 if it is not a worker).
+    static inline thread_local int t_workerIndex = -1;
+
+    void work(int index) {
+        t_workerIndex = index;
+        uint64_t generation = 0;
+        std::unique_lock lock(m_mutex);
+        while (true) {
+            m_wakeup.wait(lock, [&] {
+                return m_shutdown || m_generation != generation;
+            });
+            if (m_shutdown)
+                return;
+            generation = m_generation;
+            const auto *job = m_job;
+
+            lock.unlock();
+            (*job)(index);
+            lock.lock();
+
+            if (--m_running == 0)
+                m_finished.notify_all();
+        }
+    }
+
+public:
+    explicit ThreadPool(int numThreads) {
+        m_threads.reserve(numThreads);
+        for (int i = 0; i < numThreads; i++)
+            m_threads.emplace_back(&ThreadPool::work, this, i);
+    }
+
+    ~ThreadPool() {
+        {
+            std::lock_guard lock(m_mutex);
+            m_shutdown = true;
+        }
+        m_wakeup.notify_all();
+        for (auto &thread : m_threads)
+            thread.join();
+    }
+
+    ThreadPool(const ThreadPool &) = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    /// @brief Returns the pool shared by the entire process, which has @ref
+    /// numWorkerThreads threads.
+    static ThreadPool &global() {
+        static ThreadPool pool(numWorkerThreads());
+        return pool;
+    }
+
+    /// @brief Returns the number of worker threads.
+    int size() const { return int(m_threads.size()); }
+
+    /**
+     * @brief Invokes @c job once on each worker thread (with the index of the
+     * thread as argument) and waits until all invocations have returned.
+     * When called from within a worker thread, the job is only invoked on the
+     * calling thread (with the index of that thread, so that per-thread state
+     * is not shared with other workers), as waiting for the other workers
+     * could otherwise deadlock.
+     */
+    void run(const std::function<void(int)> &job) {
+        if (t_workerIndex >= 0) {
+            job(t_workerIndex);
+            return;
+        }
+
+        std::lock_guard submit(m_submitMutex);
+        std::unique_lock lock(m_mutex);
+        m_job     = &job;
+        m_running = size();
+        m_generation++;
+        m_wakeup.notify_all();
+        m_finished.wait(lock, [&] { return m_running == 0; });
+        m_job = nullptr;
+    }
+};
+
+/**
+ * @brief Invokes @c f for each element of the iterator, parallelized across
+ * all available cores.
+ * Each worker thread obtains a state object once by calling @c init with its
+ * thread index (in the range [0, @ref numWorkerThreads ) ), which is then
+ * passed as first argument to all invocations of @c f on that thread. This
+ * allows work items to share expensive per-thread resources without locking.
+ */
+template <class ForwardIt, class ThreadInit, class BinaryFunction>
+void for_each_parallel(ForwardIt first, ForwardIt last, ThreadInit init,
+                       BinaryFunction f) {
+#ifdef SINGLE_THREADED
+    decltype(auto) state = init(0);
+    for (; first != last; ++first)
+        f(state, *first);
     return;
 #endif
 
     std::mutex m_lock;
 
-    const int numThreads = std::thread::hardware_concurrency();
-    std::vector<std::thread> m_threads;
-    m_threads.reserve(numThreads);
-
-    // build a thread pool
-    for (int i = 0; i < numThreads; i++) {
-        m_threads.emplace_back([&]() {
-            while (true) {
-                m_lock.lock();
-                if (!(first != last)) {
-                    // no more work to do
-                    m_lock.unlock();
-                    break;
-                }
-
-                // grab a work item
-                auto obj = *first;
-                ++first;
-                m_lock.unlock();
+    // distribute the work items across the threads of the shared pool
+    ThreadPool::global().run([&](int i) {
+        decltype(auto) state = init(i);
 
-                // execute the work item
-                f(obj);
+        while (true) {
+            m_lock.lock();
+            if (!(first != last)) {
+                // no more work to do
+                m_lock.unlock();
+                break;
             }
-        });
-    }
 
-    // wait until all threads have finished
-    for (auto &thread : m_threads)
-        thread.join();
+            // grab a work item
+            auto obj = *first;
+            ++first;
+            m_lock.unlock();
+
+            // execute the work item
+            f(state, obj);
+        }
+    });
+}
+
+/// @brief Invokes @c f for each element of the iterator, parallelized across
+/// all available cores.
+template <class ForwardIt, class UnaryFunction>
+void for_each_parallel(ForwardIt first, ForwardIt last, UnaryFunction f) {
+    for_each_parallel(
+        first, last, [](int) { return 0; },
+        [&](int, const auto &obj) { f(obj); });
 }
 
 /// @brief Invokes @c f for each element of the iterator, parallelized across
@@ -68,6 +192,13 @@ void for_each_parallel(Iterator it, UnaryFunction f) {
     for_each_parallel(it.begin(), it.end(), f);
 }
 
+/// @brief Invokes @c f for each element of the iterator, parallelized across
+/// all available cores, with a per-thread state created by @c init .
+template <class Iterator, class ThreadInit, class BinaryFunction>
+void for_each_parallel(Iterator it, ThreadInit init, BinaryFunction f) {
+    for_each_parallel(it.begin(), it.end(), init, f);
+}
+
 /// @brief Atomically increment a floating point number.
 inline float atomicAdd(float &dst, float delta) {
 #if defined(__clang__)
@@ -82,7 +213,7 @@ inline float atomicAdd(float &dst, float delta) {
 #endif
         oldVal.f = dst;
         newVal.f = oldVal.f + delta;
-    } while (!__sync_bool_compare_and_swap((volatile int32_t *)&dst, newVal.i, oldVal.i));
+    } while (!__sync_bool_compare_and_swap((volatile int32_t *)&dst, oldVal.i, newVal.i));
     return newVal.f;
 #else
     return std::atomic_ref<float>(dst) += delta;
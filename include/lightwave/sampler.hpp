@@ -10,6 +10,8 @@
 #include <lightwave/math.hpp>
 #include <lightwave/properties.hpp>
 
+#include <span>
+
 namespace lightwave {
 
 /**
@@ -35,6 +37,22 @@ public:
     virtual Point2 next2D() {
         return { next(), next() };
     }
+    /**
+     * @brief Fills the given array with random numbers in the interval [0,1), which is equivalent to invoking
+     * @ref next2D for each pair of its elements (and @ref next for a remaining last element), so that batches keep
+     * the stratification samplers provide for 2D points.
+     * Samplers that can compute random numbers independently of each other should override this to generate the
+     * whole batch at once, which avoids a virtual call per number and allows vectorization.
+     */
+    virtual void nextN(std::span<float> values) {
+        size_t i = 0;
+        for (; i + 1 < values.size(); i += 2) {
+            const Point2 point = next2D();
+            values[i] = point.x();
+            values[i + 1] = point.y();
+        }
+        if (i < values.size()) values[i] = next();
+    }
 
     /**
      * @brief Initiates a random number sequence characterized by the given number.
@@ -48,6 +66,13 @@ public:
      * of random numbers. For different seeds, they are expected to give different random sequences.
      */
     virtual void seed(const Point2i &pixel, int sampleIndex) = 0;
+    /**
+     * @brief Continues the current sample at the given dimension (i.e., the index of the next random number).
+     * Integrators can use this to assign a fixed range of dimensions to each bounce of a path, so that low-discrepancy
+     * samplers stay stratified even when earlier bounces consume a varying number of random numbers, or to continue a
+     * sample with fresh random numbers after seeding it again.
+     */
+    virtual void skipToDimension(int dimension) {}
     /// @brief Returns an identical copy of the sampler, e.g., for use in different threads. 
     virtual ref<Sampler> clone() const = 0;
 
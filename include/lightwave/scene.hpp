@@ -1,11 +1,13 @@
 /**
- * @file sampler.hpp
+ * @file scene.hpp
  * @brief Contains the Scene interface and related structures.
  */
 
 #pragma once
 
 #include <lightwave/core.hpp>
+#include <lightwave/distribution.hpp>
+#include <unordered_map>
 #include <vector>
 
 namespace lightwave {
@@ -16,8 +18,23 @@ struct LightSample {
     const Light *light;
     /// @brief The probability of this light source having been picked.
     float probability;
+
+    /// @brief Returns an invalid sample, used to denote that no light could be picked.
+    static LightSample invalid() {
+        return {
+            .light = nullptr,
+            .probability = 0,
+        };
+    }
+
+    /// @brief Tests whether the sample is invalid (i.e., no light has been picked).
+    bool isInvalid() const {
+        return light == nullptr;
+    }
 };
 
+class LightHierarchy;
+
 /// @brief Scenes are the input to rendering algorithms: They contain all geometry, materials, lights and the camera.
 class Scene : public Object {
     /// @brief The camera from which the image is to be rendered.
@@ -31,6 +48,12 @@ class Scene : public Object {
      * @note Emissive objects will only be part of this list if explicitly requested (i.e., an AreaLight has been created for them).
      */
     std::vector<ref<Light>> m_lights;
+    /// @brief A bounding volume hierarchy over the light sources, used for shading point dependent light selection.
+    ref<LightHierarchy> m_lightHierarchy;
+    /// @brief A distribution over the light sources proportional to their power (empty if lights are selected uniformly).
+    AliasTable m_lightPower;
+    /// @brief The index of each light source within @ref m_lights , needed to look up selection probabilities.
+    std::unordered_map<const Light *, int> m_lightIndices;
 
 public:
     Scene(const Properties &properties);
@@ -50,10 +73,22 @@ public:
     bool hasLights() const { return !m_lights.empty(); }
     /// @brief Reports whether a background light exists. 
     bool hasBackground() const { return m_background != nullptr; }
-    /// @brief Randomly picks a light from the list of sampleable light sources. 
+    /// @brief The background light of the scene (or @c nullptr if there is none).
+    const BackgroundLight *background() const { return m_background.get(); }
+    /// @brief Randomly picks a light from the list of sampleable light sources, proportional to their power (unless the
+    /// scene has been configured to select lights uniformly).
     LightSample sampleLight(Sampler &rng) const;
     /// @brief Returns the probability of randomly picking a light source via @ref sampleLight .
     float lightSelectionProbability(const Light *light) const;
+    /**
+     * @brief Randomly picks a light source, preferring light sources that are likely to contribute strongly to the given
+     * shading point (unless the scene has been configured to select lights uniformly or by power only).
+     * @param origin The shading point for which a light source is needed.
+     * @param normal The surface normal at the shading point (or zero if no normal is available).
+     */
+    LightSample sampleLight(const Point &origin, const Vector &normal, Sampler &rng) const;
+    /// @brief Returns the probability of picking a light source via @ref sampleLight for a given shading point.
+    float lightSelectionProbability(const Light *light, const Point &origin, const Vector &normal) const;
     /// @brief Returns the bounding box of the scene geometry.
     Bounds getBoundingBox() const;
 };
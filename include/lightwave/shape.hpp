@@ -15,6 +15,8 @@
 #include <lightwave/texture.hpp>
 #include <lightwave/transform.hpp>
 
+#include <unordered_map>
+
 namespace lightwave {
 
 /// @brief The result of sampling a random point on a shape's surface via @ref Shape::sampleArea .
@@ -35,6 +37,15 @@ public:
      * @note Intersections farther away than the previous value of @c its.t will be dismissed.
      */
     virtual bool intersect(const Ray &ray, Intersection &its, Sampler &rng) const = 0;
+    /**
+     * @brief Computes the position, texture coordinates, shading frame and area pdf of an intersection found by
+     * @ref intersect .
+     * Since many of the hits found while traversing the scene are later replaced by closer ones, @ref intersect only
+     * records what is needed to find the closest hit (i.e., @c its.t and, if needed, @c its.shape , the primitive and
+     * its barycentric coordinates), and the remaining work is done once for the closest hit by this method.
+     * @param ray The ray that was intersected, in the same coordinates that were passed to @ref intersect .
+     */
+    virtual void computeSurfaceInteraction(const Ray &ray, Intersection &its) const {}
     /// @brief Returns a bounding box that tightly encapsulates the shape. 
     virtual Bounds getBoundingBox() const = 0;
     /**
@@ -55,6 +66,27 @@ public:
      * using a reference.
      */
     virtual void markAsVisible() {}
+    /**
+     * @brief Numbers all instances within this shape (including nested ones) in the order they are encountered, which
+     * identifies them in image outputs (see @ref Instance::index ).
+     * @param nextIndex The index of the next instance, which is advanced for every instance that gets numbered.
+     */
+    virtual void assignInstanceIndices(int &nextIndex) {}
+    /**
+     * @brief Counts the references to the assets within this shape (e.g., the geometry of meshes, which is shared by
+     * all meshes loaded from the same file), including references that are nested within groups or instances.
+     * @param uses The number of references so far, keyed by the address of each asset.
+     */
+    virtual void countAssetUses(std::unordered_map<const void *, int> &uses) const {}
+    /**
+     * @brief Returns a simplified version of this shape that suffices when the shape covers the given area on screen,
+     * or null if the shape should be rendered as is (e.g., because it is close by or has no simplified versions).
+     * @param pixelArea The number of pixels covered by the shape, scaled by the desired quality (which can be thought
+     * of as the number of triangles that should remain per pixel).
+     */
+    virtual ref<Shape> levelOfDetail(float pixelArea) const {
+        return nullptr;
+    }
 };
 
 }
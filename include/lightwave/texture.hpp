@@ -30,6 +30,12 @@ public:
         // we would ideally have a separate texture interface for scalar values)
         return evaluate(uv).r();
     }
+    /**
+     * @brief Returns the resolution at which the texture contains detail (e.g., the size of the underlying image),
+     * which allows tabulating the texture (e.g., for importance sampling) without missing features.
+     * Textures without inherent resolution (e.g., constant textures) return a resolution of 1x1.
+     */
+    virtual Point2i resolution() const { return Point2i(1, 1); }
 };
 
 }
@@ -17,6 +17,8 @@ parser.add_argument('--unsafe', dest='unsafe_tests', action='store_true',
                     help='include unsafe tests')
 parser.add_argument('--disable-build', dest='disable_build', action='store_true',
                     help='do not build lightwave before running the tests')
+parser.add_argument('--batch', dest='batch', action='store_true',
+                    help='run all tests in a single process that shares loaded assets')
 
 args = parser.parse_args()
 root_path = os.path.relpath(os.path.dirname(__file__), os.path.curdir)
@@ -76,6 +78,25 @@ passed_count = 0
 total_count = 0
 
 print()
+if args.batch:
+    r = subprocess.run([ lightwave_path ] + sorted(tests), capture_output=True)
+    output = re.sub(r"\x1b\[[0-9;]*[A-Za-z]", "", r.stdout.decode(errors="replace"))
+    for path, status, seconds in re.findall(r'scene "(.*)" (finished|failed) \(([0-9.]+)s\)', output):
+        test_name = path.replace("\\", "/").split("/")[-2:]
+        test_name = "/".join(test_name).split(".")[0]
+        total_count += 1
+        if status == "finished":
+            print(f"\033[92m✓ {test_name} passed\033[0m ({float(seconds):.2f}s)")
+            passed_count += 1
+        else:
+            print(f"\033[91m⨯ {test_name} failed\033[0m")
+    if total_count < len(tests):
+        # the renderer crashed before finishing all tests
+        print(f"\033[91m⨯ {len(tests) - total_count} tests did not run\033[0m")
+        print("\n".join(r.stderr.decode(errors="replace").split("\n")[-6:-1]))
+        total_count = len(tests)
+    tests = []
+
 for test in sorted(tests):
     test_name = test.replace("\\", "/").split("/")[-2:]
     test_name = "/".join(test_name).split(".")[0]
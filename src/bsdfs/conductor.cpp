@@ -20,6 +20,16 @@ public:
         return BsdfEval::invalid();
     }
 
+    float pdf(const Point2 &uv, const Vector &wo,
+              const Vector &wi) const override {
+        // perfect reflection is a delta distribution
+        return 0;
+    }
+
+    Color getAlbedo(const Point2 &uv, const Vector &wo) const override {
+        return m_reflectance->evaluate(uv);
+    }
+
     BsdfSample sample(const Point2 &uv, const Vector &wo,
                       Sampler &rng) const override {
         BsdfSample b;
@@ -24,6 +24,12 @@ public:
         return BsdfEval::invalid();
     }
 
+    float pdf(const Point2 &uv, const Vector &wo,
+              const Vector &wi) const override {
+        // perfect reflection and refraction are delta distributions
+        return 0;
+    }
+
     BsdfSample sample(const Point2 &uv, const Vector &wo,
                       Sampler &rng) const override {
 
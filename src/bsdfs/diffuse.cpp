@@ -20,18 +20,38 @@ namespace lightwave
             {
                 return BsdfEval::invalid();
             }
-            return BsdfEval{.value = (m_albedo->evaluate(uv) * Frame::cosTheta(wi)) *InvPi};
+            return BsdfEval{.value = (m_albedo->evaluate(uv) * Frame::absCosTheta(wi)) *InvPi};
         }
         Color getAlbedo(const Point2 &uv, const Vector &wo) const override
         {
             return m_albedo->evaluate(uv);
         }
 
+        float roughness(const Point2 &uv, const Vector &wo) const override
+        {
+            return 1;
+        }
+
+        float pdf(const Point2 &uv, const Vector &wo,
+                  const Vector &wi) const override
+        {
+            if (Frame::cosTheta(wi) * Frame::cosTheta(wo) <= 0)
+            {
+                return 0;
+            }
+            return Frame::absCosTheta(wi) * InvPi;
+        }
+
         BsdfSample sample(const Point2 &uv, const Vector &wo,
                           Sampler &rng) const override
         {
             BsdfSample b;
             b.wi = squareToCosineHemisphere(rng.next2D()).normalized();
+            if (Frame::cosTheta(wo) < 0)
+            {
+                // reflect on the side of the surface the light is scattered towards
+                b.wi.z() = -b.wi.z();
+            }
             b.weight = m_albedo->evaluate(uv);
             return b;
         }
@@ -19,6 +19,11 @@ namespace lightwave
             // * you do not need to query a texture, the albedo is given by `color`
         }
 
+        float pdf(const Vector &wo, const Vector &wi) const
+        {
+            return std::max(Frame::cosTheta(wi), 0.f) * InvPi;
+        }
+
         BsdfSample sample(const Vector &wo, Sampler &rng) const
         {
             BsdfSample b;
@@ -45,6 +50,11 @@ namespace lightwave
         {
             //    const auto alpha = std::max(float(1e-3), sqr(m_roughness->scalar(uv)));
 
+            // reflection only happens within the upper hemisphere (this also avoids degenerate microfacet normals
+            // for wi = -wo, which occur at grazing angles)
+            if (Frame::cosTheta(wi) * Frame::cosTheta(wo) <= 0)
+                return BsdfEval::invalid();
+
             auto mfacet_normal = (wi + wo).normalized();
             auto reflectance = color;
             auto D = microfacet::evaluateGGX(alpha, mfacet_normal);
@@ -60,6 +70,15 @@ namespace lightwave
             //   * the variable `alpha' is already provided for you
         }
 
+        float pdf(const Vector &wo, const Vector &wi) const
+        {
+            if (Frame::cosTheta(wi) * Frame::cosTheta(wo) <= 0)
+                return 0;
+            const auto mfacet_normal = (wi + wo).normalized();
+            return microfacet::pdfGGXVNDF(alpha, mfacet_normal, wo) *
+                   microfacet::detReflection(mfacet_normal, wo);
+        }
+
         BsdfSample sample(const Vector &wo, Sampler &rng) const
         {
             BsdfSample samp;
@@ -139,6 +158,18 @@ namespace lightwave
 
         }
 
+        float roughness(const Point2 &uv, const Vector &wo) const override
+        {
+            // the lobes are weighted like they are selected for sampling, with the diffuse lobe counting as fully rough
+            const auto combination = combine(uv, wo);
+            const float prob = combination.diffuseSelectionProb;
+            if (std::isnan(prob))
+            {
+                return 0;
+            }
+            return prob + (1 - prob) * std::clamp(m_roughness->scalar(uv), 0.f, 1.f);
+        }
+
         BsdfEval evaluate(const Point2 &uv, const Vector &wo,
                           const Vector &wi) const override
         {
@@ -149,6 +180,18 @@ namespace lightwave
             // combine their results
         }
 
+        float pdf(const Point2 &uv, const Vector &wo,
+                  const Vector &wi) const override
+        {
+            const auto combination = combine(uv, wo);
+            const float prob = combination.diffuseSelectionProb;
+            if (std::isnan(prob))
+            {
+                return 0;
+            }
+            return prob * combination.diffuse.pdf(wo, wi) + (1 - prob) * combination.metallic.pdf(wo, wi);
+        }
+
         BsdfSample sample(const Point2 &uv, const Vector &wo,
                           Sampler &rng) const override
         {
@@ -20,6 +20,11 @@ namespace lightwave
         BsdfEval evaluate(const Point2 &uv, const Vector &wo,
                           const Vector &wi) const override
         {
+            // reflection only happens within the upper hemisphere (this also avoids degenerate microfacet normals
+            // for wi = -wo, which occur at grazing angles)
+            if (Frame::cosTheta(wi) * Frame::cosTheta(wo) <= 0)
+                return BsdfEval::invalid();
+
             // Using the squared roughness parameter results in a more gradual
             // transition from specular to rough. For numerical stability, we avoid
             // extremely specular distributions (alpha values below 10^-3)
@@ -36,6 +41,27 @@ namespace lightwave
             // * the microfacet normal can be computed from `wi' and `wo'
         }
 
+        float pdf(const Point2 &uv, const Vector &wo,
+                  const Vector &wi) const override
+        {
+            if (Frame::cosTheta(wi) * Frame::cosTheta(wo) <= 0)
+                return 0;
+            const auto alpha = std::max(float(1e-3), sqr(m_roughness->scalar(uv)));
+            const auto mfacet_normal = (wi + wo).normalized();
+            return microfacet::pdfGGXVNDF(alpha, mfacet_normal, wo) *
+                   microfacet::detReflection(mfacet_normal, wo);
+        }
+
+        Color getAlbedo(const Point2 &uv, const Vector &wo) const override
+        {
+            return m_reflectance->evaluate(uv);
+        }
+
+        float roughness(const Point2 &uv, const Vector &wo) const override
+        {
+            return std::clamp(m_roughness->scalar(uv), 0.f, 1.f);
+        }
+
         BsdfSample sample(const Point2 &uv, const Vector &wo,
                           Sampler &rng) const override
         {
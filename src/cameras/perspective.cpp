@@ -45,7 +45,7 @@ public:
         // * use m_resolution to find the aspect ratio of the image
     }
 
-    CameraSample sample(const Point2 &normalized, Sampler &rng) const override 
+    CameraSample sample(const Point2 &normalized, const Point2 &lensSample) const override 
         // NOT_IMPLEMENTED
        {    Ray ray = Ray(origin, Vector(normalized.x()*scale_x, normalized.y()*scale_y, 1.f));
             
@@ -57,6 +57,25 @@ public:
         // hints:
         // * use m_transform to transform the local camera coordinate system into the world coordinate system
     
+    CameraImportanceSample sampleImportance(const Point &origin, Sampler &rng) const override {
+        const Point local = m_transform->inverse(origin);
+        if (!(local.z() > 0))
+            return CameraImportanceSample::invalid();
+
+        CameraImportanceSample result;
+        const Point2 normalized(local.x() / (local.z() * scale_x), local.y() / (local.z() * scale_y));
+        if (!toPixel(normalized, result.pixel))
+            return CameraImportanceSample::invalid();
+
+        const Vector toCamera = m_transform->apply(Point(0.f)) - origin;
+        result.distance = toCamera.length();
+        result.wi = toCamera / result.distance;
+        // the importance is normalized over the image plane at unit distance, whose area is (2 scale_x) (2 scale_y)
+        const float cosTheta = local.z() / Vector(local).length();
+        result.weight = Color(1 / (4 * scale_x * scale_y * cosTheta * cosTheta * cosTheta * sqr(result.distance)));
+        return result;
+    }
+
 
     std::string toString() const override {
         return tfm::format(
@@ -24,6 +24,7 @@ class ThinLens : public Camera {
 public:
     ThinLens(const Properties &properties)
     : Camera(properties) {
+         m_sampleDimensions = MaxSampleDimensions;
          m_apertureRadius = properties.get<float>("radius");
         focal_length = properties.get<float>("f");
         scale_x = m_resolution.x();
@@ -47,7 +48,7 @@ public:
         }
     }
 
-    CameraSample sample(const Point2 &normalized, Sampler &rng) const override 
+    CameraSample sample(const Point2 &normalized, const Point2 &lensSample) const override 
        {
             
         //   // Sample point on lens using warp function
@@ -62,9 +63,9 @@ public:
         //     Ray ray(origin + Vector(lens_point.x(), lens_point.y(), 0.f), focalPoint - origin);
 
 
-            Point2 lensSample = squareToUniformDiskConcentric(rng.next2D());
+            Point2 lensDisk = squareToUniformDiskConcentric(lensSample);
 
-            Point lensPoint = Point(lensSample.x()*m_apertureRadius, lensSample.y()*m_apertureRadius, 0.0f);
+            Point lensPoint = Point(lensDisk.x()*m_apertureRadius, lensDisk.y()*m_apertureRadius, 0.0f);
 
             Vector direction = Vector(normalized.x() * scale_x, normalized.y() * scale_y, 1.0f);
             // Vector org_pl_focus = Vector(normalized)
@@ -85,6 +86,31 @@ public:
         // hints:
         // * use m_transform to transform the local camera coordinate system into the world coordinate system
     
+    CameraImportanceSample sampleImportance(const Point &origin, Sampler &rng) const override {
+        const Point local = m_transform->inverse(origin);
+        if (!(local.z() > 0))
+            return CameraImportanceSample::invalid();
+
+        // the point is seen through the pixel at which the ray from a random lens position crosses the focal plane
+        const Point2 lensSample = squareToUniformDiskConcentric(rng.next2D());
+        const Point lensPoint(lensSample.x() * m_apertureRadius, lensSample.y() * m_apertureRadius, 0.0f);
+        const Vector direction = local - lensPoint;
+        const Point pFocus = lensPoint + direction * (focal_length / direction.z());
+
+        CameraImportanceSample result;
+        const Point2 normalized(pFocus.x() / (focal_length * scale_x), pFocus.y() / (focal_length * scale_y));
+        if (!toPixel(normalized, result.pixel))
+            return CameraImportanceSample::invalid();
+
+        const Vector toCamera = m_transform->apply(lensPoint) - origin;
+        result.distance = toCamera.length();
+        result.wi = toCamera / result.distance;
+        // the area of the lens cancels out between the importance and the density of sampling the lens
+        const float cosTheta = direction.z() / direction.length();
+        result.weight = Color(1 / (4 * scale_x * scale_y * cosTheta * cosTheta * cosTheta * sqr(result.distance)));
+        return result;
+    }
+
 
     std::string toString() const override {
         return tfm::format(
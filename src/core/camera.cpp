@@ -4,16 +4,28 @@
 namespace lightwave {
 
 CameraSample Camera::sample(const Point2i &pixel, Sampler &rng) const {
+    float rnd[MaxSampleDimensions] = { 0.5f, 0.5f, 0.5f, 0.5f };
+    rng.nextN(std::span(rnd, m_sampleDimensions));
     // begin by sampling a random position within the pixel
-    const auto pixelPlusRandomOffset = Vector2(pixel.cast<float>()) + Vector2(rng.next2D());
+    const auto pixelPlusRandomOffset = Vector2(pixel.cast<float>()) + Vector2(rnd[0], rnd[1]);
     // normalize by image resolution to end up with value in range [-1,-1] to [+1,+1]
     const auto normalized = 2 * pixelPlusRandomOffset / m_resolution.cast<float>() - Vector2(1);
     // generate the sample using the normalized sample function
-    const auto s = sample(normalized, rng);
+    const auto s = sample(normalized, Point2(rnd[2], rnd[3]));
     assert_normalized(s.ray.direction, {
         logger(EError, "your Camera::sample implementation returned a non-normalized direction");
     });
     return s;
 }
 
+bool Camera::toPixel(const Point2 &normalized, Point2i &pixel) const {
+    for (int dim = 0; dim < 2; dim++) {
+        const float coordinate = (normalized[dim] + 1) / 2 * float(m_resolution[dim]);
+        if (!(coordinate >= 0 && coordinate < float(m_resolution[dim])))
+            return false;
+        pixel[dim] = std::min(int(coordinate), m_resolution[dim] - 1);
+    }
+    return true;
+}
+
 }
@@ -0,0 +1,72 @@
+#include "geometrypager.hpp"
+
+#include <lightwave/logger.hpp>
+
+#include <algorithm>
+
+namespace lightwave {
+
+GeometryPager::Region::~Region() {
+    GeometryPager &pager = global();
+    std::lock_guard lock(pager.m_mutex);
+    std::erase(pager.m_regions, this);
+    if (m_resident)
+        pager.m_residentBytes -= m_file->size();
+}
+
+GeometryPager &GeometryPager::global() {
+    // never destroyed, since meshes kept alive by the asset cache unregister their regions during static destruction
+    static GeometryPager *pager = new GeometryPager();
+    return *pager;
+}
+
+void GeometryPager::setBudget(size_t bytes) {
+    std::lock_guard lock(m_mutex);
+    m_budget = bytes;
+    if (m_budget)
+        logger(EInfo, "limiting resident geometry to %d MiB", m_budget >> 20);
+    enforceBudget(nullptr);
+}
+
+std::shared_ptr<GeometryPager::Region> GeometryPager::add(std::shared_ptr<const MappedFile> file) {
+    auto region = std::make_shared<Region>(std::move(file));
+    std::lock_guard lock(m_mutex);
+    m_regions.push_back(region.get());
+    return region;
+}
+
+void GeometryPager::makeResident(Region &region) {
+    std::lock_guard lock(m_mutex);
+    // another thread might have made the region resident while this one was waiting for the lock
+    if (region.m_resident)
+        return;
+    region.m_lastUse = ++m_clock;
+    region.m_resident = true;
+    m_residentBytes += region.m_file->size();
+    // once the budget is exceeded, reading the entire region ahead would only push out pages that are still needed,
+    // hence only the pages that rays actually reach are read back
+    if (!m_budget || m_residentBytes <= m_budget)
+        region.m_file->prefetch();
+    enforceBudget(&region);
+}
+
+void GeometryPager::enforceBudget(const Region *keep) {
+    while (m_budget && m_residentBytes > m_budget) {
+        Region *victim = nullptr;
+        for (Region *region : m_regions) {
+            if (region == keep || !region->m_resident)
+                continue;
+            if (!victim || region->m_lastUse < victim->m_lastUse)
+                victim = region;
+        }
+        if (!victim)
+            // the regions that are in use exceed the budget on their own
+            break;
+
+        victim->m_file->release();
+        victim->m_resident = false;
+        m_residentBytes -= victim->m_file->size();
+    }
+}
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+
+#include "mappedfile.hpp"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief Limits how much memory mapped geometry (i.e., meshes and BVHs mapped from ".lwmesh" files) stays resident,
+ * so that scenes whose geometry does not fit into memory at once can still be rendered.
+ * Meshes register their mapping as a @ref Region , and report whenever a ray enters them. Once the resident regions
+ * exceed the budget, the least recently used ones are released, i.e., their pages are dropped and read from disk
+ * again should rays enter them later.
+ *
+ * Releasing a region is safe while other threads still traverse it, since its pages are merely read back on access.
+ * Those threads block on the page faults until the operating system has read the data (which is how rays that hit
+ * non-resident geometry are suspended), while regions that fit into the budget are read ahead in the background.
+ * Pages read back by rays that were already traversing a released region are only accounted for once a ray enters the
+ * region again, hence the budget can be exceeded briefly.
+ */
+class GeometryPager {
+public:
+    /// @brief A memory mapping whose residency is managed by the pager.
+    class Region {
+        friend class GeometryPager;
+
+        std::shared_ptr<const MappedFile> m_file;
+        /// @brief The value of the clock of the pager when the region was last entered.
+        std::atomic<uint64_t> m_lastUse = 0;
+        std::atomic<bool> m_resident = false;
+
+    public:
+        explicit Region(std::shared_ptr<const MappedFile> file) : m_file(std::move(file)) {}
+        ~Region();
+
+        /// @brief Records that the region is about to be accessed, making it resident if it has been released.
+        void touch() {
+            GeometryPager &pager = global();
+            // the clock only advances when regions become resident, hence this rarely writes to shared memory
+            const uint64_t now = pager.m_clock.load(std::memory_order_relaxed);
+            if (m_lastUse.load(std::memory_order_relaxed) != now)
+                m_lastUse.store(now, std::memory_order_relaxed);
+            if (!m_resident.load(std::memory_order_relaxed))
+                pager.makeResident(*this);
+        }
+    };
+
+    /// @brief Returns the pager shared by the entire process.
+    static GeometryPager &global();
+
+    /// @brief Sets the number of bytes of mapped geometry that may be resident (zero for no limit).
+    void setBudget(size_t bytes);
+    /// @brief Registers a mapping, which is unregistered once the returned region is destroyed.
+    std::shared_ptr<Region> add(std::shared_ptr<const MappedFile> file);
+
+private:
+    std::mutex m_mutex;
+    size_t m_budget = 0;
+    size_t m_residentBytes = 0;
+    /// @brief The number of times regions have become resident, which orders the uses of regions.
+    std::atomic<uint64_t> m_clock = 0;
+    std::vector<Region *> m_regions;
+
+    void makeResident(Region &region);
+    /// @brief Releases the least recently used regions (other than @c keep ) until the budget is met.
+    void enforceBudget(const Region *keep);
+};
+
+}
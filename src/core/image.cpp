@@ -1,4 +1,5 @@
 #include <lightwave/core.hpp>
+#include <lightwave/cache.hpp>
 #include <lightwave/image.hpp>
 #include <lightwave/registry.hpp>
 
@@ -8,20 +9,39 @@
 namespace lightwave {
 
 void Image::loadImage(const std::filesystem::path &path, bool isLinearSpace) {
+    struct Pixels {
+        Point2i resolution;
+        std::vector<Color> data;
+    };
+
+    // images are frequently shared between scenes, hence they are cached when rendering in batch mode
+    const auto pixels = AssetCache::global().get<Pixels>(path, isLinearSpace ? "linear" : "srgb", [&]() {
+        Pixels result;
+        readImage(path, isLinearSpace, result.resolution, result.data);
+        return result;
+    });
+    // the pixels are only referenced (instead of copied), so that all images loaded from the file share them
+    m_resolution = pixels->resolution;
+    m_sharedData = std::shared_ptr<const std::vector<Color>>(pixels, &pixels->data);
+    m_data.clear();
+}
+
+void Image::readImage(const std::filesystem::path &path, bool isLinearSpace, Point2i &resolution,
+                      std::vector<Color> &pixels) {
     const auto extension = path.extension();
     logger(EInfo, "loading image %s", path);
     if (extension == ".exr") {
         // loading of EXR files is handled by TinyEXR
         float *data;
         const char *err;
-        if (LoadEXR(&data, &m_resolution.x(), &m_resolution.y(),
+        if (LoadEXR(&data, &resolution.x(), &resolution.y(),
                     path.generic_string().c_str(), &err)) {
             lightwave_throw("could not load image %s: %s", path, err);
         }
 
-        m_data.resize(m_resolution.x() * m_resolution.y());
+        pixels.resize(resolution.x() * resolution.y());
         auto it = data;
-        for (auto &pixel : m_data) {
+        for (auto &pixel : pixels) {
             for (int i = 0; i < pixel.NumComponents; i++)
                 pixel[i] = *it++;
             it++; // skip alpha channel
@@ -33,16 +53,16 @@ void Image::loadImage(const std::filesystem::path &path, bool isLinearSpace) {
 
         int numChannels;
         float *data =
-            stbi_loadf(path.generic_string().c_str(), &m_resolution.x(),
-                       &m_resolution.y(), &numChannels, 3);
+            stbi_loadf(path.generic_string().c_str(), &resolution.x(),
+                       &resolution.y(), &numChannels, 3);
         if (data == nullptr) {
             lightwave_throw("could not load image %s: %s", path,
                             stbi_failure_reason());
         }
 
-        m_data.resize(m_resolution.x() * m_resolution.y());
+        pixels.resize(resolution.x() * resolution.y());
         auto it = data;
-        for (auto &pixel : m_data) {
+        for (auto &pixel : pixels) {
             for (int i = 0; i < pixel.NumComponents; i++)
                 pixel[i] = *it++;
         }
@@ -59,7 +79,7 @@ void Image::saveAt(const std::filesystem::path &path) const {
     }
 
     logger(EInfo, "saving image %s", path);
-    if (SaveEXR(reinterpret_cast<const float *>(m_data.data()),
+    if (SaveEXR(reinterpret_cast<const float *>(data()),
                 m_resolution.x(), m_resolution.y(), 3, true,
                 path.generic_string().c_str(), &error)) {
         logger(EError, "  error saving image %s: %s", path, error);
@@ -6,18 +6,6 @@
 namespace lightwave
 {
 
-    Vector Instance::applyNormal(SurfaceEvent &surf) const
-    {
-        if (!m_transform)
-        {
-            // fast path, if no transform is needed
-            return surf.frame.normal;
-        }
-        // hint: transform the normal here
-        Vector newNormal = m_transform->adj(surf.frame.normal);
-        return newNormal.normalized();
-    }
-
     void Instance::transformFrame(SurfaceEvent &surf) const
     {
         // hints:
@@ -25,26 +13,21 @@ namespace lightwave
         // * if m_flipNormal is true, flip the direction of the bitangent (which in effect flips the normal)
         // * make sure that the frame is orthonormal (you are free to change the bitangent for this, but keep
         //   the direction of the transformed tangent the same)
+        // the area density changes by the factor the transform scales the surface element spanned by tangent and bitangent
+        const float areaScale = m_transform->apply(surf.frame.tangent).cross(m_transform->apply(surf.frame.bitangent)).length();
         surf.position = m_transform->apply(surf.position);
-        if (m_normal)
+        surf.frame.tangent = m_transform->apply(surf.frame.tangent).normalized();
+        Vector bitangent = m_transform->apply(surf.frame.bitangent);
+        float proj = surf.frame.tangent.dot(bitangent);
+
+        surf.frame.bitangent = (bitangent - proj * surf.frame.tangent).normalized();
+        if (m_flipNormal)
         {
-            surf.frame = Frame(applyNormal(surf));
+            surf.frame.bitangent = -surf.frame.bitangent;
         }
-        else
-        {
-            surf.frame.tangent = m_transform->apply(surf.frame.tangent).normalized();
-            Vector bitangent = m_transform->apply(surf.frame.bitangent);
-            float proj = surf.frame.tangent.dot(bitangent);
 
-            surf.frame.bitangent = (bitangent - proj * surf.frame.tangent).normalized();
-            if (m_flipNormal)
-            {
-                surf.frame.bitangent = -surf.frame.bitangent;
-            }
-
-            surf.frame.normal = surf.frame.tangent.cross(surf.frame.bitangent).normalized();
-        }
-        surf.pdf *= surf.frame.bitangent.cross(surf.frame.tangent).length();
+        surf.frame.normal = surf.frame.tangent.cross(surf.frame.bitangent).normalized();
+        surf.pdf /= areaScale;
     }
 
     bool Instance::intersect(const Ray &worldRay, Intersection &its, Sampler &rng) const
@@ -53,17 +36,24 @@ namespace lightwave
             its.alphaMasking = m_alpha.get();
         }
         else its.alphaMasking=nullptr;
+        // nested instances report themselves when they are hit, which is how their hits are told apart from hits of
+        // plain shapes (the instance of a previous hit is restored if the shape is missed)
+        const Instance *previousInstance = its.instance;
+        its.instance = nullptr;
         if (!m_transform)
         {
             // fast path, if no transform is needed
             Ray localRay = worldRay;
             if (m_shape->intersect(localRay, its, rng))
             {
+                if (its.instance)
+                    completeNested(localRay, its);
                 its.instance = this;
                 return true;
             }
             else
             {
+                its.instance = previousInstance;
                 return false;
             }
         }
@@ -84,28 +74,67 @@ namespace lightwave
         if (wasIntersected)
         {
             // hint: how does its.t need to change?
-            if (m_normal)
-            {
-                auto normal_texture = m_normal->evaluate(its.uv);
-
-                auto normal_rgb = Vector(normal_texture.r(), normal_texture.g(), normal_texture.b());
-                normal_rgb = normal_rgb * 2 - Vector(1, 1, 1);
-                normal_rgb = normal_rgb.x() * its.frame.tangent + normal_rgb.y() * its.frame.bitangent + normal_rgb.z() * its.frame.normal;
-                its.frame.normal = normal_rgb;
-            }
-
+            if (its.instance)
+                completeNested(localRay, its);
             its.instance = this;
-            transformFrame(its);
             its.t = its.t / scaleNum;
             return true;
         }
         else
         {
             its.t = previousT;
+            its.instance = previousInstance;
             return false;
         }
     }
 
+    void Instance::completeNested(const Ray &localRay, Intersection &its) const
+    {
+        // the transform of the nested instance is not known anymore once this instance reports the hit, hence the
+        // surface is computed right away (in the coordinates of this instance)
+        its.instance->computeSurfaceInteraction(localRay, its);
+        its.shape = nullptr;
+    }
+
+    void Instance::computeSurfaceInteraction(const Ray &worldRay, Intersection &its) const
+    {
+        if (!m_transform)
+        {
+            if (its.shape)
+                its.shape->computeSurfaceInteraction(worldRay, its);
+        }
+        else
+        {
+            Ray localRay = m_transform->inverse(worldRay);
+            const float scaleNum = localRay.direction.length();
+            localRay.direction = localRay.direction.normalized();
+            if (its.shape)
+            {
+                const float worldT = its.t;
+                its.t = worldT * scaleNum;
+                its.shape->computeSurfaceInteraction(localRay, its);
+                its.t = worldT;
+            }
+            transformFrame(its);
+        }
+
+        // the normal map is applied in the same way with or without transform, namely to the tangent frame in world
+        // coordinates (which keeps the frame used for the area density unaffected by it)
+        if (m_normal)
+        {
+            its.frame = Frame(applyNormalMap(its));
+        }
+    }
+
+    Vector Instance::applyNormalMap(const SurfaceEvent &surf) const
+    {
+        auto normal_texture = m_normal->evaluate(surf.uv);
+
+        auto normal_rgb = Vector(normal_texture.r(), normal_texture.g(), normal_texture.b());
+        normal_rgb = normal_rgb * 2 - Vector(1, 1, 1);
+        return (normal_rgb.x() * surf.frame.tangent + normal_rgb.y() * surf.frame.bitangent + normal_rgb.z() * surf.frame.normal).normalized();
+    }
+
     Bounds Instance::getBoundingBox() const
     {
         if (!m_transform)
@@ -151,7 +180,9 @@ namespace lightwave
     AreaSample Instance::sampleArea(Sampler &rng) const
     {
         AreaSample sample = m_shape->sampleArea(rng);
-        transformFrame(sample);
+        sample.instance = this;
+        if (m_transform)
+            transformFrame(sample);
         return sample;
     }
 
@@ -1,45 +1,152 @@
 #include <lightwave/integrator.hpp>
 #include <lightwave/camera.hpp>
+#include <lightwave/instance.hpp>
 #include <lightwave/parallel.hpp>
 
 #include <algorithm>
 #include <chrono>
+#include <vector>
 
 #include <lightwave/streaming.hpp>
 #include <lightwave/iterators.hpp>
 
 namespace lightwave {
 
+void RenderContext::recordPrimaryHit(const Intersection &its) {
+    if (!aov || aov->recorded)
+        return;
+    aov->recorded = true;
+    if (!its)
+        return;
+    aov->albedo = its.evaluateAlbedo();
+    aov->normal = its.frame.normal;
+    aov->distance = its.t;
+    aov->instanceId = its.instance->index();
+}
+
 void SamplingIntegrator::execute() {
+    initializeImages();
+    renderSamples(0, m_sampler->samplesPerPixel());
+    saveImages();
+}
+
+void SamplingIntegrator::initializeImages() {
     if (!m_image) {
         lightwave_throw("<integrator /> needs an <image /> child to render into!");
     }
 
     const Vector2i resolution = m_scene->camera()->resolution();
     m_image->initialize(resolution);
+    for (Image *image : { m_albedoImage.get(), m_normalsImage.get(), m_distanceImage.get(), m_instanceIdImage.get() }) {
+        if (image) image->initialize(resolution);
+    }
+}
+
+void SamplingIntegrator::saveImages() {
+    m_image->save();
+    for (Image *image : { m_albedoImage.get(), m_normalsImage.get(), m_distanceImage.get(), m_instanceIdImage.get() }) {
+        if (image) image->save();
+    }
+}
+
+void SamplingIntegrator::writeAovs(const Point2i &pixel, const AovSum &sum) {
+    const float norm = 1.0f / std::max(sum.count, 1);
+    if (m_albedoImage) m_albedoImage->get(pixel) = norm * sum.albedo;
+    if (m_normalsImage) m_normalsImage->get(pixel) = norm * sum.normal;
+    if (m_distanceImage) m_distanceImage->get(pixel) = Color(norm * sum.distance);
+    if (m_instanceIdImage) m_instanceIdImage->get(pixel) = Color(float(sum.instanceId));
+}
+
+void SamplingIntegrator::renderAovs(int firstSample, int sampleCount) {
+    if (!hasAovs())
+        return;
+
+    const Vector2i resolution = m_scene->camera()->resolution();
+    std::vector<ref<Sampler>> samplers(numWorkerThreads());
+    for (auto &sampler : samplers) {
+        sampler = m_sampler->clone();
+    }
+
+    for_each_parallel(
+        BlockSpiral(resolution, Vector2i(64)),
+        [&](int thread) -> Sampler & { return *samplers[thread]; },
+        [&](Sampler &sampler, auto block) {
+            RenderContext context;
+            for (auto pixel : block) {
+                AovSum sum;
+                for (int sample = firstSample; sample < firstSample + sampleCount; sample++) {
+                    AovSample aov;
+                    context.aov = &aov;
+                    // the camera samples match those of the rendered image, as they are drawn first after seeding
+                    sampler.seed(pixel, sample);
+                    const auto cameraSample = m_scene->camera()->sample(pixel, sampler);
+                    context.recordPrimaryHit(m_scene->intersect(cameraSample.ray, sampler));
+                    sum.add(aov);
+                }
+                writeAovs(pixel, sum);
+            }
+        });
+}
+
+void SamplingIntegrator::renderSamples(int firstSample, int sampleCount) {
+    const Vector2i resolution = m_scene->camera()->resolution();
+    const bool hasAovs = this->hasAovs();
+    const float norm = 1.0f / sampleCount;
+
+    // each worker thread gets its own context (with its own sampler and scratch memory), which is reused for all
+    // blocks rendered by that thread
+    std::vector<RenderContext> contexts(numWorkerThreads());
+    for (int thread = 0; thread < int(contexts.size()); thread++) {
+        contexts[thread].threadIndex = thread;
+        contexts[thread].sampler = m_sampler->clone();
+    }
 
-    const float norm = 1.0f / m_sampler->samplesPerPixel();
-    
     Streaming stream { *m_image };
     ProgressReporter progress { resolution.product() };
-    for_each_parallel(BlockSpiral(resolution, Vector2i(64)), [&](auto block) {
-        auto sampler = m_sampler->clone();
-        for (auto pixel : block) {
-            Color sum;
-            for (int sample = 0; sample < m_sampler->samplesPerPixel(); sample++) {
-                sampler->seed(pixel, sample);
-                auto cameraSample = m_scene->camera()->sample(pixel, *sampler);
-                sum += cameraSample.weight * Li(cameraSample.ray, *sampler);
+    for_each_parallel(
+        BlockSpiral(resolution, Vector2i(64)),
+        [&](int thread) -> RenderContext & { return contexts[thread]; },
+        [&](RenderContext &context, auto block) {
+            Sampler &sampler = *context.sampler;
+            for (auto pixel : block) {
+                Color sum;
+                AovSum aovSum;
+                for (int sample = firstSample; sample < firstSample + sampleCount; sample++) {
+                    AovSample aov;
+                    context.aov = hasAovs ? &aov : nullptr;
+
+                    sampler.seed(pixel, sample);
+                    auto cameraSample = m_scene->camera()->sample(pixel, sampler);
+                    sum += cameraSample.weight * Li(cameraSample.ray, context);
+                    context.arena.reset();
+
+                    if (hasAovs) {
+                        // integrators that do not report their first intersection need it to be computed separately
+                        if (!aov.recorded)
+                            context.recordPrimaryHit(m_scene->intersect(cameraSample.ray, sampler));
+                        aovSum.add(aov);
+                    }
+                }
+                m_image->get(pixel) = norm * sum;
+                if (hasAovs) writeAovs(pixel, aovSum);
             }
-            m_image->get(pixel) = norm * sum;
-        }
 
-        progress += block.diagonal().product();
-        stream.updateBlock(block);
-    });
+            context.stats.blocks++;
+            context.stats.samples += block.diagonal().product() * int64_t(sampleCount);
+            progress += block.diagonal().product();
+            stream.updateBlock(block);
+        });
     progress.finish();
 
-    m_image->save();
+    RenderContext::Statistics total;
+    size_t scratchMemory = 0;
+    for (const auto &context : contexts) {
+        total.blocks += context.stats.blocks;
+        total.samples += context.stats.samples;
+        scratchMemory = std::max(scratchMemory, context.arena.capacity());
+    }
+    logger(EDebug, "rendered %d samples in %d blocks using %d threads (at most %d KiB scratch memory per thread)",
+        total.samples, total.blocks, contexts.size(), scratchMemory / 1024);
 }
 
 }
@@ -0,0 +1,334 @@
+#include "lightbvh.hpp"
+
+#include <lightwave/distribution.hpp>
+
+#include <algorithm>
+#include <bit>
+
+namespace lightwave {
+
+namespace {
+
+/// @brief The number of buckets per axis used to evaluate split candidates.
+constexpr int NumBuckets = 12;
+/// @brief The maximum depth of leaves, as the path to each leaf is stored with one bit per inner node in 64 bits.
+constexpr int MaxDepth = 64;
+
+/// @brief Computes @code cos(max(0, a - b)) @endcode from the sines and cosines of two angles a and b.
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB)
+        return 1;
+    return cosA * cosB + sinA * sinB;
+}
+
+/// @brief Computes @code sin(max(0, a - b)) @endcode from the sines and cosines of two angles a and b.
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+    if (cosA > cosB)
+        return 0;
+    return sinA * cosB - cosA * sinB;
+}
+
+/// @brief Rotates a vector around a normalized axis by the given angle (in radians).
+Vector rotate(const Vector &v, const Vector &axis, float angle) {
+    const float cosAngle = cos(angle);
+    const float sinAngle = sin(angle);
+    return v * cosAngle + axis.cross(v) * sinAngle +
+           axis * (axis.dot(v) * (1 - cosAngle));
+}
+
+float surfaceArea(const Bounds &bounds) {
+    const Vector d = bounds.diagonal();
+    return 2 * (d.x() * d.y() + d.y() * d.z() + d.z() * d.x());
+}
+
+/// @brief Computes the smallest cone that contains two given cones.
+void mergeCones(Vector &axis, float &cosTheta, const Vector &otherAxis, float otherCosTheta) {
+    const float thetaA = safe_acos(cosTheta);
+    const float thetaB = safe_acos(otherCosTheta);
+    const float thetaD = safe_acos(axis.dot(otherAxis));
+    if (std::min(thetaD + thetaB, Pi) <= thetaA)
+        return;
+    if (std::min(thetaD + thetaA, Pi) <= thetaB) {
+        axis     = otherAxis;
+        cosTheta = otherCosTheta;
+        return;
+    }
+
+    const float thetaO = (thetaA + thetaD + thetaB) / 2;
+    const Vector rotationAxis = axis.cross(otherAxis);
+    if (thetaO >= Pi || rotationAxis.lengthSquared() == 0) {
+        cosTheta = -1;
+        return;
+    }
+    axis     = rotate(axis, rotationAxis.normalized(), thetaO - thetaA).normalized();
+    cosTheta = cos(thetaO);
+}
+
+LightBounds merge(const LightBounds &a, const LightBounds &b) {
+    if (a.phi == 0)
+        return b;
+    if (b.phi == 0)
+        return a;
+
+    LightBounds result = a;
+    result.bounds.extend(b.bounds);
+    mergeCones(result.axis, result.cosThetaO, b.axis, b.cosThetaO);
+    result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+    result.phi       = a.phi + b.phi;
+    result.twoSided  = a.twoSided || b.twoSided;
+    return result;
+}
+
+/// @brief Estimates how much light a cluster of light sources contributes to a given shading point.
+float importance(const LightBounds &lb, const Point &origin, const Vector &normal) {
+    const Point center = lb.bounds.center();
+    const float radius = lb.bounds.diagonal().length() / 2;
+    float distance2 = (origin - center).lengthSquared();
+    // avoid singularities when the shading point lies within (or close to) the bounds
+    distance2 = std::max(distance2, radius);
+
+    const Vector wi = (origin - center).normalized();
+    float cosThetaW = lb.axis.dot(wi);
+    if (lb.twoSided)
+        cosThetaW = abs(cosThetaW);
+    const float sinThetaW = safe_sqrt(1 - sqr(cosThetaW));
+
+    // the angle subtended by the bounds as seen from the shading point
+    float cosThetaB = -1;
+    if ((origin - center).lengthSquared() > sqr(radius))
+        cosThetaB = safe_sqrt(1 - sqr(radius) / (origin - center).lengthSquared());
+    const float sinThetaB = safe_sqrt(1 - sqr(cosThetaB));
+
+    // the minimal angle between the emission cone and the direction towards the shading point
+    const float sinThetaO = safe_sqrt(1 - sqr(lb.cosThetaO));
+    const float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, lb.cosThetaO);
+    const float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, lb.cosThetaO);
+    const float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+    if (cosThetaP <= lb.cosThetaE)
+        return 0;
+
+    float result = lb.phi * cosThetaP / distance2;
+
+    if (!normal.isZero()) {
+        // the minimal angle between the surface normal and the direction towards the bounds
+        const float cosThetaI = abs(wi.dot(normal));
+        const float sinThetaI = safe_sqrt(1 - sqr(cosThetaI));
+        result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+    }
+
+    return std::max(result, 0.f);
+}
+
+/// @brief The cost heuristic used to decide on splits, which considers the spatial and directional extent of lights.
+float splitCost(const LightBounds &lb, const Bounds &parentBounds, int dim) {
+    const float thetaO    = safe_acos(lb.cosThetaO);
+    const float thetaE    = safe_acos(lb.cosThetaE);
+    const float thetaW    = std::min(thetaO + thetaE, Pi);
+    const float sinThetaO = safe_sqrt(1 - sqr(lb.cosThetaO));
+    const float solidAngleMeasure =
+        2 * Pi * (1 - lb.cosThetaO) +
+        Pi / 2 *
+            (2 * thetaW * sinThetaO - cos(thetaO - 2 * thetaW) -
+             2 * thetaO * sinThetaO + lb.cosThetaO);
+    const Vector diagonal = parentBounds.diagonal();
+    const float regularization =
+        diagonal[dim] > 0 ? diagonal.maxComponent() / diagonal[dim] : 1;
+    return lb.phi * solidAngleMeasure * regularization * surfaceArea(lb.bounds);
+}
+
+} // namespace
+
+LightHierarchy::LightHierarchy(const std::vector<ref<Light>> &lights) {
+    std::vector<std::pair<int, LightBounds>> boundedLights;
+    for (const auto &light : lights) {
+        const auto lb = light->bounds();
+        if (!lb) {
+            m_infiniteLights.push_back(light.get());
+        } else if (lb->phi > 0) {
+            boundedLights.emplace_back(int(m_boundedLights.size()), *lb);
+            m_boundedLights.push_back(light.get());
+        }
+    }
+
+    if (!boundedLights.empty()) {
+        build(boundedLights, 0, int(boundedLights.size()), 0, 0);
+    }
+}
+
+int LightHierarchy::build(std::vector<std::pair<int, LightBounds>> &lights, int begin, int end, uint64_t bitTrail,
+                          int depth) {
+    const int nodeIndex = int(m_nodes.size());
+    m_nodes.emplace_back();
+
+    if (end - begin == 1) {
+        m_nodes[nodeIndex] = Node{
+            .bounds = lights[begin].second,
+            .index  = lights[begin].first,
+            .isLeaf = true,
+        };
+        m_bitTrails[m_boundedLights[lights[begin].first]] = bitTrail;
+        return nodeIndex;
+    }
+
+    Bounds bounds, centroidBounds;
+    for (int i = begin; i < end; i++) {
+        bounds.extend(lights[i].second.bounds);
+        centroidBounds.extend(lights[i].second.bounds.center());
+    }
+
+    // find the split with the lowest cost using bucketing along each axis
+    float minCost = Infinity;
+    int minCostBucket = -1, minCostDim = -1;
+    for (int dim = 0; dim < 3; dim++) {
+        const float extent = centroidBounds.max()[dim] - centroidBounds.min()[dim];
+        if (!(extent > 0))
+            continue;
+
+        const auto bucketOf = [&](const LightBounds &lb) {
+            const float relative = (lb.bounds.center()[dim] - centroidBounds.min()[dim]) / extent;
+            return std::clamp(int(relative * NumBuckets), 0, NumBuckets - 1);
+        };
+
+        LightBounds buckets[NumBuckets];
+        for (int i = begin; i < end; i++) {
+            LightBounds &bucket = buckets[bucketOf(lights[i].second)];
+            bucket = merge(bucket, lights[i].second);
+        }
+
+        for (int split = 0; split < NumBuckets - 1; split++) {
+            LightBounds below, above;
+            for (int b = 0; b <= split; b++)
+                below = merge(below, buckets[b]);
+            for (int b = split + 1; b < NumBuckets; b++)
+                above = merge(above, buckets[b]);
+            if (below.phi == 0 || above.phi == 0)
+                continue;
+
+            const float cost = splitCost(below, bounds, dim) + splitCost(above, bounds, dim);
+            if (cost < minCost) {
+                minCost       = cost;
+                minCostBucket = split;
+                minCostDim    = dim;
+            }
+        }
+    }
+
+    // splitting in the middle needs at most ceil(log2(count)) further levels, hence splits by cost (which might separate
+    // as little as a single light) are only used while such splits still fit below every child
+    const int middleSplitLevels = std::bit_width(uint32_t(end - begin - 1));
+    int mid = -1;
+    if (minCostDim >= 0 && depth + 1 + middleSplitLevels <= MaxDepth) {
+        const int dim = minCostDim;
+        const float extent = centroidBounds.max()[dim] - centroidBounds.min()[dim];
+        mid = int(std::partition(lights.begin() + begin, lights.begin() + end,
+                                 [&](const auto &light) {
+                                     const float relative = (light.second.bounds.center()[dim] -
+                                                             centroidBounds.min()[dim]) /
+                                                            extent;
+                                     return std::clamp(int(relative * NumBuckets), 0, NumBuckets - 1) <=
+                                            minCostBucket;
+                                 }) -
+                  lights.begin());
+    }
+    if (mid <= begin || mid >= end) {
+        // no useful split was found, fall back to splitting in the middle along the largest axis
+        const int dim = centroidBounds.diagonal().maxComponentIndex();
+        mid = (begin + end) / 2;
+        std::nth_element(lights.begin() + begin, lights.begin() + mid, lights.begin() + end,
+                         [&](const auto &a, const auto &b) {
+                             return a.second.bounds.center()[dim] < b.second.bounds.center()[dim];
+                         });
+    }
+
+    const int firstChild = build(lights, begin, mid, bitTrail, depth + 1);
+    const int secondChild = build(lights, mid, end, bitTrail | (uint64_t(1) << depth), depth + 1);
+    m_nodes[nodeIndex] = Node{
+        .bounds = merge(m_nodes[firstChild].bounds, m_nodes[secondChild].bounds),
+        .index  = secondChild,
+        .isLeaf = false,
+    };
+    return nodeIndex;
+}
+
+float LightHierarchy::infiniteProbability() const {
+    if (m_infiniteLights.empty())
+        return 0;
+    return float(m_infiniteLights.size()) / (m_infiniteLights.size() + (m_nodes.empty() ? 0 : 1));
+}
+
+LightSample LightHierarchy::sample(const Point &origin, const Vector &normal, float rnd) const {
+    const float pInfinite = infiniteProbability();
+    if (rnd < pInfinite) {
+        const int count = int(m_infiniteLights.size());
+        const int index = std::min(int(rnd / pInfinite * count), count - 1);
+        return {
+            .light = m_infiniteLights[index],
+            .probability = pInfinite / count,
+        };
+    }
+
+    if (m_nodes.empty())
+        return LightSample::invalid();
+
+    rnd = std::min((rnd - pInfinite) / (1 - pInfinite), OneMinusEpsilon);
+    float probability = 1 - pInfinite;
+    int nodeIndex = 0;
+    while (!m_nodes[nodeIndex].isLeaf) {
+        const float first = importance(m_nodes[nodeIndex + 1].bounds, origin, normal);
+        const float second = importance(m_nodes[m_nodes[nodeIndex].index].bounds, origin, normal);
+        if (first == 0 && second == 0)
+            return LightSample::invalid();
+
+        const float pFirst = first / (first + second);
+        if (rnd < pFirst) {
+            rnd = std::min(rnd / pFirst, OneMinusEpsilon);
+            probability *= pFirst;
+            nodeIndex = nodeIndex + 1;
+        } else {
+            rnd = std::min((rnd - pFirst) / (1 - pFirst), OneMinusEpsilon);
+            probability *= 1 - pFirst;
+            nodeIndex = m_nodes[nodeIndex].index;
+        }
+    }
+
+    const Node &leaf = m_nodes[nodeIndex];
+    if (nodeIndex == 0 && importance(leaf.bounds, origin, normal) == 0)
+        return LightSample::invalid();
+    return {
+        .light = m_boundedLights[leaf.index],
+        .probability = probability,
+    };
+}
+
+float LightHierarchy::pmf(const Light *light, const Point &origin, const Vector &normal) const {
+    const auto it = m_bitTrails.find(light);
+    if (it == m_bitTrails.end()) {
+        if (std::find(m_infiniteLights.begin(), m_infiniteLights.end(), light) != m_infiniteLights.end())
+            return infiniteProbability() / m_infiniteLights.size();
+        return 0;
+    }
+
+    uint64_t bitTrail = it->second;
+    float probability = 1 - infiniteProbability();
+    int nodeIndex = 0;
+    while (!m_nodes[nodeIndex].isLeaf) {
+        const float first = importance(m_nodes[nodeIndex + 1].bounds, origin, normal);
+        const float second = importance(m_nodes[m_nodes[nodeIndex].index].bounds, origin, normal);
+        if (first == 0 && second == 0)
+            return 0;
+
+        if (bitTrail & 1) {
+            probability *= second / (first + second);
+            nodeIndex = m_nodes[nodeIndex].index;
+        } else {
+            probability *= first / (first + second);
+            nodeIndex = nodeIndex + 1;
+        }
+        bitTrail >>= 1;
+    }
+    if (nodeIndex == 0 && importance(m_nodes[0].bounds, origin, normal) == 0)
+        return 0;
+    return probability;
+}
+
+}
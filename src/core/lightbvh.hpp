@@ -0,0 +1,49 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/light.hpp>
+#include <lightwave/scene.hpp>
+
+#include <unordered_map>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A bounding volume hierarchy over light sources, which allows picking lights proportional to (an estimate of)
+ * their contribution to a given shading point in logarithmic time.
+ * Each node stores conservative bounds of the position, emission directions and power of the lights below it, from
+ * which an importance for a shading point is derived when traversing the hierarchy.
+ * Light sources without bounds (e.g., directional lights or environment maps) are sampled uniformly with a probability
+ * of being picked that equals that of the entire hierarchy.
+ * @see "Importance Sampling of Many Lights with Adaptive Tree Splitting" [Conty Estevez and Kulla 2018]
+ */
+class LightHierarchy {
+    struct Node {
+        /// @brief The bounds of all lights within this node.
+        LightBounds bounds;
+        /// @brief For leaf nodes, the light index; for interior nodes, the index of the second child (the first child
+        /// immediately follows its parent).
+        int index;
+        bool isLeaf;
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<const Light *> m_boundedLights;
+    std::vector<const Light *> m_infiniteLights;
+    /// @brief For each light in the hierarchy, the sequence of branches taken to reach its leaf from the root (least
+    /// significant bit first, where a set bit denotes the second child).
+    std::unordered_map<const Light *, uint64_t> m_bitTrails;
+
+    int build(std::vector<std::pair<int, LightBounds>> &lights, int begin, int end, uint64_t bitTrail, int depth);
+    /// @brief The probability of picking one of the infinite lights.
+    float infiniteProbability() const;
+
+public:
+    LightHierarchy(const std::vector<ref<Light>> &lights);
+
+    LightSample sample(const Point &origin, const Vector &normal, float rnd) const;
+    float pmf(const Light *light, const Point &origin, const Vector &normal) const;
+};
+
+}
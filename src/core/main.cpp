@@ -1,9 +1,11 @@
 #include <lightwave/core.hpp>
+#include <lightwave/cache.hpp>
 #include <lightwave/registry.hpp>
 #include <lightwave/logger.hpp>
 
 #include "parser.hpp"
 
+#include <algorithm>
 #include <fstream>
 
 #ifdef LW_OS_WINDOWS
@@ -21,6 +23,55 @@ void print_exception(const std::exception &e, int level = 0) {
     } catch(...) {}
 }
 
+/// @brief Returns whether a path contains wildcards that need to be expanded.
+bool hasWildcards(const std::string &path) {
+    return path.find_first_of("*?") != std::string::npos;
+}
+
+/// @brief Matches a string against a pattern, where @c * matches any sequence of characters and @c ? any character.
+bool matchesWildcard(const char *pattern, const char *str) {
+    if (*pattern == '*')
+        return matchesWildcard(pattern + 1, str) || (*str && matchesWildcard(pattern, str + 1));
+    if (!*str)
+        return !*pattern;
+    return (*pattern == '?' || *pattern == *str) && matchesWildcard(pattern + 1, str + 1);
+}
+
+/// @brief Expands wildcards in the components of a path (e.g., "tests/*/*.xml") to all matching files.
+std::vector<std::filesystem::path> expandWildcards(const std::filesystem::path &pattern) {
+    std::vector<std::filesystem::path> matches = { pattern.root_path() };
+    for (const auto &component : pattern.relative_path()) {
+        const std::string name = component.string();
+        std::vector<std::filesystem::path> next;
+        for (const auto &base : matches) {
+            if (!hasWildcards(name)) {
+                next.push_back(base / component);
+                continue;
+            }
+
+            std::error_code error;
+            for (const auto &entry : std::filesystem::directory_iterator(base.empty() ? "." : base, error)) {
+                const std::string filename = entry.path().filename().string();
+                if (matchesWildcard(name.c_str(), filename.c_str()))
+                    next.push_back(base / filename);
+            }
+        }
+        matches = std::move(next);
+    }
+    std::sort(matches.begin(), matches.end());
+    return matches;
+}
+
+/// @brief Parses a scene file and executes all objects within it (e.g., integrators and tests).
+void render(const std::filesystem::path &scenePath) {
+    SceneParser parser { scenePath };
+    for (auto &object : parser.objects()) {
+        if (auto executable = dynamic_cast<Executable *>(object.get())) {
+            executable->execute();
+        }
+    }
+}
+
 int main(int argc, const char *argv[]) {
 #ifdef LW_DEBUG
     logger(EWarn, "lightwave was compiled in Debug mode, expect rendering to be much slower");
@@ -34,24 +85,53 @@ int main(int argc, const char *argv[]) {
    _set_abort_behavior(0, _WRITE_ABORT_MSG | _CALL_REPORTFAULT);
 #endif
 
-    try {
-        if (argc <= 1) {
-            logger(EError, "please specify path to scene");
-            return -1;
+    std::vector<std::filesystem::path> scenePaths;
+    for (int i = 1; i < argc; i++) {
+        if (hasWildcards(argv[i])) {
+            const auto matches = expandWildcards(argv[i]);
+            if (matches.empty()) {
+                logger(EWarn, "no scenes match %s", argv[i]);
+            }
+            scenePaths.insert(scenePaths.end(), matches.begin(), matches.end());
+        } else {
+            scenePaths.emplace_back(argv[i]);
         }
-        
-        std::filesystem::path scenePath = argv[1];
+    }
 
-        SceneParser parser { scenePath };
-        for (auto &object : parser.objects()) {
-            if (auto executable = dynamic_cast<Executable *>(object.get())) {
-                executable->execute();
-            }
+    if (scenePaths.empty()) {
+        logger(EError, "please specify path to scene");
+        return -1;
+    }
+
+    if (scenePaths.size() == 1) {
+        try {
+            render(scenePaths.front());
+        } catch(const std::exception &e) {
+            print_exception(e);
+            return 1;
+        }
+        return 0;
+    }
+
+    // batch mode: scenes are rendered one after another, sharing assets that are used by multiple scenes
+    AssetCache::global().setEnabled(true);
+
+    Timer batchTimer;
+    int failedCount = 0;
+    for (const auto &scenePath : scenePaths) {
+        logger(EInfo, "rendering scene %s", scenePath);
+        Timer sceneTimer;
+        try {
+            render(scenePath);
+            logger(EInfo, "scene %s finished (%.2fs)", scenePath, sceneTimer.getElapsedTime());
+        } catch(const std::exception &e) {
+            print_exception(e);
+            logger(EInfo, "scene %s failed (%.2fs)", scenePath, sceneTimer.getElapsedTime());
+            failedCount++;
         }
-    } catch(const std::exception &e) {
-        print_exception(e);
-        return 1;
     }
+    logger(EInfo, "%d of %d scenes finished successfully in %.2fs",
+        scenePaths.size() - failedCount, scenePaths.size(), batchTimer.getElapsedTime());
 
-    return 0;
+    return failedCount > 0 ? 1 : 0;
 }
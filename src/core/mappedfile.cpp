@@ -0,0 +1,112 @@
+#include "mappedfile.hpp"
+
+#ifdef LW_OS_WINDOWS
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace lightwave {
+
+#ifdef LW_OS_WINDOWS
+
+MappedFile::MappedFile(const std::filesystem::path &path) {
+    m_file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        m_file = nullptr;
+        lightwave_throw("could not open file %s", path);
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size)) {
+        CloseHandle(m_file);
+        lightwave_throw("could not determine the size of file %s", path);
+    }
+    m_size = size_t(size.QuadPart);
+    // empty files cannot be mapped
+    if (m_size == 0)
+        return;
+
+    m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_mapping)
+        m_data = static_cast<const char *>(MapViewOfFile(m_mapping, FILE_MAP_READ, 0, 0, 0));
+    if (!m_data) {
+        if (m_mapping)
+            CloseHandle(m_mapping);
+        CloseHandle(m_file);
+        lightwave_throw("could not map file %s", path);
+    }
+}
+
+void MappedFile::prefetch() const {
+    if (!m_data)
+        return;
+    WIN32_MEMORY_RANGE_ENTRY range { const_cast<char *>(m_data), m_size };
+    PrefetchVirtualMemory(GetCurrentProcess(), 1, &range, 0);
+}
+
+void MappedFile::release() const {
+    // unlocking pages that are not locked removes them from the working set of the process
+    if (m_data)
+        VirtualUnlock(const_cast<char *>(m_data), m_size);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data)
+        UnmapViewOfFile(m_data);
+    if (m_mapping)
+        CloseHandle(m_mapping);
+    if (m_file)
+        CloseHandle(m_file);
+}
+
+#else
+
+MappedFile::MappedFile(const std::filesystem::path &path) {
+    const int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+        lightwave_throw("could not open file %s", path);
+
+    struct stat status;
+    if (fstat(file, &status) != 0) {
+        close(file);
+        lightwave_throw("could not determine the size of file %s", path);
+    }
+    m_size = size_t(status.st_size);
+    // empty files cannot be mapped
+    if (m_size == 0) {
+        close(file);
+        return;
+    }
+
+    void *data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, file, 0);
+    // the mapping stays valid after the file descriptor is closed
+    close(file);
+    if (data == MAP_FAILED)
+        lightwave_throw("could not map file %s", path);
+    m_data = static_cast<const char *>(data);
+}
+
+void MappedFile::prefetch() const {
+    if (m_data)
+        madvise(const_cast<char *>(m_data), m_size, MADV_WILLNEED);
+}
+
+void MappedFile::release() const {
+    // the mapping is private and never written to, hence its pages can be dropped and read from the file again
+    if (m_data)
+        madvise(const_cast<char *>(m_data), m_size, MADV_DONTNEED);
+}
+
+MappedFile::~MappedFile() {
+    if (m_data)
+        munmap(const_cast<char *>(m_data), m_size);
+}
+
+#endif
+
+}
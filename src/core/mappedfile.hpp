@@ -0,0 +1,48 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+
+#include <filesystem>
+#include <string_view>
+
+namespace lightwave {
+
+/**
+ * @brief Maps a file into memory for reading, so that its contents can be accessed (and decoded in parallel) without
+ * copying them into buffers first.
+ * The operating system only loads the pages that are actually accessed, and the mapping is released when this object
+ * is destroyed.
+ */
+class MappedFile {
+    const char *m_data = nullptr;
+    size_t m_size = 0;
+#ifdef LW_OS_WINDOWS
+    void *m_file = nullptr;
+    void *m_mapping = nullptr;
+#endif
+
+public:
+    /// @brief Maps the given file, throwing an exception if it cannot be opened.
+    explicit MappedFile(const std::filesystem::path &path);
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    /// @brief The contents of the file.
+    const char *data() const { return m_data; }
+    /// @brief The size of the file in bytes.
+    size_t size() const { return m_size; }
+    /// @brief The contents of the file as a string view.
+    std::string_view view() const { return { m_data, m_size }; }
+
+    /// @brief Asks the operating system to start reading the entire file in the background, since it will be needed.
+    void prefetch() const;
+    /**
+     * @brief Drops the pages of the file from the memory of this process.
+     * The mapping stays valid, and pages that are accessed afterwards are read from the file again.
+     */
+    void release() const;
+};
+
+}
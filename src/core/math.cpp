@@ -150,7 +150,7 @@ namespace lightwave
     {
         if (!instance->emission())
             return Color::black();
-        return instance->emission()->evaluate(uv, frame.toLocal(wo)).value;
+        return instance->emission()->evaluate(uv, frame.toLocal(wo)).value * Color(tint);
     }
 
     BsdfSample Intersection::sampleBsdf(Sampler &rng) const
@@ -169,13 +169,36 @@ namespace lightwave
         assert_normalized(bsdfSample.wi, {
             logger(EError, "tangent frame: %s / %s / %s", frame.tangent, frame.bitangent, frame.normal);
         });
+        bsdfSample.weight *= Color(tint);
         return bsdfSample;
     }
 
 BsdfEval Intersection::evaluateBsdf(const Vector &wi) const {
     if (!instance->bsdf())
         return BsdfEval::invalid();
-    return instance->bsdf()->evaluate(uv, frame.toLocal(wo), frame.toLocal(wi));
+    BsdfEval result = instance->bsdf()->evaluate(uv, frame.toLocal(wo), frame.toLocal(wi));
+    result.value *= Color(tint);
+    return result;
+}
+
+Color Intersection::evaluateAlbedo() const {
+    if (instance->bsdf())
+        return instance->bsdf()->getAlbedo(uv, frame.toLocal(wo)) * Color(tint);
+    if (instance->emission())
+        return instance->emission()->evaluate(uv, frame.toLocal(wo)).value * Color(tint);
+    return Color::black();
+}
+
+float Intersection::pdfBsdf(const Vector &wi) const {
+    if (!instance->bsdf())
+        return 0;
+    return instance->bsdf()->pdf(uv, frame.toLocal(wo), frame.toLocal(wi));
+}
+
+float Intersection::evaluateRoughness() const {
+    if (!instance->bsdf())
+        return 0;
+    return instance->bsdf()->roughness(uv, frame.toLocal(wo));
 }
 
 }
@@ -1,29 +1,26 @@
 #include "plyparser.hpp"
+#include "mappedfile.hpp"
+#include <lightwave/iterators.hpp>
 #include <lightwave/logger.hpp>
+#include <lightwave/parallel.hpp>
 
-#include <climits>
-#include <fstream>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <sstream>
+#include <string_view>
 
 namespace lightwave {
 
-// https://stackoverflow.com/questions/105252/how-do-i-convert-between-big-endian-and-little-endian-values-in-c
-template <typename T>
-inline T swap_endian(T u) {
-    static_assert(CHAR_BIT == 8, "CHAR_BIT != 8");
-
-    union {
-        T u;
-        unsigned char u8[sizeof(T)];
-    } source, dest;
-
-    source.u = u;
-
-    for (size_t k = 0; k < sizeof(T); k++)
-        dest.u8[k] = source.u8[sizeof(T) - k - 1];
-
-    return dest.u;
+/// @brief Reverses the byte order of a 32 bit word (written so that compilers vectorize loops over it).
+inline uint32_t swap_endian(uint32_t u) {
+    return (u >> 24) | ((u >> 8) & 0xff00) | ((u << 8) & 0xff0000) | (u << 24);
 }
 
+/// @brief The number of vertices or faces that are decoded by one work item.
+static constexpr int ChunkSize = 16384;
+
 struct Header {
     int VertexCount       = 0;
     int FaceCount         = 0;
@@ -35,127 +32,245 @@ struct Header {
     int NZElem            = -1;
     int UElem             = -1;
     int VElem             = -1;
+    int RadiusElem        = -1;
+    int RedElem           = -1;
+    int GreenElem         = -1;
+    int BlueElem          = -1;
+    /// @brief Maps the stored colors to [0,1], as colors are commonly stored as uchar.
+    float ColorScale      = 1;
     int VertexPropCount   = 0;
+    /// @brief The size in bytes of each vertex property in binary files (properties other than floats and uchar colors
+    /// are skipped).
+    std::vector<int> VertexPropSizes;
+    /// @brief The size in bytes of a vertex in binary files.
+    int VertexStride      = 0;
     int IndElem           = -1;
     int MatElem           = -1;
+    /// @brief The size in bytes of the number of indices that precedes each face in binary files.
+    int FaceSizeBytes     = 1;
     bool SwitchEndianness = false;
     bool IsAscii          = false;
 
     [[nodiscard]] inline bool hasVertices() const { return XElem >= 0 && YElem >= 0 && ZElem >= 0; }
     [[nodiscard]] inline bool hasNormals() const { return NXElem >= 0 && NYElem >= 0 && NZElem >= 0; }
     [[nodiscard]] inline bool hasUVs() const { return UElem >= 0 && VElem >= 0; }
+    [[nodiscard]] inline bool hasRadii() const { return RadiusElem >= 0; }
+    [[nodiscard]] inline bool hasColors() const { return RedElem >= 0 && GreenElem >= 0 && BlueElem >= 0; }
     [[nodiscard]] inline bool hasIndices() const { return IndElem >= 0; }
     [[nodiscard]] inline bool hasMaterials() const { return MatElem >= 0; }
 };
 
-static void readPlyContent(
-    std::istream& stream, const Header& header, 
+/// @brief Assembles a vertex from the values of its properties, in the order they are declared in the header.
+static Vertex makeVertex(const Header &header, const float *values) {
+    Vertex vertex;
+    vertex.position = { values[header.XElem], values[header.YElem], values[header.ZElem] };
+    vertex.normal = Vector(values[header.NXElem], values[header.NYElem], values[header.NZElem]).normalized();
+    vertex.texcoords = header.hasUVs() ? Vector2(values[header.UElem], values[header.VElem]) : Vector2(0);
+    return vertex;
+}
+
+/**
+ * @brief Decodes the vertices of a binary file in parallel, passing the index and the property values of each vertex
+ * to the given function.
+ * @returns The number of bytes occupied by the vertices.
+ */
+template <typename F>
+static size_t readBinaryVertices(std::string_view content, const Header &header, F &&visit) {
+    const size_t vertexStride = size_t(header.VertexStride);
+    const size_t vertexBytes = size_t(header.VertexCount) * vertexStride;
+    if (content.size() < vertexBytes)
+        lightwave_throw("file is truncated (%d bytes of content, %d needed)", content.size(), vertexBytes);
+    const bool onlyWords = vertexStride == size_t(header.VertexPropCount) * sizeof(uint32_t);
+
+    // vertices are copied into a buffer per thread, where the byte order of all values is fixed at once
+    for_each_parallel(
+        ChunkedRange(header.VertexCount, ChunkSize),
+        [](int) { return std::vector<uint32_t>(); },
+        [&](std::vector<uint32_t> &words, Range chunk) {
+            words.resize(size_t(chunk.count()) * header.VertexPropCount);
+            if (onlyWords) {
+                std::memcpy(words.data(), content.data() + size_t(*chunk.begin()) * vertexStride, words.size() * sizeof(uint32_t));
+                if (header.SwitchEndianness) {
+                    for (uint32_t &word : words) word = swap_endian(word);
+                }
+            } else {
+                // single bytes (e.g., colors stored as uchar) are converted to floats, and properties of other sizes are
+                // skipped, which leaves a zero in their place, hence the properties are gathered one by one
+                uint32_t *word = words.data();
+                for (int i : chunk) {
+                    const char *property = content.data() + size_t(i) * vertexStride;
+                    for (const int size : header.VertexPropSizes) {
+                        *word = 0;
+                        if (size == sizeof(uint32_t)) {
+                            std::memcpy(word, property, sizeof(uint32_t));
+                            if (header.SwitchEndianness)
+                                *word = swap_endian(*word);
+                        } else if (size == 1) {
+                            *word = std::bit_cast<uint32_t>(float(uint8_t(*property)));
+                        }
+                        word++;
+                        property += size;
+                    }
+                }
+            }
+
+            const float *values = reinterpret_cast<const float *>(words.data());
+            for (int i : chunk) {
+                visit(i, values);
+                values += header.VertexPropCount;
+            }
+        });
+    return vertexBytes;
+}
+
+static void readBinaryContent(
+    std::string_view content, const Header &header,
     std::vector<Vector3i> &indices,
     std::vector<Vertex> &vertices
 ) {
-    const auto readFloat = [&]() {
-        float val = 0;
-        stream.read(reinterpret_cast<char*>(&val), sizeof(val));
-        if (header.SwitchEndianness)
-            val = swap_endian<float>(val);
-        return val;
-    };
-
-    const auto readIdx = [&]() {
-        uint32_t val = 0;
-        stream.read(reinterpret_cast<char*>(&val), sizeof(val));
-        if (header.SwitchEndianness)
-            val = swap_endian<uint32_t>(val);
-        return val;
-    };
-
-    vertices.reserve(header.VertexCount);
-    if (!header.hasNormals()) lightwave_throw("no normals found");
-
-    for (int i = 0; i < header.VertexCount; ++i) {
-        float x = 0, y = 0, z = 0;
-        float nx = 0, ny = 0, nz = 0;
-        float u = 0, v = 0;
-
-        if (header.IsAscii) {
-            std::string line;
-            if (!std::getline(stream, line))
-                lightwave_throw("not enough vertices given");
-
-            std::stringstream sstream(line);
-            int elem = 0;
-            while (sstream) {
-                float val = 0;
-                sstream >> val;
-
-                if      (header.XElem  == elem) x = val;
-                else if (header.YElem  == elem) y = val;
-                else if (header.ZElem  == elem) z = val;
-                else if (header.NXElem == elem) nx = val;
-                else if (header.NYElem == elem) ny = val;
-                else if (header.NZElem == elem) nz = val;
-                else if (header.UElem  == elem) u = val;
-                else if (header.VElem  == elem) v = val;
-
-                elem++;
+    const size_t faceStride = size_t(header.FaceSizeBytes) + 3 * sizeof(uint32_t);
+    const size_t vertexBytes = size_t(header.VertexCount) * size_t(header.VertexStride);
+    if (content.size() < vertexBytes + size_t(header.FaceCount) * faceStride)
+        lightwave_throw("file is truncated (%d bytes of content, %d needed)", content.size(),
+            vertexBytes + size_t(header.FaceCount) * faceStride);
+
+    vertices.resize(header.VertexCount);
+    readBinaryVertices(content, header, [&](int i, const float *values) {
+        vertices[i] = makeVertex(header, values);
+    });
+
+    // faces are not aligned to four bytes (and might have the wrong number of indices), hence they are decoded one by one
+    const char *faces = content.data() + vertexBytes;
+    std::atomic<bool> onlyTriangles = true;
+    indices.resize(header.FaceCount);
+    for_each_parallel(ChunkedRange(header.FaceCount, ChunkSize), [&](Range chunk) {
+        for (int i : chunk) {
+            const char *face = faces + size_t(i) * faceStride;
+            uint32_t elems = 0;
+            if (header.FaceSizeBytes == 1) {
+                elems = uint8_t(face[0]);
+            } else {
+                std::memcpy(&elems, face, sizeof(elems));
+                if (header.SwitchEndianness)
+                    elems = swap_endian(elems);
             }
-        } else {
-            for (int elem = 0; elem < header.VertexPropCount; ++elem) {
-                float val = readFloat();
-                if      (header.XElem  == elem) x = val;
-                else if (header.YElem  == elem) y = val;
-                else if (header.ZElem  == elem) z = val;
-                else if (header.NXElem == elem) nx = val;
-                else if (header.NYElem == elem) ny = val;
-                else if (header.NZElem == elem) nz = val;
-                else if (header.UElem  == elem) u = val;
-                else if (header.VElem  == elem) v = val;
+            if (elems != 3) {
+                onlyTriangles = false;
+                return;
+            }
+
+            uint32_t words[3];
+            std::memcpy(words, face + header.FaceSizeBytes, sizeof(words));
+            for (int elem = 0; elem < 3; elem++) {
+                indices[i][elem] = int(header.SwitchEndianness ? swap_endian(words[elem]) : words[elem]);
             }
         }
+    });
+    if (!onlyTriangles) lightwave_throw("only triangles supported");
+}
 
-        Vertex vertex;
-        vertex.position = { x, y, z };
-        vertex.normal = Vector(nx, ny, nz).normalized();
-        vertex.texcoords = Vector2(u, v);
-        vertices.push_back(vertex);
+/// @brief Splits text into lines (without line terminators), stopping once the requested number of lines is found.
+static std::vector<std::string_view> splitLines(std::string_view content, size_t count) {
+    std::vector<std::string_view> lines;
+    lines.reserve(count);
+    while (lines.size() < count && !content.empty()) {
+        const size_t end = content.find('\n');
+        std::string_view line = content.substr(0, end);
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        lines.push_back(line);
+        if (end == std::string_view::npos)
+            break;
+        content.remove_prefix(end + 1);
     }
+    return lines;
+}
 
-    if (vertices.empty()) lightwave_throw("no vertices found");
-
-    indices.resize(header.FaceCount);
-    size_t indicesIndex = 0;
-
-    if (header.IsAscii) {
-        for (int i = 0; i < header.FaceCount; ++i) {
-            std::string line;
-            if (!std::getline(stream, line)) 
-                lightwave_throw("not enough indices given");
+/// @brief Parses the next whitespace separated number of a line, returning false if there is none.
+template <typename T>
+static bool parseNext(std::string_view &line, T &value) {
+    const char *first = line.data();
+    const char *last = line.data() + line.size();
+    while (first != last && (*first == ' ' || *first == '\t')) first++;
+    if (first != last && *first == '+') first++;
+    const auto [end, error] = std::from_chars(first, last, value);
+    if (error != std::errc())
+        return false;
+    line.remove_prefix(end - line.data());
+    return true;
+}
 
-            std::stringstream sstream(line);
+/**
+ * @brief Parses the vertex lines of an ASCII file in parallel, passing the index and the property values of each
+ * vertex to the given function.
+ */
+template <typename F>
+static void readAsciiVertices(const std::vector<std::string_view> &lines, const Header &header, F &&visit) {
+    if (lines.size() < size_t(header.VertexCount))
+        lightwave_throw("not enough vertices given");
+
+    for_each_parallel(
+        ChunkedRange(header.VertexCount, ChunkSize),
+        [&](int) { return std::vector<float>(header.VertexPropCount); },
+        [&](std::vector<float> &values, Range chunk) {
+            for (int i : chunk) {
+                std::string_view line = lines[i];
+                // missing values are treated as zero
+                for (float &value : values) {
+                    if (!parseNext(line, value))
+                        value = 0;
+                }
+                visit(i, values.data());
+            }
+        });
+}
 
+static void readAsciiContent(
+    std::string_view content, const Header &header,
+    std::vector<Vector3i> &indices,
+    std::vector<Vertex> &vertices
+) {
+    const std::vector<std::string_view> lines = splitLines(content, size_t(header.VertexCount) + header.FaceCount);
+    vertices.resize(header.VertexCount);
+    readAsciiVertices(lines, header, [&](int i, const float *values) {
+        vertices[i] = makeVertex(header, values);
+    });
+    if (lines.size() < size_t(header.VertexCount) + header.FaceCount)
+        lightwave_throw("not enough indices given");
+
+    std::atomic<bool> onlyTriangles = true;
+    indices.resize(header.FaceCount);
+    for_each_parallel(ChunkedRange(header.FaceCount, ChunkSize), [&](Range chunk) {
+        for (int i : chunk) {
+            std::string_view line = lines[size_t(header.VertexCount) + i];
             uint32_t elems = 0;
-            sstream >> elems;
-            if (elems != 3) lightwave_throw("only triangles supported");
-
-            for (uint32_t elem = 0; elem < elems; ++elem) {
-                sstream >> indices[indicesIndex][elem];
+            if (!parseNext(line, elems) || elems != 3) {
+                onlyTriangles = false;
+                return;
             }
-            indicesIndex++;
-        }
-    } else {
-        for (int i = 0; i < header.FaceCount; ++i) {
-            uint8_t elems = 0;
-            stream.read(reinterpret_cast<char*>(&elems), sizeof(elems));
-            if (elems != 3) lightwave_throw("only triangles supported");
-
-            for (uint32_t elem = 0; elem < elems; ++elem) {
-                indices[indicesIndex][elem] = readIdx();
+            for (int elem = 0; elem < 3; elem++) {
+                if (!parseNext(line, indices[i][elem]))
+                    indices[i][elem] = 0;
             }
-            indicesIndex++;
         }
+    });
+    if (!onlyTriangles) lightwave_throw("only triangles supported");
+}
+
+static void readPlyContent(
+    std::string_view content, const Header& header,
+    std::vector<Vector3i> &indices,
+    std::vector<Vertex> &vertices
+) {
+    if (!header.hasNormals()) lightwave_throw("no normals found");
+
+    if (header.IsAscii) {
+        readAsciiContent(content, header, indices, vertices);
+    } else {
+        readBinaryContent(content, header, indices, vertices);
     }
 
-    if (indicesIndex != indices.size()) lightwave_throw("too few faces (%d found, %d needed)", indicesIndex, indices.size());
+    if (vertices.empty()) lightwave_throw("no vertices found");
 
     if (!header.hasUVs()) {
         Bounds bbox;
@@ -175,6 +290,19 @@ static void readPlyContent(
     }
 }
 
+/// @brief Returns the size in bytes of a scalar property type, or zero if the type is unknown.
+static int scalarTypeSize(const std::string &type) {
+    if (type == "char" || type == "uchar" || type == "int8" || type == "uint8")
+        return 1;
+    if (type == "short" || type == "ushort" || type == "int16" || type == "uint16")
+        return 2;
+    if (type == "int" || type == "uint" || type == "float" || type == "int32" || type == "uint32" || type == "float32")
+        return 4;
+    if (type == "double" || type == "float64")
+        return 8;
+    return 0;
+}
+
 static inline bool isAllowedVertIndType(const std::string& str) {
     return str == "uchar"
            || str == "int"
@@ -182,6 +310,114 @@ static inline bool isAllowedVertIndType(const std::string& str) {
            || str == "uint";
 }
 
+/**
+ * @brief Parses the header of a PLY file.
+ * @returns The content of the file that follows the header.
+ */
+static std::string_view readHeader(std::string_view content, Header &header) {
+    if (!content.starts_with("ply"))
+        lightwave_throw("file is not in PLY format");
+    const size_t headerEnd = content.find("end_header");
+    if (headerEnd == std::string_view::npos)
+        lightwave_throw("file has no end_header");
+    const size_t bodyStart = content.find('\n', headerEnd);
+    if (bodyStart == std::string_view::npos)
+        lightwave_throw("file has no content");
+
+    std::stringstream stream { std::string(content.substr(0, headerEnd)) };
+    std::string magic;
+    stream >> magic;
+
+    std::string method;
+
+    int facePropCounter = 0;
+    std::string element;
+    for (std::string line; std::getline(stream, line);) {
+        std::stringstream sstream(line);
+
+        std::string action;
+        sstream >> action;
+        if (action == "comment")
+            continue;
+        else if (action == "format") {
+            sstream >> method;
+        } else if (action == "element") {
+            std::string type;
+            sstream >> type;
+            element = type;
+            if (type == "vertex")
+                sstream >> header.VertexCount;
+            else if (type == "face")
+                sstream >> header.FaceCount;
+        } else if (action == "property") {
+            std::string type;
+            sstream >> type;
+            if (type != "list" && element != "vertex") {
+                lightwave_throw("only list properties are supported for element %s", element);
+            } else if (type == "float" || type == "float32") {
+                std::string name;
+                sstream >> name;
+                if      (name == "x" ) header.XElem  = header.VertexPropCount;
+                else if (name == "y" ) header.YElem  = header.VertexPropCount;
+                else if (name == "z" ) header.ZElem  = header.VertexPropCount;
+                else if (name == "nx") header.NXElem = header.VertexPropCount;
+                else if (name == "ny") header.NYElem = header.VertexPropCount;
+                else if (name == "nz") header.NZElem = header.VertexPropCount;
+                else if (name == "u" || name == "s") header.UElem = header.VertexPropCount;
+                else if (name == "v" || name == "t") header.VElem = header.VertexPropCount;
+                else if (name == "radius") header.RadiusElem = header.VertexPropCount;
+                else if (name == "red"   ) header.RedElem = header.VertexPropCount;
+                else if (name == "green" ) header.GreenElem = header.VertexPropCount;
+                else if (name == "blue"  ) header.BlueElem = header.VertexPropCount;
+                ++header.VertexPropCount;
+                header.VertexPropSizes.push_back(sizeof(float));
+                header.VertexStride += sizeof(float);
+            } else if (type == "list") {
+                ++facePropCounter;
+
+                std::string countType;
+                sstream >> countType;
+
+                std::string indType;
+                sstream >> indType;
+
+                std::string name;
+                sstream >> name;
+                if (!isAllowedVertIndType(countType)) {
+                    lightwave_throw("only 'property list uchar int' is supported");
+                    continue;
+                }
+
+                if (name == "vertex_indices" || name == "vertex_index") {
+                    header.IndElem = facePropCounter - 1;
+                    header.FaceSizeBytes = countType == "uchar" || countType == "uint8_t" ? 1 : 4;
+                }
+            } else if (const int size = scalarTypeSize(type)) {
+                // colors stored as uchar are read as well, other vertex properties are not used but still need to be
+                // skipped
+                if (type == "uchar" || type == "uint8") {
+                    std::string name;
+                    sstream >> name;
+                    if      (name == "red"  ) header.RedElem = header.VertexPropCount;
+                    else if (name == "green") header.GreenElem = header.VertexPropCount;
+                    else if (name == "blue" ) header.BlueElem = header.VertexPropCount;
+                    if (name == "red" || name == "green" || name == "blue")
+                        header.ColorScale = 1.f / 255;
+                }
+                ++header.VertexPropCount;
+                header.VertexPropSizes.push_back(size);
+                header.VertexStride += size;
+            } else {
+                lightwave_throw("unsupported property type %s", type);
+            }
+        }
+    }
+
+    header.SwitchEndianness = (method == "binary_big_endian");
+    header.IsAscii          = (method == "ascii");
+    return content.substr(bodyStart + 1);
+}
+
 void readPLY(
     const std::filesystem::path &path,
     std::vector<Vector3i> &indices,
@@ -189,84 +425,50 @@ void readPLY(
 ) {
     logger(EInfo, "loading mesh %s", path);
     try {
-        std::fstream stream(path, std::ios::in | std::ios::binary);
-        if (!stream)
-            lightwave_throw("error opening file");
-
-        // Header
-        std::string magic;
-        stream >> magic;
-        if (magic != "ply")
-            lightwave_throw("file is not in PLY format");
-
-        std::string method;
+        const MappedFile file(path);
         Header header;
-
-        int facePropCounter = 0;
-        for (std::string line; std::getline(stream, line);) {
-            std::stringstream sstream(line);
-
-            std::string action;
-            sstream >> action;
-            if (action == "comment")
-                continue;
-            else if (action == "format") {
-                sstream >> method;
-            } else if (action == "element") {
-                std::string type;
-                sstream >> type;
-                if (type == "vertex")
-                    sstream >> header.VertexCount;
-                else if (type == "face")
-                    sstream >> header.FaceCount;
-            } else if (action == "property") {
-                std::string type;
-                sstream >> type;
-                if (type == "float") {
-                    std::string name;
-                    sstream >> name;
-                    if      (name == "x" ) header.XElem  = header.VertexPropCount;
-                    else if (name == "y" ) header.YElem  = header.VertexPropCount;
-                    else if (name == "z" ) header.ZElem  = header.VertexPropCount;
-                    else if (name == "nx") header.NXElem = header.VertexPropCount;
-                    else if (name == "ny") header.NYElem = header.VertexPropCount;
-                    else if (name == "nz") header.NZElem = header.VertexPropCount;
-                    else if (name == "u" || name == "s") header.UElem = header.VertexPropCount;
-                    else if (name == "v" || name == "t") header.VElem = header.VertexPropCount;
-                    ++header.VertexPropCount;
-                } else if (type == "list") {
-                    ++facePropCounter;
-
-                    std::string countType;
-                    sstream >> countType;
-
-                    std::string indType;
-                    sstream >> indType;
-
-                    std::string name;
-                    sstream >> name;
-                    if (!isAllowedVertIndType(countType)) {
-                        lightwave_throw("only 'property list uchar int' is supported");
-                        continue;
-                    }
-
-                    if (name == "vertex_indices" || name == "vertex_index")
-                        header.IndElem = facePropCounter - 1;
-                } else {
-                    lightwave_throw("only float or list properties allowed");
-                    ++header.VertexPropCount;
-                }
-            } else if (action == "end_header")
-                break;
-        }
+        const std::string_view content = readHeader(file.view(), header);
 
         // Content
         if (!header.hasVertices() || !header.hasIndices() || header.VertexCount <= 0 || header.FaceCount <= 0)
             lightwave_throw("does not contain valid mesh data");
 
-        header.SwitchEndianness = (method == "binary_big_endian");
-        header.IsAscii          = (method == "ascii");
-        readPlyContent(stream, header, indices, vertices);
+        readPlyContent(content, header, indices, vertices);
+    } catch (...) {
+        lightwave_throw_nested("while parsing %s", path);
+    }
+}
+
+void readPLYPoints(
+    const std::filesystem::path &path,
+    std::vector<Point> &positions,
+    std::vector<float> &radii,
+    std::vector<Color> &colors
+) {
+    logger(EInfo, "loading points %s", path);
+    try {
+        const MappedFile file(path);
+        Header header;
+        const std::string_view content = readHeader(file.view(), header);
+        if (!header.hasVertices() || header.VertexCount <= 0)
+            lightwave_throw("does not contain any points");
+
+        positions.resize(header.VertexCount);
+        radii.resize(header.hasRadii() ? header.VertexCount : 0);
+        colors.resize(header.hasColors() ? header.VertexCount : 0);
+        const auto visit = [&](int i, const float *values) {
+            positions[i] = { values[header.XElem], values[header.YElem], values[header.ZElem] };
+            if (header.hasRadii())
+                radii[i] = values[header.RadiusElem];
+            if (header.hasColors())
+                colors[i] = header.ColorScale *
+                            Color(values[header.RedElem], values[header.GreenElem], values[header.BlueElem]);
+        };
+        if (header.IsAscii) {
+            readAsciiVertices(splitLines(content, header.VertexCount), header, visit);
+        } else {
+            readBinaryVertices(content, header, visit);
+        }
     } catch (...) {
         lightwave_throw_nested("while parsing %s", path);
     }
@@ -1,4 +1,5 @@
 #include <lightwave/math.hpp>
+#include <lightwave/color.hpp>
 
 #include <string>
 #include <vector>
@@ -12,4 +13,17 @@ void readPLY(
     std::vector<Vertex> &vertices
 );
 
+/**
+ * @brief Reads the vertices of a PLY file as points (e.g., of a point cloud), ignoring any faces.
+ * @param radii Receives the "radius" property of each point, or is left empty if the file has no such property.
+ * @param colors Receives the "red", "green" and "blue" properties of each point (mapped to [0,1] if stored as uchar),
+ * or is left empty if the file has no colors.
+ */
+void readPLYPoints(
+    const std::filesystem::path &path,
+    std::vector<Point> &positions,
+    std::vector<float> &radii,
+    std::vector<Color> &colors
+);
+
 }
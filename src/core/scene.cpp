@@ -2,24 +2,97 @@
 #include <lightwave/registry.hpp>
 #include <lightwave/integrator.hpp>
 #include <lightwave/shape.hpp>
+#include <lightwave/instance.hpp>
 #include <lightwave/camera.hpp>
 #include <lightwave/light.hpp>
+#include <lightwave/sampler.hpp>
+
+#include "geometrypager.hpp"
+#include "lightbvh.hpp"
 
 namespace lightwave {
 
+/**
+ * @brief Lets every instance choose a simplified version of its shape that suffices for the area its bounding sphere
+ * covers in the image of the camera.
+ */
+static void selectLevelsOfDetail(const Camera &camera, const std::vector<ref<Shape>> &shapes, float quality) {
+    // the angle covered by one pixel is estimated across the image (which also averages out the distortion of
+    // non-pinhole cameras)
+    const Point2 lensCenter(0.5f);
+    const Ray left = camera.sample(Point2(-1, 0), lensCenter).ray;
+    const Ray right = camera.sample(Point2(+1, 0), lensCenter).ray;
+    const Point eye = camera.sample(Point2(0, 0), lensCenter).ray.origin;
+    const float pixelAngle =
+        safe_acos(left.direction.normalized().dot(right.direction.normalized())) / camera.resolution().x();
+
+    for (const auto &shape : shapes) {
+        const auto instance = std::dynamic_pointer_cast<Instance>(shape);
+        if (!instance)
+            continue;
+        const Bounds bounds = instance->getBoundingBox();
+        if (bounds.isUnbounded())
+            continue;
+        const float radius = bounds.diagonal().length() / 2;
+        const float distance = (bounds.center() - eye).length();
+        if (distance <= radius)
+            continue;
+        const float pixelRadius = std::asin(radius / distance) / pixelAngle;
+        instance->selectLevelOfDetail(quality * Pi * pixelRadius * pixelRadius);
+    }
+}
+
 Scene::Scene(const Properties &properties) {
     m_camera = properties.getChild<Camera>();
     m_background = properties.getOptionalChild<BackgroundLight>();
     m_lights = properties.getChildren<Light>();
-    
+
     const std::vector<ref<Shape>> entities = properties.getChildren<Shape>();
-    if (entities.size() == 1) {
+    // distant instances use simplified meshes, which keep roughly as many triangles per covered pixel as the quality
+    // specifies (zero disables simplification)
+    const float lodQuality = properties.get<float>("lodQuality", 0);
+    if (lodQuality > 0) {
+        selectLevelsOfDetail(*m_camera, entities, lodQuality);
+    }
+    // flattening bakes meshes that are only used by one instance into world coordinates, which trades loading time
+    // for faster ray traversal
+    const bool flatten = properties.get<bool>("flatten", false);
+    if (entities.size() == 1 && !flatten) {
         m_shape = entities[0];
     } else {
-        m_shape = std::static_pointer_cast<Shape>(Registry::create("shape", "group", properties));
+        m_shape = std::static_pointer_cast<Shape>(Registry::create("shape", flatten ? "flattened" : "group", properties));
     }
 
+    // meshes mapped from ".lwmesh" files are released from memory (and read again when rays reach them) once the
+    // geometry in use exceeds the budget in MiB (zero keeps all geometry resident)
+    const int geometryBudget = properties.get<int>("geometryBudget", 0);
+    GeometryPager::global().setBudget(size_t(std::max(geometryBudget, 0)) << 20);
+
+    // instances are numbered per scene (instead of in the order they were created), so that a scene gets the same
+    // indices no matter how many scenes have been loaded before
+    int nextInstanceIndex = 0;
+    m_shape->assignInstanceIndices(nextInstanceIndex);
     m_shape->markAsVisible();
+
+    enum class LightSelection { Uniform, Power, Hierarchy };
+    const LightSelection lightSelection = properties.getEnum<LightSelection>("lightSelection", LightSelection::Hierarchy, {
+        { "uniform", LightSelection::Uniform },
+        { "power", LightSelection::Power },
+        { "bvh", LightSelection::Hierarchy },
+    });
+    if (lightSelection != LightSelection::Uniform && !m_lights.empty()) {
+        // the power based distribution also serves as fallback for the hierarchy whenever no shading point is known
+        const Bounds sceneBounds = m_shape->getBoundingBox();
+        std::vector<float> powers;
+        for (const auto &light : m_lights) {
+            m_lightIndices[light.get()] = int(powers.size());
+            powers.push_back(light->power(sceneBounds).luminance());
+        }
+        m_lightPower = AliasTable(powers);
+    }
+    if (lightSelection == LightSelection::Hierarchy && !m_lights.empty()) {
+        m_lightHierarchy = std::make_shared<LightHierarchy>(m_lights);
+    }
 }
 
 std::string Scene::toString() const {
@@ -35,7 +108,8 @@ std::string Scene::toString() const {
 
 Intersection Scene::intersect(const Ray &ray, Sampler &rng) const {
     Intersection its(-ray.direction);
-    m_shape->intersect(ray, its, rng);
+    if (m_shape->intersect(ray, its, rng) && its)
+        its.instance->computeSurfaceInteraction(ray, its);
     return its;
 }
 
@@ -52,6 +126,14 @@ BackgroundLightEval Scene::evaluateBackground(const Vector &direction) const {
 }
 
 LightSample Scene::sampleLight(Sampler &rng) const {
+    if (!m_lightPower.empty()) {
+        const int lightIndex = m_lightPower.sample(rng.next());
+        return {
+            .light = m_lights[lightIndex].get(),
+            .probability = m_lightPower.pmf(lightIndex),
+        };
+    }
+
     int lightIndex = int(rng.next() * m_lights.size());
     lightIndex = std::min(lightIndex, int(m_lights.size()) - 1);
     return {
@@ -61,9 +143,23 @@ LightSample Scene::sampleLight(Sampler &rng) const {
 }
 
 float Scene::lightSelectionProbability(const Light *light) const {
+    if (!m_lightPower.empty()) {
+        const auto it = m_lightIndices.find(light);
+        return it == m_lightIndices.end() ? 0 : m_lightPower.pmf(it->second);
+    }
     return float(1) / m_lights.size();
 }
 
+LightSample Scene::sampleLight(const Point &origin, const Vector &normal, Sampler &rng) const {
+    if (!m_lightHierarchy) return sampleLight(rng);
+    return m_lightHierarchy->sample(origin, normal, rng.next());
+}
+
+float Scene::lightSelectionProbability(const Light *light, const Point &origin, const Vector &normal) const {
+    if (!m_lightHierarchy) return lightSelectionProbability(light);
+    return m_lightHierarchy->pmf(light, origin, normal);
+}
+
 Bounds Scene::getBoundingBox() const {
     return m_shape->getBoundingBox();
 }
@@ -35,20 +35,11 @@ namespace lightwave
         Color Li(const Ray &ray, Sampler &rng) override
         {
             Intersection its = m_scene->intersect(ray, rng);
-            Color albedo;
-            if (its.t != Infinity)
-            {   
-                if (its.instance->bsdf()){
-                albedo = its.instance->bsdf()->getAlbedo(its.uv, its.wo);
-                }
-                else
-                albedo = its.instance->emission()->evaluate(its.uv, its.wo).value;
+            if (!its)
+            {
+                return Color(0., 0., 0.);
             }
-            else
-                albedo = Color(0., 0., 0.);
-
-            
-            return albedo;
+            return its.evaluateAlbedo();
         }
 
         /// @brief An optional textual representation of this class, which can be useful for debugging.
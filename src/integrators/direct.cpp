@@ -33,11 +33,26 @@ namespace lightwave
          * This will be run for each pixel of the image, potentially with multiple samples for each pixel.
          */
         Color Li(const Ray &ray, Sampler &rng) override
+        {
+            return Li(ray, rng, nullptr);
+        }
+
+        Color Li(const Ray &ray, RenderContext &context) override
+        {
+            return Li(ray, *context.sampler, &context);
+        }
+
+        /// @brief Computes the incident radiance, reporting the first intersection to @c context (if not @c nullptr ).
+        Color Li(const Ray &ray, Sampler &rng, RenderContext *context)
         {
             Color color = Color(0.0f);
             Color weight = Color(1.0f);
 
             Intersection first_its = m_scene->intersect(ray, rng);
+            if (context)
+            {
+                context->recordPrimaryHit(first_its);
+            }
             if (!first_its)
             {
                 return m_scene->evaluateBackground(ray.direction).value;
@@ -45,21 +60,25 @@ namespace lightwave
             else
             {
                 color += first_its.evaluateEmission();
+                const Point origin = first_its.position;
+                const Vector normal = first_its.frame.normal;
 
                 if (m_scene->hasLights())
                 {
-                    LightSample ls = m_scene->sampleLight(rng);
-                    if (!ls.light->canBeIntersected())
+                    LightSample ls = m_scene->sampleLight(first_its.position, first_its.frame.normal, rng);
+                    if (!ls.isInvalid())
                     {
                         DirectLightSample dls = ls.light->sampleDirect(first_its.position, rng);
 
                         Vector toLight = dls.wi; // Directional light's direction
-                        bool isIntersecting = m_scene->intersect(Ray(first_its.position, toLight), dls.distance, rng);
+                        bool isIntersecting = dls.isInvalid() || m_scene->intersect(Ray(first_its.position, toLight), dls.distance, rng);
 
                         if (!isIntersecting)
                         { // Check if light direction is visible
                             Color bsdfVal = first_its.evaluateBsdf(toLight).value;
-                            color += (bsdfVal * dls.weight *weight / ls.probability);
+                            // lights that can be intersected can also be found by Bsdf sampling, hence both techniques are weighted
+                            const float misWeight = ls.light->canBeIntersected() ? balanceHeuristic(ls.probability * dls.pdf, first_its.pdfBsdf(toLight)) : 1;
+                            color += (bsdfVal * dls.weight *weight / ls.probability * misWeight);
                             // weight *= dls.weight;
                         }
                     }
@@ -72,13 +91,28 @@ namespace lightwave
                 weight *= b.weight;
                 Ray second_ray{first_its.position, b.wi};
                 Intersection second_its = m_scene->intersect(second_ray, rng);
+                const float bsdfPdf = first_its.pdfBsdf(b.wi);
                 if (!second_its)
                 {
-                    color += (m_scene->evaluateBackground(second_ray.direction).value * weight);
+                    float misWeight = 1;
+                    if (bsdfPdf > 0 && m_scene->hasBackground() && m_scene->hasLights())
+                    {
+                        const float lightPdf = m_scene->lightSelectionProbability(m_scene->background(), origin, normal) *
+                                               m_scene->background()->pdf(second_ray.direction);
+                        misWeight = balanceHeuristic(bsdfPdf, lightPdf);
+                    }
+                    color += (m_scene->evaluateBackground(second_ray.direction).value * weight * misWeight);
                 }
                 else
                 {
-                    color += (second_its.evaluateEmission() * weight);
+                    float misWeight = 1;
+                    const Light *light = second_its.instance->light();
+                    if (bsdfPdf > 0 && light && m_scene->hasLights())
+                    {
+                        const float lightPdf = m_scene->lightSelectionProbability(light, origin, normal) * light->pdf(origin, second_its);
+                        misWeight = balanceHeuristic(bsdfPdf, lightPdf);
+                    }
+                    color += (second_its.evaluateEmission() * weight * misWeight);
                 }
             }
             return color;
@@ -0,0 +1,187 @@
+#include <lightwave.hpp>
+
+namespace lightwave {
+
+/**
+ * @brief Accumulates the contributions that one thread splats onto arbitrary pixels of the image.
+ * Each thread owns its own film, hence splatting requires no synchronization. The image is divided into tiles that
+ * are only allocated once a thread splats into them, so that memory is not wasted on regions a thread never sees.
+ */
+class SplatFilm {
+    static constexpr int TileSize = 32;
+
+    Vector2i m_resolution;
+    Vector2i m_tileCount;
+    std::vector<std::unique_ptr<Color[]>> m_tiles;
+
+public:
+    SplatFilm(const Vector2i &resolution)
+    : m_resolution(resolution) {
+        m_tileCount = Vector2i((resolution.x() + TileSize - 1) / TileSize, (resolution.y() + TileSize - 1) / TileSize);
+        m_tiles.resize(m_tileCount.product());
+    }
+
+    /// @brief The number of tiles the image is divided into.
+    int tileCount() const { return int(m_tiles.size()); }
+
+    /// @brief Adds a contribution to a pixel.
+    void add(const Point2i &pixel, const Color &value) {
+        auto &tile = m_tiles[(pixel.y() / TileSize) * m_tileCount.x() + pixel.x() / TileSize];
+        if (!tile)
+            tile = std::make_unique<Color[]>(TileSize * TileSize);
+        tile[(pixel.y() % TileSize) * TileSize + pixel.x() % TileSize] += value;
+    }
+
+    /// @brief Adds the scaled contributions of one tile to an image.
+    void addTo(Image &image, int tileIndex, float scale) const {
+        const auto &tile = m_tiles[tileIndex];
+        if (!tile)
+            return;
+        const Point2i origin((tileIndex % m_tileCount.x()) * TileSize, (tileIndex / m_tileCount.x()) * TileSize);
+        for (int y = 0; y < TileSize && origin.y() + y < m_resolution.y(); y++) {
+            for (int x = 0; x < TileSize && origin.x() + x < m_resolution.x(); x++) {
+                image.get(Point2i(origin.x() + x, origin.y() + y)) += scale * tile[y * TileSize + x];
+            }
+        }
+    }
+};
+
+/**
+ * @brief Traces paths starting at light sources and connects each of their vertices to the camera (also known as
+ * particle tracing), which complements path tracing for light transport the camera can hardly find, such as caustics
+ * seen through specular surfaces.
+ * Since connections can land on any pixel, their contributions are splatted into a @ref SplatFilm per thread, which
+ * are summed up after rendering. For each sample per pixel, as many light paths are traced as the image has pixels.
+ * @note Connections to the camera evaluate the Bsdf in the opposite direction of camera paths, which assumes that
+ * Bsdfs are symmetric. Light sources need to support @ref Light::sampleEmission and the camera needs to support
+ * @ref Camera::sampleImportance .
+ */
+class LightTracer : public SamplingIntegrator {
+    /// @brief The maximum number of segments of a path, including the connection to the camera.
+    int m_depth;
+
+    struct ThreadState {
+        ref<Sampler> sampler;
+        SplatFilm film;
+    };
+
+    void tracePath(ThreadState &state, const Bounds &sceneBounds) const {
+        Sampler &rng = *state.sampler;
+        const Camera &camera = *m_scene->camera();
+
+        if (!m_scene->hasLights())
+            return;
+        const LightSample ls = m_scene->sampleLight(rng);
+        if (ls.isInvalid())
+            return;
+        const EmissionSample es = ls.light->sampleEmission(sceneBounds, rng);
+        if (es.isInvalid())
+            return;
+
+        // light sources with a surface in the scene can be seen by the camera directly
+        const Instance *emitter = es.surface.instance;
+        if (emitter && emitter->isVisible() && emitter->emission()) {
+            const CameraImportanceSample cs = camera.sampleImportance(es.surface.position, rng);
+            if (!cs.isInvalid() && !m_scene->intersect(Ray(es.surface.position, cs.wi), cs.distance, rng)) {
+                const Color emission = emitter->emission()->evaluate(es.surface.uv, es.surface.frame.toLocal(cs.wi)).value *
+                                      Color(es.surface.tint);
+                const float cosTheta = std::abs(es.surface.frame.normal.dot(cs.wi));
+                state.film.add(cs.pixel, emission * cosTheta * cs.weight / (es.surface.pdf * ls.probability));
+            }
+        }
+
+        Color weight = es.weight / ls.probability;
+        Ray ray = es.ray;
+        for (int segments = 2; segments <= m_depth; segments++) {
+            const Intersection its = m_scene->intersect(ray, rng);
+            if (!its)
+                break;
+
+            const CameraImportanceSample cs = camera.sampleImportance(its.position, rng);
+            if (!cs.isInvalid() && !m_scene->intersect(Ray(its.position, cs.wi), cs.distance, rng)) {
+                state.film.add(cs.pixel, weight * its.evaluateBsdf(cs.wi).value * cs.weight);
+            }
+
+            if (segments == m_depth)
+                break;
+            const BsdfSample b = its.sampleBsdf(rng);
+            if (b.isInvalid())
+                break;
+            weight *= b.weight;
+            ray = Ray(its.position, b.wi, ray.depth + 1);
+        }
+    }
+
+public:
+    LightTracer(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_depth = properties.get<int>("depth", 2);
+    }
+
+    void execute() override {
+        initializeImages();
+        if (!m_scene->hasLights()) {
+            logger(EWarn, "the scene has no light sources that can be sampled, the image will be black");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const Bounds sceneBounds = m_scene->getBoundingBox();
+        const int sampleCount = m_sampler->samplesPerPixel();
+
+        std::vector<ThreadState> states;
+        states.reserve(numWorkerThreads());
+        for (int thread = 0; thread < numWorkerThreads(); thread++) {
+            states.push_back({ m_sampler->clone(), SplatFilm(resolution) });
+        }
+
+        // light paths are numbered like pixels, so that samplers which stratify across pixels also stratify paths
+        ProgressReporter progress { resolution.product() };
+        for_each_parallel(
+            ChunkedRange(resolution.product(), 1024),
+            [&](int thread) -> ThreadState & { return states[thread]; },
+            [&](ThreadState &state, Range paths) {
+                for (int path : paths) {
+                    const Point2i index(path % resolution.x(), path / resolution.x());
+                    for (int sample = 0; sample < sampleCount; sample++) {
+                        state.sampler->seed(index, sample);
+                        tracePath(state, sceneBounds);
+                    }
+                }
+                progress += paths.count();
+            });
+        progress.finish();
+
+        // each tile of the image is merged by one thread, which sums up the contributions of all threads
+        const float norm = 1.0f / sampleCount;
+        for_each_parallel(Range(0, states.front().film.tileCount()), [&](int tile) {
+            for (const ThreadState &state : states) {
+                state.film.addTo(*m_image, tile, norm);
+            }
+        });
+
+        renderAovs(0, sampleCount);
+        saveImages();
+    }
+
+    Color Li(const Ray &ray, Sampler &rng) override {
+        // all contributions are splatted by light paths, camera rays do not add anything on their own
+        return Color(0);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "LightTracer[\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "  depth = %d,\n"
+            "]",
+            indent(m_sampler),
+            indent(m_image),
+            m_depth
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(LightTracer, "lighttracer")
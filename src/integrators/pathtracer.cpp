@@ -1,11 +1,67 @@
 
 #include <lightwave.hpp>
 
+#include "radiancecache.hpp"
+#include "sdtree.hpp"
+
 namespace lightwave
 {
 
     class Pathtracer : public SamplingIntegrator
     {
+        enum class RouletteMode
+        {
+            /// @brief Paths are only terminated when the maximum depth is reached.
+            None,
+            /// @brief Paths survive with a probability proportional to their throughput.
+            Throughput,
+            /// @brief Paths survive with a probability proportional to their expected contribution to the pixel,
+            /// which is estimated from the radiance that previous paths gathered at each depth.
+            Efficiency,
+        };
+
+        /// @brief The number of sampler dimensions reserved for the camera (pixel and lens position).
+        static constexpr int CameraDimensions = Camera::MaxSampleDimensions;
+        /// @brief The number of sampler dimensions reserved for each bounce (light selection and sampling, Bsdf
+        /// sampling and roulette).
+        static constexpr int DimensionsPerBounce = 8;
+
+        /// @brief The number of depths for which the efficiency-optimized roulette gathers statistics.
+        static constexpr int MaxRouletteDepth = 32;
+        /// @brief The number of paths a thread needs to have traced before relying on its statistics.
+        static constexpr int64_t RouletteWarmup = 256;
+
+        /// @brief Per-thread estimates of the radiance that paths gather from each depth onwards.
+        struct alignas(64) RouletteStatistics
+        {
+            std::array<double, MaxRouletteDepth> radiance{};
+            std::array<int64_t, MaxRouletteDepth> count{};
+
+            /// @brief Returns the average radiance gathered from the given depth onwards (or -1 if unknown).
+            float estimate(int depth) const
+            {
+                depth = std::min(depth, MaxRouletteDepth - 1);
+                if (count[0] < RouletteWarmup || count[depth] == 0)
+                    return -1;
+                return float(radiance[depth] / count[depth]);
+            }
+        };
+
+        /// @brief The radiance a path has gathered and its throughput when it reached a given depth, along with the
+        /// ray that reached the depth and the density with which its direction was sampled (zero for camera rays and
+        /// delta components), as well as the surface that was hit if it can be cached.
+        struct PathVertex
+        {
+            Color color;
+            Color weight;
+            Point origin;
+            Vector direction;
+            float pdf;
+            Point position;
+            Vector normal;
+            bool cacheable;
+        };
+
         /// @brief Whether to show the grid, or only output the ray's direction as color.
         bool m_showGrid;
         /// @brief The color of the grid, if the grid is shown.
@@ -15,6 +71,44 @@ namespace lightwave
 
         int depth;
 
+        RouletteMode m_rouletteMode;
+        /// @brief The depth from which on Russian roulette is applied.
+        int m_rouletteDepth;
+        /// @brief The minimum survival probability of the efficiency-optimized roulette.
+        float m_rouletteMinProbability;
+        /// @brief Statistics for the efficiency-optimized roulette, one entry per worker thread.
+        std::vector<RouletteStatistics> m_rouletteStatistics;
+
+        /// @brief Whether directions are sampled from a learned distribution of incident radiance (path guiding).
+        bool m_guiding;
+        /// @brief The fraction of the samples per pixel spent on learning the incident radiance.
+        float m_guidingTraining;
+        /// @brief The probability of sampling the Bsdf instead of the learned distribution.
+        float m_guidingBsdfFraction;
+        /// @brief The number of samples (per pass with one sample per pixel) after which a spatial cell is split.
+        float m_guidingSpatialThreshold;
+        /// @brief The fraction of energy above which a directional cell is split.
+        float m_guidingDirectionalThreshold;
+        /// @brief The learned distribution of incident radiance (if guiding is enabled).
+        std::unique_ptr<SDTree> m_guidingTree;
+        /// @brief Whether paths are currently recorded into @ref m_guidingTree .
+        bool m_guidingTrainingPass = false;
+
+        /// @brief Whether paths record the radiance leaving the surfaces they hit into a radiance cache.
+        bool m_cache;
+        /// @brief The depth from which on paths are terminated into the radiance cache.
+        int m_cacheDepth;
+        /// @brief The number of estimates a cache cell needs before paths are terminated into it.
+        int m_cacheMinSamples;
+        /// @brief The edge length of the cache cells (or zero to derive it from the size of the scene).
+        float m_cacheCellSize;
+        /// @brief The maximum number of cache cells.
+        int m_cacheCapacity;
+        /// @brief The roughness a surface needs for its reflected radiance to be cached (see @ref Bsdf::roughness ).
+        float m_cacheRoughness;
+        /// @brief The radiance cache (if enabled).
+        std::unique_ptr<RadianceCache> m_radianceCache;
+
     public:
         Pathtracer(const Properties &properties)
             : SamplingIntegrator(properties)
@@ -26,43 +120,294 @@ namespace lightwave
             m_gridColor = properties.get<Color>("gridColor", Color::black());
             m_gridFrequency = properties.get<float>("gridFrequency", 10);
             depth = properties.get<int>("depth", 2);
+
+            m_rouletteMode = properties.getEnum<RouletteMode>("rr", RouletteMode::None,
+                                                              {
+                                                                  {"none", RouletteMode::None},
+                                                                  {"throughput", RouletteMode::Throughput},
+                                                                  {"efficiency", RouletteMode::Efficiency},
+                                                              });
+            m_rouletteDepth = properties.get<int>("rrDepth", 3);
+            m_rouletteMinProbability = properties.get<float>("rrMinProbability", 0.05f);
+            if (m_rouletteMode == RouletteMode::Efficiency)
+            {
+                m_rouletteStatistics.resize(numWorkerThreads());
+            }
+
+            m_guiding = properties.get<bool>("guiding", false);
+            m_guidingTraining = properties.get<float>("guidingTraining", 0.25f);
+            m_guidingBsdfFraction = properties.get<float>("guidingBsdfFraction", 0.5f);
+            m_guidingSpatialThreshold = properties.get<float>("guidingSpatialThreshold", 12000);
+            m_guidingDirectionalThreshold = properties.get<float>("guidingDirectionalThreshold", 0.01f);
+
+            m_cache = properties.get<bool>("cache", false);
+            m_cacheDepth = properties.get<int>("cacheDepth", 2);
+            m_cacheMinSamples = properties.get<int>("cacheMinSamples", 32);
+            m_cacheCellSize = properties.get<float>("cacheCellSize", 0);
+            m_cacheCapacity = properties.get<int>("cacheCapacity", 1 << 20);
+            m_cacheRoughness = properties.get<float>("cacheRoughness", 0.6f);
+        }
+
+        void execute() override
+        {
+            if (m_cache)
+            {
+                const Bounds bounds = m_scene->getBoundingBox();
+                const Vector extent = bounds.diagonal();
+                const float cellSize = m_cacheCellSize > 0 ? m_cacheCellSize : std::max({extent.x(), extent.y(), extent.z()}) / 32;
+                m_radianceCache = std::make_unique<RadianceCache>(bounds, cellSize, m_cacheMinSamples, m_cacheCapacity);
+            }
+
+            if (!m_guiding)
+            {
+                SamplingIntegrator::execute();
+            }
+            else
+            {
+                executeGuided();
+            }
+
+            if (m_radianceCache)
+            {
+                logger(EInfo, "radiance cache: %d cells", m_radianceCache->cellCount());
+                m_radianceCache.reset();
+            }
+        }
+
+        void executeGuided()
+        {
+
+            // the incident radiance is learned in passes of doubling sample counts, each of which starts from the
+            // distribution learned by the previous passes, and the remaining samples render the image
+            initializeImages();
+            m_guidingTree = std::make_unique<SDTree>(m_scene->getBoundingBox());
+            const int sampleCount = m_sampler->samplesPerPixel();
+            const int trainingSamples = int(m_guidingTraining * sampleCount);
+            int firstSample = 0;
+            m_guidingTrainingPass = true;
+            for (int passSamples = 1; firstSample + passSamples <= trainingSamples && firstSample + passSamples < sampleCount; passSamples *= 2)
+            {
+                renderSamples(firstSample, passSamples);
+                firstSample += passSamples;
+                m_guidingTree->refine(m_guidingSpatialThreshold * std::sqrt(float(passSamples)), m_guidingDirectionalThreshold, 20);
+                logger(EInfo, "guiding: trained with %d samples per pixel, %d spatial cells", passSamples, m_guidingTree->leafCount());
+            }
+            m_guidingTrainingPass = false;
+            renderSamples(firstSample, sampleCount - firstSample);
+            saveImages();
+        }
+
+        /// @brief Returns the probability with which a path of given throughput continues to the given depth.
+        float survivalProbability(const Color &weight, int nextDepth, const RouletteStatistics *stats) const
+        {
+            const float throughput = std::max({weight.r(), weight.g(), weight.b()});
+            if (m_rouletteMode == RouletteMode::Efficiency && stats)
+            {
+                const float pixelEstimate = stats->estimate(0);
+                const float depthEstimate = stats->estimate(nextDepth);
+                if (pixelEstimate > 0 && depthEstimate >= 0)
+                {
+                    const float expected = weight.luminance() * depthEstimate / pixelEstimate;
+                    return std::clamp(expected, m_rouletteMinProbability, 1.0f);
+                }
+            }
+            return std::min(throughput, 1.0f);
         }
 
         Color Li(const Ray &ray, Sampler &rng) override
+        {
+            return trace(ray, rng, nullptr, nullptr, nullptr);
+        }
+
+        Color Li(const Ray &ray, RenderContext &context) override
+        {
+            const bool recordsRoulette = m_rouletteMode == RouletteMode::Efficiency;
+            if (!recordsRoulette && !m_guidingTrainingPass && !m_radianceCache)
+            {
+                return trace(ray, *context.sampler, nullptr, &context, nullptr);
+            }
+
+            RouletteStatistics *stats = recordsRoulette ? &m_rouletteStatistics[context.threadIndex] : nullptr;
+            const int trackedDepth = std::min(depth, MaxRouletteDepth);
+            PathVertex *vertices = context.arena.allocate<PathVertex>(trackedDepth);
+            int vertexCount = 0;
+
+            const Color color = trace(ray, *context.sampler, stats, &context, [&](const Ray &vertexRay, const Intersection &its, const Color &pathColor, const Color &pathWeight, float pdf)
+                                      {
+                if (vertexRay.depth < trackedDepth) {
+                    const bool cacheable = m_radianceCache && its && isCacheable(its);
+                    vertices[vertexRay.depth] = { pathColor, pathWeight, vertexRay.origin, vertexRay.direction, pdf, its.position, its.frame.normal, cacheable };
+                    vertexCount = vertexRay.depth + 1;
+                } });
+
+            // record the radiance that was gathered from each depth onwards, relative to the throughput at that depth
+            for (int vertexDepth = 0; vertexDepth < vertexCount; vertexDepth++)
+            {
+                const float throughput = vertices[vertexDepth].weight.luminance();
+                if (!(throughput > 0))
+                    break;
+                const float radiance = (color - vertices[vertexDepth].color).luminance() / throughput;
+                if (!std::isfinite(radiance))
+                    break;
+                if (stats)
+                {
+                    stats->radiance[vertexDepth] += radiance;
+                    stats->count[vertexDepth]++;
+                }
+                if (m_guidingTrainingPass && vertices[vertexDepth].pdf > 0)
+                {
+                    m_guidingTree->lookup(vertices[vertexDepth].origin).building.record(vertices[vertexDepth].direction, radiance / vertices[vertexDepth].pdf);
+                }
+                // lookups only happen from the cache depth on, and radiance gathered at shallower vertices includes
+                // more bounces than paths that are terminated into the cache are allowed to add
+                if (vertices[vertexDepth].cacheable && vertexDepth >= m_cacheDepth)
+                {
+                    const Color &throughputs = vertices[vertexDepth].weight;
+                    if (throughputs.r() > 0 && throughputs.g() > 0 && throughputs.b() > 0)
+                    {
+                        m_radianceCache->record(vertices[vertexDepth].position, vertices[vertexDepth].normal, (color - vertices[vertexDepth].color) / throughputs);
+                    }
+                }
+            }
+            return color;
+        }
+
+        /// @brief Returns whether the radiance leaving a surface can be cached, which is not the case for surfaces
+        /// without a Bsdf (i.e., lights) and for specular or glossy ones (whose radiance depends on the direction).
+        bool isCacheable(const Intersection &its) const
+        {
+            return its.instance->bsdf() && its.evaluateRoughness() >= m_cacheRoughness;
+        }
+
+        /**
+         * @brief Samples the direction in which a path continues, either from the Bsdf or (if guiding is enabled) from
+         * the learned incident radiance, which are combined by one-sample multiple importance sampling.
+         * @param pdf Receives the density with which the direction was sampled (or zero for delta components).
+         */
+        BsdfSample sampleDirection(const Intersection &its, Sampler &rng, float &pdf) const
+        {
+            BsdfSample b = its.sampleBsdf(rng);
+            pdf = b.isInvalid() ? 0 : its.pdfBsdf(b.wi);
+            // Bsdfs consisting of delta components can not be guided
+            if (!m_guidingTree || !(pdf > 0))
+                return b;
+
+            const DirectionalTree &guide = m_guidingTree->lookup(its.position).sampling;
+            if (!(guide.sum() > 0))
+                return b;
+
+            float bsdfPdf = pdf;
+            if (!(rng.next() < m_guidingBsdfFraction))
+            {
+                b.wi = guide.sample(rng.next2D());
+                bsdfPdf = its.pdfBsdf(b.wi);
+            }
+            pdf = m_guidingBsdfFraction * bsdfPdf + (1 - m_guidingBsdfFraction) * guide.pdf(b.wi);
+            if (!(pdf > 0))
+                return BsdfSample::invalid();
+            b.weight = its.evaluateBsdf(b.wi).value / pdf;
+            return b;
+        }
+
+        /// @brief Returns the density with which @ref sampleDirection samples a given direction (for non-delta Bsdfs).
+        float directionPdf(const Intersection &its, const Vector &wi) const
+        {
+            const float bsdfPdf = its.pdfBsdf(wi);
+            if (!m_guidingTree)
+                return bsdfPdf;
+            const DirectionalTree &guide = m_guidingTree->lookup(its.position).sampling;
+            if (!(guide.sum() > 0))
+                return bsdfPdf;
+            return m_guidingBsdfFraction * bsdfPdf + (1 - m_guidingBsdfFraction) * guide.pdf(wi);
+        }
+
+        /**
+         * @brief Traces a path starting with the given ray.
+         * @param stats Statistics for the efficiency-optimized roulette (if available).
+         * @param context The state of the calling thread, which receives the first intersection (may be @c nullptr ).
+         * @param recordVertex Invoked for each vertex of the path with the ray reaching it, its intersection, the
+         * radiance gathered so far, the throughput at that vertex and the density of the ray direction (may be
+         * @c nullptr ). Vertices at which the path is terminated into the radiance cache are not reported.
+         */
+        template <typename RecordVertex>
+        Color trace(const Ray &ray, Sampler &rng, const RouletteStatistics *stats, RenderContext *context, RecordVertex &&recordVertex)
         {
             Color color{0.0f};
             Color weight{1.0f};
             Ray curr_ray = ray;
+            // the previous vertex and the density with which it sampled the current ray (zero for delta components),
+            // needed to weight emission that is hit against light sampling
+            Point prev_position;
+            Vector prev_normal;
+            float bsdfPdf = 0;
 
             while (true)
             {
+                rng.skipToDimension(CameraDimensions + curr_ray.depth * DimensionsPerBounce);
                 Intersection its = m_scene->intersect(curr_ray, rng);
+                if (context && curr_ray.depth == 0)
+                {
+                    context->recordPrimaryHit(its);
+                }
+
+                if (its && m_radianceCache && curr_ray.depth >= m_cacheDepth && isCacheable(its))
+                {
+                    // the cached radiance includes the emission of the surface and all light reflected from it
+                    Color cached;
+                    if (m_radianceCache->lookup(its.position, its.frame.normal, cached))
+                    {
+                        color += cached * weight;
+                        break;
+                    }
+                }
+
+                if constexpr (!std::is_null_pointer_v<std::decay_t<RecordVertex>>)
+                {
+                    recordVertex(curr_ray, its, color, weight, bsdfPdf);
+                }
                 if (!its)
                 {
-                    color += m_scene->evaluateBackground(curr_ray.direction).value * weight;
+                    float misWeight = 1;
+                    if (bsdfPdf > 0 && m_scene->hasBackground() && m_scene->hasLights())
+                    {
+                        const float lightPdf = m_scene->lightSelectionProbability(m_scene->background(), prev_position, prev_normal) *
+                                               m_scene->background()->pdf(curr_ray.direction);
+                        misWeight = balanceHeuristic(bsdfPdf, lightPdf);
+                    }
+                    color += m_scene->evaluateBackground(curr_ray.direction).value * weight * misWeight;
                     break;
                 }
                 else
                 {
-                    color += its.evaluateEmission() * weight;
+                    float misWeight = 1;
+                    const Light *light = its.instance->light();
+                    if (bsdfPdf > 0 && light && m_scene->hasLights())
+                    {
+                        const float lightPdf = m_scene->lightSelectionProbability(light, prev_position, prev_normal) *
+                                               light->pdf(prev_position, its);
+                        misWeight = balanceHeuristic(bsdfPdf, lightPdf);
+                    }
+                    color += its.evaluateEmission() * weight * misWeight;
                     if (curr_ray.depth >= depth - 1)
                     {
                         return color;
                     }
                     if (m_scene->hasLights())
                     {
-                        LightSample ls = m_scene->sampleLight(rng);
-                        if (!ls.light->canBeIntersected())
+                        LightSample ls = m_scene->sampleLight(its.position, its.frame.normal, rng);
+                        if (!ls.isInvalid())
                         {
                             DirectLightSample dls = ls.light->sampleDirect(its.position, rng);
 
                             Vector toLight = dls.wi; // Directional light's direction
-                            bool isIntersecting = m_scene->intersect(Ray(its.position, toLight), dls.distance, rng);
+                            bool isIntersecting = dls.isInvalid() || m_scene->intersect(Ray(its.position, toLight), dls.distance, rng);
 
                             if (!isIntersecting)
                             { // Check if light direction is visible
                                 Color bsdfVal = its.evaluateBsdf(toLight).value;
-                                color += (bsdfVal * dls.weight * weight / ls.probability);
+                                // lights that can be intersected can also be found by Bsdf sampling, hence both techniques are weighted
+                                const float misWeight = ls.light->canBeIntersected() ? balanceHeuristic(ls.probability * dls.pdf, directionPdf(its, toLight)) : 1;
+                                color += (bsdfVal * dls.weight * weight / ls.probability * misWeight);
                             }
                         }
                     }
@@ -70,12 +415,27 @@ namespace lightwave
                     // {
                     //     break; // Exit the loop when you reach the desired depth
                     // }
-                    BsdfSample b = its.sampleBsdf(rng);
+                    float samplePdf;
+                    BsdfSample b = sampleDirection(its, rng, samplePdf);
                     if (b.isInvalid())
                     {
                         break;
                     }
                     weight *= b.weight;
+
+                    if (m_rouletteMode != RouletteMode::None && curr_ray.depth + 1 >= m_rouletteDepth)
+                    {
+                        const float survival = survivalProbability(weight, curr_ray.depth + 1, stats);
+                        if (!(rng.next() < survival))
+                        {
+                            break;
+                        }
+                        weight /= survival;
+                    }
+
+                    bsdfPdf = samplePdf;
+                    prev_position = its.position;
+                    prev_normal = its.frame.normal;
                     curr_ray.origin = its.position;
                     curr_ray.direction = b.wi;
                     curr_ray.depth += 1;
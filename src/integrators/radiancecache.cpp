@@ -0,0 +1,99 @@
+#include "radiancecache.hpp"
+
+#include <lightwave/parallel.hpp>
+
+#include <algorithm>
+#include <bit>
+
+namespace lightwave {
+
+namespace {
+
+/// @brief The number of bits of each grid coordinate in a key (coordinates beyond are clamped).
+constexpr int CoordinateBits = 19;
+/// @brief The number of entries that are probed before a cell is considered to not fit into the table.
+constexpr int MaxProbes = 8;
+
+/// @brief Quantizes one component of a normal into four bins.
+uint64_t quantizeNormal(float component) {
+    return uint64_t(std::clamp(int((component + 1) * 2), 0, 3));
+}
+
+/// @brief The finalizer of MurmurHash3, which spreads the bits of the key over the table.
+uint64_t mix(uint64_t key) {
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdull;
+    key ^= key >> 33;
+    key *= 0xc4ceb9fe1a85ec53ull;
+    key ^= key >> 33;
+    return key;
+}
+
+float load(float &value) {
+    return std::atomic_ref<float>(value).load(std::memory_order_relaxed);
+}
+
+}
+
+RadianceCache::RadianceCache(const Bounds &sceneBounds, float cellSize, int minSamples, int capacity)
+: m_origin(sceneBounds.min()), m_invCellSize(1 / cellSize), m_minSamples(uint32_t(std::max(minSamples, 1))) {
+    const uint64_t size = std::bit_ceil(uint64_t(std::max(capacity, 1)));
+    m_entries = std::make_unique<Entry[]>(size);
+    m_mask = size - 1;
+}
+
+uint64_t RadianceCache::key(const Point &position, const Vector &normal) const {
+    constexpr int64_t MaxCoordinate = (int64_t(1) << CoordinateBits) - 1;
+    uint64_t result = 0;
+    for (int dim = 0; dim < 3; dim++) {
+        const float cell = std::floor((position[dim] - m_origin[dim]) * m_invCellSize);
+        const int64_t coordinate = int64_t(std::clamp(cell, 0.f, float(MaxCoordinate)));
+        result |= uint64_t(coordinate) << (dim * CoordinateBits);
+        result |= quantizeNormal(normal[dim]) << (3 * CoordinateBits + 2 * dim);
+    }
+    // zero marks unused entries
+    return result + 1;
+}
+
+RadianceCache::Entry *RadianceCache::find(uint64_t key, bool insert) {
+    const uint64_t hash = mix(key);
+    for (int probe = 0; probe < MaxProbes; probe++) {
+        Entry &entry = m_entries[(hash + probe) & m_mask];
+        uint64_t current = entry.key.load(std::memory_order_relaxed);
+        if (current == key)
+            return &entry;
+        if (current != 0)
+            continue;
+        if (!insert)
+            return nullptr;
+        if (entry.key.compare_exchange_strong(current, key, std::memory_order_relaxed)) {
+            m_used.fetch_add(1, std::memory_order_relaxed);
+            return &entry;
+        }
+        // another thread has claimed the entry in the meantime, possibly for the same cell
+        if (current == key)
+            return &entry;
+    }
+    return nullptr;
+}
+
+void RadianceCache::record(const Point &position, const Vector &normal, const Color &radiance) {
+    Entry *entry = find(key(position, normal), true);
+    if (!entry)
+        return;
+    atomicAdd(entry->radiance, radiance);
+    entry->count.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool RadianceCache::lookup(const Point &position, const Vector &normal, Color &radiance) const {
+    Entry *entry = const_cast<RadianceCache *>(this)->find(key(position, normal), false);
+    if (!entry)
+        return false;
+    const uint32_t count = entry->count.load(std::memory_order_relaxed);
+    if (count < m_minSamples)
+        return false;
+    radiance = Color(load(entry->radiance.r()), load(entry->radiance.g()), load(entry->radiance.b())) / float(count);
+    return true;
+}
+
+}
@@ -0,0 +1,62 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/color.hpp>
+#include <lightwave/math.hpp>
+
+#include <atomic>
+#include <memory>
+
+namespace lightwave {
+
+/**
+ * @brief A cache of the radiance leaving surfaces, stored in a hash table over a uniform grid whose cells are keyed
+ * by their (quantized) position and normal.
+ * Paths record their radiance estimates into the cache with atomic operations, so that all threads can fill the same
+ * cache without locking. Once a cell has received enough estimates, paths reaching it can be terminated by using the
+ * cached radiance instead of tracing the remainder of the path, which introduces bias in exchange for shorter paths.
+ * Collisions are resolved by linear probing; estimates for cells that do not fit into the table are dropped.
+ */
+class RadianceCache {
+    struct Entry {
+        /// @brief The key of the cell stored in this entry (or zero if the entry is unused).
+        std::atomic<uint64_t> key { 0 };
+        /// @brief The sum of all radiance estimates recorded for the cell.
+        Color radiance { 0.0f };
+        /// @brief The number of radiance estimates recorded for the cell.
+        std::atomic<uint32_t> count { 0 };
+    };
+
+    Point m_origin;
+    float m_invCellSize;
+    /// @brief The number of estimates a cell needs before its radiance is used.
+    uint32_t m_minSamples;
+
+    std::unique_ptr<Entry[]> m_entries;
+    uint64_t m_mask;
+    /// @brief The number of entries that are in use.
+    std::atomic<int> m_used { 0 };
+
+    uint64_t key(const Point &position, const Vector &normal) const;
+    /// @brief Finds the entry of a cell, optionally claiming an unused entry if the cell is not present yet.
+    Entry *find(uint64_t key, bool insert);
+
+public:
+    /**
+     * @param sceneBounds The bounds of all geometry that is cached.
+     * @param cellSize The edge length of the cells of the grid.
+     * @param minSamples The number of estimates a cell needs before its radiance is used by @ref lookup .
+     * @param capacity The number of cells the table can hold, which is rounded up to a power of two.
+     */
+    RadianceCache(const Bounds &sceneBounds, float cellSize, int minSamples, int capacity);
+
+    /// @brief Records an estimate of the radiance leaving a surface point, which can be called concurrently.
+    void record(const Point &position, const Vector &normal, const Color &radiance);
+    /// @brief Returns whether the cell of a surface point is reliable, in which case its average radiance is stored.
+    bool lookup(const Point &position, const Vector &normal, Color &radiance) const;
+
+    /// @brief The number of cells that have received estimates.
+    int cellCount() const { return m_used.load(std::memory_order_relaxed); }
+};
+
+}
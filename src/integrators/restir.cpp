@@ -0,0 +1,345 @@
+#include <lightwave.hpp>
+
+#include <array>
+#include <span>
+
+namespace lightwave {
+
+namespace {
+
+/// @brief The number of random numbers a light source may consume in @ref Light::sampleDirect for its samples to be
+/// reused (light sources that need more are only used for pixels that sampled them directly).
+constexpr int MaxLightDimensions = 8;
+/// @brief The random numbers drawn per candidate: one selects the light source, the following @ref MaxLightDimensions
+/// sample it, and the last one decides whether the reservoir keeps the candidate.
+constexpr int CandidateDimensions = MaxLightDimensions + 2;
+/// @brief The number of candidates whose random numbers are drawn at once via @ref Sampler::nextN .
+constexpr int CandidateBatchSize = 8;
+/// @brief The dimension from which on the spatial reuse of a pass draws its random numbers, which lies far beyond
+/// those consumed by the first part of the pass (camera, candidates and temporal reuse).
+constexpr int SpatialReuseDimension = 1 << 30;
+
+/**
+ * @brief A light sample in primary sample space, i.e., the light source along with the random numbers that were used
+ * to sample it.
+ * Since light sources map random numbers to points (or directions) independently of the shading point, the same
+ * sample can be re-evaluated at any other shading point by replaying its random numbers.
+ */
+struct LightCandidate {
+    const Light *light = nullptr;
+    std::array<float, MaxLightDimensions> rnd {};
+};
+
+/// @brief Hands out a fixed sequence of random numbers (e.g., those that have been recorded for a candidate).
+class ReplaySampler : public Sampler {
+    std::span<const float> m_values;
+    int m_count = 0;
+
+public:
+    ReplaySampler(std::span<const float> values)
+    : m_values(values) {}
+
+    /// @brief Whether more random numbers have been consumed than the sequence holds.
+    bool overflowed() const { return m_count > int(m_values.size()); }
+
+    float next() override {
+        return m_values[std::min(m_count++, int(m_values.size()) - 1)];
+    }
+
+    void seed(int index) override {}
+    void seed(const Point2i &pixel, int sampleIndex) override {}
+    ref<Sampler> clone() const override { lightwave_throw("replay samplers cannot be cloned"); }
+    std::string toString() const override { return "ReplaySampler[]"; }
+};
+
+/// @brief A weighted reservoir that keeps one of a stream of candidates, picked proportional to their weights.
+struct Reservoir {
+    /// @brief The candidate that has been kept.
+    LightCandidate sample;
+    /// @brief The target function of the kept candidate at the shading point of the reservoir.
+    float target = 0;
+    /// @brief The sum of the resampling weights of all candidates seen so far.
+    float weightSum = 0;
+    /// @brief The number of candidates the reservoir represents.
+    int count = 0;
+    /// @brief The unbiased contribution weight of the kept candidate (i.e., an estimate of its inverse density).
+    float contributionWeight = 0;
+
+    /// @brief Considers a candidate, returning whether it has been kept.
+    bool update(const LightCandidate &candidate, float weight, float candidateTarget, int candidateCount, float rnd) {
+        weightSum += weight;
+        count += candidateCount;
+        if (!(weight > 0) || rnd * weightSum >= weight)
+            return false;
+        sample = candidate;
+        target = candidateTarget;
+        return true;
+    }
+
+    /// @brief Merges another reservoir, whose candidate has the given target function at this reservoir's shading point.
+    void merge(const Reservoir &other, float otherTarget, int otherCount, float rnd) {
+        update(other.sample, otherTarget * other.contributionWeight * float(otherCount), otherTarget, otherCount, rnd);
+    }
+
+    /// @brief Computes the contribution weight once all candidates have been considered.
+    void finalize() {
+        finalize(count);
+    }
+
+    /// @brief Computes the contribution weight, normalizing by the number of candidates that could have produced the
+    /// kept one (instead of all candidates).
+    void finalize(int supportCount) {
+        contributionWeight = target > 0 && supportCount > 0 ? weightSum / (float(supportCount) * target) : 0;
+    }
+};
+
+/// @brief The surface seen through a pixel in the current pass.
+struct PixelSurface {
+    Intersection its;
+    /// @brief The weight of the camera sample.
+    Color weight;
+};
+
+}
+
+/**
+ * @brief Computes direct illumination by resampled importance sampling with weighted reservoirs (also known as
+ * ReSTIR), which finds the few light sources that matter out of thousands with only one shadow ray per pixel.
+ * Each sample per pixel is rendered as a pass over the whole image: every pixel first draws a number of candidates
+ * using @ref Scene::sampleLight and @ref Light::sampleDirect , keeping one of them proportional to its unshadowed
+ * contribution. The reservoir is then combined with the one kept by the same pixel in the previous pass (temporal reuse)
+ * and with those of random nearby pixels that see similar surfaces (spatial reuse), so that good light samples spread
+ * across the image and across passes. Only the result of the temporal reuse is carried over to the next pass, since the
+ * (slight) bias of the spatial reuse would otherwise accumulate across passes.
+ * @note Reused samples are normalized by the number of candidates that could have produced them, which ignores
+ * visibility and is hence slightly biased where neighboring pixels are shadowed differently. Emissive surfaces that are
+ * not light sources (and the background, if it is not a light source) only contribute where they are seen directly.
+ */
+class ReSTIR : public SamplingIntegrator {
+    /// @brief The number of candidates each pixel draws per pass.
+    int m_candidates;
+    /// @brief Whether reservoirs are combined with those of the previous pass.
+    bool m_temporal;
+    /// @brief The number of candidates the previous pass may contribute, relative to those of the current pass.
+    int m_temporalHistory;
+    /// @brief The number of neighboring pixels whose reservoirs are combined (zero to disable spatial reuse).
+    int m_spatialNeighbors;
+    /// @brief The radius (in pixels) in which neighboring pixels are chosen.
+    float m_spatialRadius;
+
+    /// @brief Evaluates the unshadowed contribution of a candidate at a surface point.
+    Color evaluate(const Intersection &its, const LightCandidate &candidate, DirectLightSample &dls) const {
+        if (!candidate.light)
+            return Color(0);
+        ReplaySampler replay { candidate.rnd };
+        dls = candidate.light->sampleDirect(its.position, replay);
+        if (dls.isInvalid())
+            return Color(0);
+        return its.evaluateBsdf(dls.wi).value * dls.weight;
+    }
+
+    /// @brief The function that candidates are resampled by, which is their (unshadowed) luminance.
+    float target(const Intersection &its, const LightCandidate &candidate) const {
+        DirectLightSample dls;
+        return std::max(evaluate(its, candidate, dls).luminance(), 0.f);
+    }
+
+    bool isVisible(const Intersection &its, const DirectLightSample &dls, Sampler &rng) const {
+        return !m_scene->intersect(Ray(its.position, dls.wi), dls.distance, rng);
+    }
+
+    /// @brief Whether the reservoir of one pixel is likely to be useful for another, judging by their surfaces.
+    static bool isSimilar(const Intersection &a, const Intersection &b) {
+        return b && a.frame.normal.dot(b.frame.normal) > 0.9f && std::abs(a.t - b.t) < 0.1f * a.t;
+    }
+
+    /// @brief Draws the candidates of a pixel and combines them with the reservoir of the previous pass.
+    Reservoir sampleInitial(const Intersection &its, const Reservoir &previous, Sampler &rng) const {
+        Reservoir reservoir;
+        std::array<float, CandidateBatchSize * CandidateDimensions> batch;
+        const int candidates = m_scene->hasLights() ? m_candidates : 0;
+        for (int i = 0; i < candidates; i++) {
+            // the random numbers of several candidates are drawn at once, which samplers can vectorize
+            const int slot = i % CandidateBatchSize;
+            if (slot == 0) {
+                const int count = std::min(CandidateBatchSize, candidates - i);
+                rng.nextN(std::span(batch).first(count * CandidateDimensions));
+            }
+            const float *rnd = &batch[slot * CandidateDimensions];
+
+            ReplaySampler selection { std::span(rnd, 1) };
+            const LightSample ls = m_scene->sampleLight(selection);
+            if (ls.isInvalid()) {
+                reservoir.count++;
+                continue;
+            }
+
+            LightCandidate candidate { .light = ls.light, .rnd = {} };
+            std::copy_n(rnd + 1, MaxLightDimensions, candidate.rnd.begin());
+            ReplaySampler replay { candidate.rnd };
+            const DirectLightSample dls = ls.light->sampleDirect(its.position, replay);
+            const float candidateTarget = dls.isInvalid() || replay.overflowed() ? 0 :
+                std::max((its.evaluateBsdf(dls.wi).value * dls.weight).luminance(), 0.f);
+            // the weight is the target divided by the density, where the density of the light sample itself cancels
+            // out since the target is already divided by it
+            reservoir.update(candidate, candidateTarget / ls.probability, candidateTarget, 1,
+                             rnd[CandidateDimensions - 1]);
+        }
+        reservoir.finalize();
+
+        if (!m_temporal || previous.count == 0)
+            return reservoir;
+
+        Reservoir combined;
+        combined.merge(reservoir, reservoir.target, reservoir.count, rng.next());
+        const int history = std::min(previous.count, m_temporalHistory * std::max(reservoir.count, 1));
+        combined.merge(previous, target(its, previous.sample), history, rng.next());
+        combined.finalize();
+        return combined;
+    }
+
+public:
+    ReSTIR(const Properties &properties)
+    : SamplingIntegrator(properties) {
+        m_candidates = properties.get<int>("candidates", 32);
+        m_temporal = properties.get<bool>("temporal", true);
+        m_temporalHistory = properties.get<int>("temporalHistory", 20);
+        m_spatialNeighbors = properties.get<int>("spatialNeighbors", 3);
+        m_spatialRadius = properties.get<float>("spatialRadius", 16);
+    }
+
+    void execute() override {
+        initializeImages();
+        if (!m_scene->hasLights()) {
+            logger(EWarn, "the scene has no light sources that can be sampled, only emission will be visible");
+        }
+
+        const Vector2i resolution = m_scene->camera()->resolution();
+        const int pixelCount = resolution.product();
+        const int sampleCount = m_sampler->samplesPerPixel();
+
+        std::vector<PixelSurface> surfaces(pixelCount);
+        // the reservoirs of the current pass (after temporal reuse), and those of the previous pass
+        std::vector<Reservoir> current(pixelCount), previous(pixelCount);
+        std::vector<Color> sums(pixelCount);
+
+        std::vector<ref<Sampler>> samplers(numWorkerThreads());
+        for (auto &sampler : samplers) {
+            sampler = m_sampler->clone();
+        }
+        const auto threadSampler = [&](int thread) -> Sampler & { return *samplers[thread]; };
+        const auto pixelOf = [&](int index) { return Point2i(index % resolution.x(), index / resolution.x()); };
+
+        Streaming stream { *m_image };
+        // progress is reported per pass, as the number of pixel samples can exceed the range of int
+        ProgressReporter progress { sampleCount };
+        for (int pass = 0; pass < sampleCount; pass++) {
+            for_each_parallel(ChunkedRange(pixelCount, 1024), threadSampler, [&](Sampler &rng, Range pixels) {
+                for (int index : pixels) {
+                    rng.seed(pixelOf(index), pass);
+                    const CameraSample cameraSample = m_scene->camera()->sample(pixelOf(index), rng);
+                    PixelSurface &surface = surfaces[index];
+                    surface.weight = cameraSample.weight;
+                    surface.its = m_scene->intersect(cameraSample.ray, rng);
+                    if (!surface.its) {
+                        sums[index] += surface.weight * m_scene->evaluateBackground(cameraSample.ray.direction).value;
+                        current[index] = Reservoir {};
+                        continue;
+                    }
+
+                    sums[index] += surface.weight * surface.its.evaluateEmission();
+                    current[index] = sampleInitial(surface.its, previous[index], rng);
+                }
+            });
+
+            for_each_parallel(ChunkedRange(pixelCount, 1024), threadSampler, [&](Sampler &rng, Range pixels) {
+                std::vector<int> neighbors;
+                for (int index : pixels) {
+                    const Intersection &its = surfaces[index].its;
+                    if (!its) {
+                        previous[index] = Reservoir {};
+                        continue;
+                    }
+
+                    // the sample continues with dimensions that the first part of the pass has not consumed
+                    rng.seed(pixelOf(index), pass);
+                    rng.skipToDimension(SpatialReuseDimension);
+                    Reservoir reservoir = current[index];
+                    if (m_spatialNeighbors > 0) {
+                        reservoir = Reservoir {};
+                        reservoir.merge(current[index], current[index].target, current[index].count, rng.next());
+                        neighbors.clear();
+                        for (int i = 0; i < m_spatialNeighbors; i++) {
+                            const Point2 offset = squareToUniformDiskConcentric(rng.next2D());
+                            const Point2i neighbor(
+                                std::clamp(pixelOf(index).x() + int(std::round(m_spatialRadius * offset.x())), 0, resolution.x() - 1),
+                                std::clamp(pixelOf(index).y() + int(std::round(m_spatialRadius * offset.y())), 0, resolution.y() - 1));
+                            const int neighborIndex = neighbor.y() * resolution.x() + neighbor.x();
+                            if (neighborIndex == index || !isSimilar(its, surfaces[neighborIndex].its))
+                                continue;
+                            const Reservoir &other = current[neighborIndex];
+                            reservoir.merge(other, target(its, other.sample), other.count, rng.next());
+                            neighbors.push_back(neighborIndex);
+                        }
+
+                        // neighbors for which the kept sample lies outside the domain (e.g., below the horizon) could
+                        // not have produced it, and counting their candidates would darken the image
+                        int supportCount = current[index].count;
+                        for (int neighborIndex : neighbors) {
+                            if (target(surfaces[neighborIndex].its, reservoir.sample) > 0)
+                                supportCount += current[neighborIndex].count;
+                        }
+                        reservoir.finalize(supportCount);
+                    }
+
+                    DirectLightSample dls;
+                    const Color contribution = evaluate(its, reservoir.sample, dls);
+                    if (reservoir.contributionWeight > 0 && isVisible(its, dls, rng)) {
+                        sums[index] += surfaces[index].weight * contribution * reservoir.contributionWeight;
+                    }
+                    previous[index] = current[index];
+                }
+            });
+
+            const float norm = 1.0f / (pass + 1);
+            for_each_parallel(Range(0, pixelCount), [&](int index) {
+                m_image->get(pixelOf(index)) = norm * sums[index];
+            });
+            stream.update();
+            progress += 1;
+        }
+        progress.finish();
+
+        renderAovs(0, sampleCount);
+        saveImages();
+    }
+
+    Color Li(const Ray &ray, Sampler &rng) override {
+        // reservoirs are shared across pixels, hence all pixels are computed by execute and camera rays do not add
+        // anything on their own
+        return Color(0);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "ReSTIR[\n"
+            "  sampler = %s,\n"
+            "  image = %s,\n"
+            "  candidates = %d,\n"
+            "  temporal = %s,\n"
+            "  spatialNeighbors = %d,\n"
+            "  spatialRadius = %f,\n"
+            "]",
+            indent(m_sampler),
+            indent(m_image),
+            m_candidates,
+            m_temporal,
+            m_spatialNeighbors,
+            m_spatialRadius
+        );
+    }
+};
+
+}
+
+REGISTER_INTEGRATOR(ReSTIR, "restir")
@@ -0,0 +1,237 @@
+#include "sdtree.hpp"
+
+#include <lightwave/parallel.hpp>
+
+#include <algorithm>
+
+namespace lightwave {
+
+namespace {
+
+/// @brief The maximum number of nodes of a directional tree, which bounds its memory usage.
+constexpr size_t MaxDirectionalNodes = 1 << 16;
+/// @brief The largest float below one.
+constexpr float OneMinusEpsilon = 0x1.fffffep-1f;
+
+/// @brief Maps a direction to the unit square, such that areas on the sphere are preserved (up to a factor 4 Pi).
+Point2 directionToSquare(const Vector &direction) {
+    const float cosTheta = std::clamp(direction.z(), -1.f, 1.f);
+    float phi = std::atan2(direction.y(), direction.x());
+    if (phi < 0)
+        phi += 2 * Pi;
+    return {
+        std::clamp((cosTheta + 1) / 2, 0.f, 1.f),
+        std::clamp(phi * Inv2Pi, 0.f, 1.f),
+    };
+}
+
+Vector squareToDirection(const Point2 &point) {
+    const float cosTheta = 2 * point.x() - 1;
+    const float sinTheta = safe_sqrt(1 - cosTheta * cosTheta);
+    const float phi = 2 * Pi * point.y();
+    return { sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta };
+}
+
+/// @brief Returns the quadrant (x + 2 y) of the unit square containing a point, and maps the point into the quadrant.
+int descend(Point2 &point) {
+    const int x = point.x() >= 0.5f;
+    const int y = point.y() >= 0.5f;
+    point = Point2(2 * point.x() - x, 2 * point.y() - y);
+    return x + 2 * y;
+}
+
+/// @brief Picks one of two options proportional to their weights, and rescales the random number for reuse.
+int pick(float &rnd, float first, float second) {
+    const float probability = first / (first + second);
+    if (rnd < probability) {
+        rnd = std::min(rnd / probability, OneMinusEpsilon);
+        return 0;
+    }
+    rnd = std::min((rnd - probability) / (1 - probability), OneMinusEpsilon);
+    return 1;
+}
+
+}
+
+DirectionalTree::DirectionalTree()
+: m_nodes(1), m_sum(0), m_weight(0) {}
+
+void DirectionalTree::record(const Vector &direction, float radiance) {
+    Point2 point = directionToSquare(direction);
+    uint32_t node = 0;
+    while (true) {
+        const int quadrant = descend(point);
+        const uint32_t child = m_nodes[node].children[quadrant];
+        if (!child) {
+            atomicAdd(m_nodes[node].sums[quadrant], radiance);
+            break;
+        }
+        node = child;
+    }
+    atomicAdd(m_weight, 1.f);
+}
+
+float DirectionalTree::build(uint32_t node) {
+    float total = 0;
+    for (int quadrant = 0; quadrant < 4; quadrant++) {
+        if (const uint32_t child = m_nodes[node].children[quadrant])
+            m_nodes[node].sums[quadrant] = build(child);
+        total += m_nodes[node].sums[quadrant];
+    }
+    return total;
+}
+
+void DirectionalTree::build() {
+    m_sum = build(0);
+}
+
+void DirectionalTree::refine(const DirectionalTree &source, float threshold, int maxDepth) {
+    struct Entry {
+        /// @brief The node to be created in this tree.
+        uint32_t node;
+        /// @brief The node whose energy determines the subdivision (either in the source tree or, if the source
+        /// tree is subdivided less, a freshly subdivided node in this tree).
+        uint32_t sourceNode;
+        bool fromSource;
+        int depth;
+    };
+
+    m_nodes.assign(1, Node {});
+    m_sum = 0;
+    m_weight = 0;
+
+    const float total = source.m_sum;
+    std::vector<Entry> stack = { { 0, 0, true, 1 } };
+    while (!stack.empty() && m_nodes.size() < MaxDirectionalNodes) {
+        const Entry entry = stack.back();
+        stack.pop_back();
+
+        for (int quadrant = 0; quadrant < 4; quadrant++) {
+            const Node &sourceNode = entry.fromSource ? source.m_nodes[entry.sourceNode] : m_nodes[entry.sourceNode];
+            const float energy = sourceNode.sums[quadrant];
+            const float fraction = total > 0 ? energy / total : std::pow(0.25f, float(entry.depth));
+            if (entry.depth >= maxDepth || fraction <= threshold)
+                continue;
+
+            const uint32_t child = uint32_t(m_nodes.size());
+            if (entry.fromSource && sourceNode.children[quadrant]) {
+                stack.push_back({ child, sourceNode.children[quadrant], true, entry.depth + 1 });
+            } else {
+                // the source is not subdivided this far, hence its energy is assumed to be spread evenly
+                stack.push_back({ child, child, false, entry.depth + 1 });
+            }
+            m_nodes[entry.node].children[quadrant] = child;
+            Node subdivided;
+            subdivided.sums.fill(energy / 4);
+            m_nodes.push_back(subdivided);
+        }
+    }
+
+    for (Node &node : m_nodes) {
+        node.sums.fill(0);
+    }
+}
+
+Vector DirectionalTree::sample(Point2 rnd) const {
+    Point2 origin(0, 0);
+    float size = 1;
+    uint32_t node = 0;
+    while (true) {
+        // pick the column first and the row within the column second, which preserves the stratification of rnd
+        const auto &sums = m_nodes[node].sums;
+        const int x = pick(rnd.x(), sums[0] + sums[2], sums[1] + sums[3]);
+        const int y = pick(rnd.y(), sums[x], sums[x + 2]);
+
+        size /= 2;
+        origin = Point2(origin.x() + x * size, origin.y() + y * size);
+        const uint32_t child = m_nodes[node].children[x + 2 * y];
+        if (!child)
+            return squareToDirection(Point2(origin.x() + rnd.x() * size, origin.y() + rnd.y() * size));
+        node = child;
+    }
+}
+
+float DirectionalTree::pdf(const Vector &direction) const {
+    if (!(m_sum > 0))
+        return 0;
+
+    Point2 point = directionToSquare(direction);
+    float density = Inv4Pi;
+    uint32_t node = 0;
+    while (true) {
+        const auto &sums = m_nodes[node].sums;
+        const float total = sums[0] + sums[1] + sums[2] + sums[3];
+        if (!(total > 0))
+            return 0;
+        const int quadrant = descend(point);
+        density *= 4 * sums[quadrant] / total;
+        const uint32_t child = m_nodes[node].children[quadrant];
+        if (!child)
+            return density;
+        node = child;
+    }
+}
+
+SDTree::SDTree(const Bounds &sceneBounds) {
+    // the bounds are made cubic (and slightly enlarged), so that alternating splits produce well-shaped cells
+    const Vector extent = sceneBounds.diagonal();
+    const float size = 1.01f * std::max({ extent.x(), extent.y(), extent.z(), Epsilon });
+    const Point center = sceneBounds.min() + extent / 2;
+    m_bounds = Bounds(center - Vector(size / 2), center + Vector(size / 2));
+
+    m_nodes.emplace_back();
+}
+
+SDTree::Directions &SDTree::lookup(Point position) {
+    const Vector extent = m_bounds.diagonal();
+    for (int dim = 0; dim < 3; dim++) {
+        position[dim] = std::clamp((position[dim] - m_bounds.min()[dim]) / extent[dim], 0.f, 1.f);
+    }
+
+    uint32_t node = 0;
+    while (m_nodes[node].children[0]) {
+        const int axis = m_nodes[node].axis;
+        const int half = position[axis] >= 0.5f;
+        position[axis] = 2 * position[axis] - half;
+        node = m_nodes[node].children[half];
+    }
+    return m_nodes[node].directions;
+}
+
+void SDTree::refine(float spatialThreshold, float directionalThreshold, int maxDirectionalDepth) {
+    for (Node &node : m_nodes) {
+        if (node.children[0])
+            continue;
+        node.directions.building.build();
+        node.directions.sampling = node.directions.building;
+    }
+
+    // nodes that are appended while splitting are visited by the same loop, hence cells keep being split until each
+    // half received few enough samples
+    for (size_t index = 0; index < m_nodes.size(); index++) {
+        if (m_nodes[index].children[0] || m_nodes[index].directions.building.weight() <= spatialThreshold)
+            continue;
+
+        Node half;
+        half.directions = m_nodes[index].directions;
+        half.axis = (m_nodes[index].axis + 1) % 3;
+        half.directions.building.scaleWeight(0.5f);
+        m_nodes[index].children = { uint32_t(m_nodes.size()), uint32_t(m_nodes.size() + 1) };
+        m_nodes.push_back(half);
+        m_nodes.push_back(half);
+        // interior nodes do not need their distributions anymore
+        m_nodes[index].directions = Directions {};
+    }
+
+    for (Node &node : m_nodes) {
+        if (node.children[0])
+            continue;
+        node.directions.building.refine(node.directions.sampling, directionalThreshold, maxDirectionalDepth);
+    }
+}
+
+int SDTree::leafCount() const {
+    return int(std::count_if(m_nodes.begin(), m_nodes.end(), [](const Node &node) { return !node.children[0]; }));
+}
+
+}
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+
+#include <array>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A quadtree over the (area preserving) cylindrical parametrization of the sphere of directions, which
+ * represents a piecewise constant distribution proportional to the radiance arriving from each direction.
+ * Radiance is recorded into the leaves with atomic additions, so that all threads can record into the same tree
+ * without locking. The sums of interior nodes are only computed by @ref build after recording has finished.
+ */
+class DirectionalTree {
+    struct Node {
+        /// @brief The energy recorded in each quadrant of the node.
+        std::array<float, 4> sums {};
+        /// @brief The node index of each quadrant (or zero if the quadrant is a leaf).
+        std::array<uint32_t, 4> children {};
+    };
+
+    std::vector<Node> m_nodes;
+    /// @brief The total energy in the tree (only valid after @ref build ).
+    float m_sum;
+    /// @brief The number of samples that have been recorded.
+    float m_weight;
+
+    float build(uint32_t node);
+
+public:
+    DirectionalTree();
+
+    /// @brief Records the radiance estimate (divided by its sampling density) for a direction, which can be called
+    /// concurrently from multiple threads.
+    void record(const Vector &direction, float radiance);
+    /// @brief Computes the sums of all interior nodes from the recorded leaves.
+    void build();
+    /**
+     * @brief Replaces this tree by an empty tree whose structure adapts to the energy of another (built) tree:
+     * Quadrants that hold more than the given fraction of the energy are subdivided, all others are collapsed.
+     */
+    void refine(const DirectionalTree &source, float threshold, int maxDepth);
+    /// @brief Scales the number of recorded samples (e.g., when the samples are split between two spatial regions).
+    void scaleWeight(float factor) { m_weight *= factor; }
+
+    /// @brief Samples a direction proportional to the distribution (requires @ref sum to be positive).
+    Vector sample(Point2 rnd) const;
+    /// @brief Returns the density (with respect to solid angle) of @ref sample producing the given direction.
+    float pdf(const Vector &direction) const;
+
+    /// @brief The total energy in the tree (only valid after @ref build ).
+    float sum() const { return m_sum; }
+    /// @brief The number of samples that have been recorded.
+    float weight() const { return m_weight; }
+    int nodeCount() const { return int(m_nodes.size()); }
+};
+
+/**
+ * @brief A spatio-directional tree for path guiding, which learns the distribution of incident radiance in the scene.
+ * A binary tree subdivides the bounds of the scene (alternating between the axes), and each spatial leaf holds a
+ * directional quadtree used for sampling as well as one into which new paths are recorded.
+ * Learning happens in passes: After each pass, spatial leaves that received many samples are split and the recorded
+ * directional trees replace the ones used for sampling.
+ * @see "Practical Path Guiding for Efficient Light-Transport Simulation" [Müller et al. 2017]
+ */
+class SDTree {
+public:
+    /// @brief The directional distributions of a spatial leaf.
+    struct Directions {
+        /// @brief The distribution learned in previous passes, which is used for sampling.
+        DirectionalTree sampling;
+        /// @brief The distribution recorded in the current pass.
+        DirectionalTree building;
+    };
+
+private:
+    struct Node {
+        Directions directions;
+        /// @brief The axis along which this node is split.
+        int axis = 0;
+        /// @brief The indices of the two halves of this node (or zero if the node is a leaf).
+        std::array<uint32_t, 2> children {};
+    };
+
+    Bounds m_bounds;
+    std::vector<Node> m_nodes;
+
+public:
+    SDTree(const Bounds &sceneBounds);
+
+    /// @brief Finds the directional distributions of the spatial leaf containing the given position.
+    Directions &lookup(Point position);
+    const Directions &lookup(const Point &position) const {
+        return const_cast<SDTree *>(this)->lookup(position);
+    }
+
+    /**
+     * @brief Concludes a learning pass: The recorded distributions become available for sampling, spatial leaves
+     * that recorded more than @c spatialThreshold samples are split, and the directional trees for recording are
+     * reset with a structure adapted to the recorded energy.
+     */
+    void refine(float spatialThreshold, float directionalThreshold, int maxDirectionalDepth);
+
+    /// @brief The number of spatial leaves.
+    int leafCount() const;
+};
+
+}
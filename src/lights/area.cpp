@@ -6,11 +6,34 @@ namespace lightwave
     class AreaLight final : public Light
     {
         ref<Instance> m_instance;
+        /// @brief The emitted power, which is estimated once when the light is created (see @ref estimatePower ).
+        Color m_power;
+
+        /// @brief Estimates the emitted power by averaging the (front-facing) emission over random points on the
+        /// surface, which only needs to be approximate as it merely steers which light gets sampled.
+        Color estimatePower() const
+        {
+            constexpr int NumSamples = 256;
+            auto rng = std::static_pointer_cast<Sampler>(Registry::create("sampler", "independent", Properties()));
+            rng->seed(0);
+            Color radiantExitance;
+            for (int i = 0; i < NumSamples; i++)
+            {
+                const AreaSample sample = m_instance->sampleArea(*rng);
+                if (sample.pdf > 0)
+                {
+                    radiantExitance += m_instance->emission()->evaluate(sample.uv, Vector(0, 0, 1)).value * Color(sample.tint) / sample.pdf;
+                }
+            }
+            return Pi * radiantExitance / NumSamples;
+        }
 
     public:
         AreaLight(const Properties &properties)
         {
             m_instance = properties.getChild<Instance>();
+            m_instance->setLight(this);
+            m_power = estimatePower();
         }
 
         DirectLightSample sampleDirect(const Point &origin,
@@ -27,13 +50,54 @@ namespace lightwave
             Li.wi = dir.normalized();
             auto wo = areasample.frame.toLocal(-Li.wi).normalized();
             auto costheta = Frame::absCosTheta(wo);
-            auto intensity = m_instance->emission()->evaluate(areasample.uv, wo).value;
+            auto intensity = m_instance->emission()->evaluate(areasample.uv, wo).value * Color(areasample.tint);
             Li.weight = intensity*costheta/ (areasample.pdf*dir.lengthSquared());
             Li.distance = dir.length();
+            Li.pdf = costheta > 0 ? areasample.pdf * dir.lengthSquared() / costheta : 0;
             return Li;
         }
 
-        bool canBeIntersected() const override { return false; }
+        EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override
+        {
+            const AreaSample areasample = m_instance->sampleArea(rng);
+            if (!(areasample.pdf > 0))
+                return EmissionSample::invalid();
+
+            // the emission is sampled proportional to the cosine, which cancels out for diffuse emitters
+            const Vector wo = squareToCosineHemisphere(rng.next2D());
+            const Color intensity = m_instance->emission()->evaluate(areasample.uv, wo).value * Color(areasample.tint);
+            return {
+                .ray = Ray(areasample.position, areasample.frame.toWorld(wo).normalized()),
+                .weight = intensity * Pi / areasample.pdf,
+                .surface = areasample,
+            };
+        }
+
+        bool canBeIntersected() const override { return m_instance->isVisible(); }
+
+        float pdf(const Point &origin, const Intersection &its) const override
+        {
+            // the density of sampling the point by area, converted to solid angle
+            const float cosTheta = std::abs(its.frame.normal.dot(its.wo));
+            if (!(cosTheta > 0))
+                return 0;
+            return its.pdf * (its.position - origin).lengthSquared() / cosTheta;
+        }
+
+        Color power(const Bounds &sceneBounds) const override
+        {
+            return m_power;
+        }
+
+        std::optional<LightBounds> bounds() const override
+        {
+            return LightBounds{
+                .bounds = m_instance->getBoundingBox(),
+                .cosThetaO = -1,
+                .cosThetaE = 0,
+                .phi = m_power.luminance(),
+            };
+        }
 
         std::string toString() const override
         {
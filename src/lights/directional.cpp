@@ -28,8 +28,32 @@ namespace lightwave
             return dls;
         }
 
+        EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override
+        {
+            // rays start on a disk that covers the scene (cf. power), facing along the direction of the light
+            if (sceneBounds.isEmpty() || sceneBounds.isUnbounded())
+                return EmissionSample::invalid();
+            const float radius = sceneBounds.diagonal().length() / 2;
+            const Point center = sceneBounds.min() + sceneBounds.diagonal() / 2;
+            const Frame frame(-direction);
+            const Point2 disk = squareToUniformDiskConcentric(rng.next2D());
+            const Point origin = center + radius * (direction + disk.x() * frame.tangent + disk.y() * frame.bitangent);
+            return {
+                .ray = Ray(origin, -direction),
+                .weight = Pi * sqr(radius) * intensity,
+                .surface = SurfaceEvent(),
+            };
+        }
+
         bool canBeIntersected() const override { return false; }
 
+        Color power(const Bounds &sceneBounds) const override
+        {
+            // the light passes through a disk that covers the scene
+            const float radius = sceneBounds.isEmpty() || sceneBounds.isUnbounded() ? 1 : sceneBounds.diagonal().length() / 2;
+            return Pi * sqr(radius) * intensity;
+        }
+
         std::string toString() const override
         {
             return tfm::format("DirectionalLight[\n"
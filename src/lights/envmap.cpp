@@ -11,60 +11,136 @@ namespace lightwave
         /// @brief An optional transform from local-to-world space
         ref<Transform> m_transform;
 
+        /// @brief The distribution used to sample texture coordinates proportional to the emitted luminance.
+        PiecewiseConstant2D m_distribution;
+
+        /// @brief Maps a direction in local coordinates to texture coordinates and the sine of its polar angle.
+        static Point2 directionToUv(const Vector &direction, float &sinTheta)
+        {
+            sinTheta = sqrt(sqr(direction.x()) + sqr(direction.z()));
+            const float theta = atan2(sinTheta, direction.y());
+            const float phi = atan2(direction.z(), direction.x());
+            return Point2(0.5f - phi / (2 * Pi), theta / Pi);
+        }
+
+        /// @brief Maps texture coordinates to a direction in local coordinates.
+        static Vector uvToDirection(const Point2 &uv)
+        {
+            const float theta = uv.y() * Pi;
+            const float phi = (0.5f - uv.x()) * 2 * Pi;
+            return Vector(sin(theta) * cos(phi), cos(theta), sin(theta) * sin(phi));
+        }
+
+        /// @brief Tabulates the luminance of the texture (weighted by the area each texel covers on the sphere).
+        void buildDistribution()
+        {
+            const Point2i textureResolution = m_texture->resolution();
+            const Point2i resolution(std::max(textureResolution.x(), 64), std::max(textureResolution.y(), 32));
+            std::vector<float> values(size_t(resolution.x()) * resolution.y());
+            for_each_parallel(Range(0, resolution.y()), [&](int y)
+            {
+                const float sinTheta = sin(Pi * (y + 0.5f) / resolution.y());
+                for (int x = 0; x < resolution.x(); x++)
+                {
+                    // the texture is filtered, hence we take the maximum of the center and the corners of each cell
+                    // to avoid assigning zero probability to cells that receive light from their neighbors
+                    float luminance = m_texture->evaluate(Point2((x + 0.5f) / resolution.x(), (y + 0.5f) / resolution.y())).luminance();
+                    for (int corner = 0; corner < 4; corner++)
+                    {
+                        const Point2 uv((x + (corner & 1)) / float(resolution.x()), (y + (corner >> 1)) / float(resolution.y()));
+                        luminance = std::max(luminance, m_texture->evaluate(uv).luminance());
+                    }
+                    values[size_t(y) * resolution.x() + x] = luminance * sinTheta;
+                }
+            });
+            m_distribution = PiecewiseConstant2D(values, resolution);
+        }
+
     public:
         EnvironmentMap(const Properties &properties)
         {
             m_texture = properties.getChild<Texture>();
             m_transform = properties.getOptionalChild<Transform>();
+            buildDistribution();
         }
 
         BackgroundLightEval evaluate(const Vector &direction) const override
         {
-            Vector2 warped = Vector2(0, 0);
-            // hints:
-            // * if (m_transform) { transform direction vector from world to local
-            // coordinates }
-            // * find the corresponding pixel coordinate for the given local
-            // direction
-            //
-            auto local_dir = direction;
+            Vector local_dir = direction;
             if (m_transform)
             {
                 local_dir = m_transform->inverse(direction).normalized();
             }
-            auto x = local_dir.x();
-            auto y = local_dir.y();
-            auto z = local_dir.z();
-            float phi, theta;
-            theta = atan2(sqrt(std::pow(x, 2) + std::pow(z, 2)), y);
-            phi = atan2(z, x);
-            phi -= Pi;
-
-            warped.y() = theta / Pi;
-            warped.x() = 0.5- ((phi+Pi) / (2 * Pi));
-            // warped.y() = 1- warped.y();
+            float sinTheta;
             return {
-                .value = m_texture->evaluate(warped),
+                .value = m_texture->evaluate(directionToUv(local_dir, sinTheta)),
             };
         }
 
+        Color power(const Bounds &sceneBounds) const override
+        {
+            // average the emission over the sphere of directions on a coarse latitude-longitude grid
+            constexpr int Width = 64, Height = 32;
+            Color sum;
+            float weight = 0;
+            for (int y = 0; y < Height; y++)
+            {
+                const float sinTheta = sin(Pi * (y + 0.5f) / Height);
+                for (int x = 0; x < Width; x++)
+                {
+                    sum += sinTheta * m_texture->evaluate(Point2((x + 0.5f) / Width, (y + 0.5f) / Height));
+                    weight += sinTheta;
+                }
+            }
+
+            // light arriving from all directions passes through a disk that covers the scene
+            const float radius = sceneBounds.isEmpty() || sceneBounds.isUnbounded() ? 1 : sceneBounds.diagonal().length() / 2;
+            return 4 * sqr(Pi * radius) * sum / weight;
+        }
+
         DirectLightSample sampleDirect(const Point &origin,
                                        Sampler &rng) const override
         {
-            Vector direction = squareToUniformSphere(rng.next2D());
-            auto E = evaluate(direction);
+            float pdf;
+            const Point2 uv = m_distribution.sample(rng.next2D(), pdf);
+            const float sinTheta = sin(uv.y() * Pi);
+            if (pdf == 0 || sinTheta == 0)
+            {
+                return DirectLightSample::invalid();
+            }
 
-            // implement better importance sampling here, if you ever need it
-            // (useful for environment maps with bright tiny light sources, like the
-            // sun for example)
+            Vector direction = uvToDirection(uv);
+            if (m_transform)
+            {
+                direction = m_transform->apply(direction).normalized();
+            }
 
+            // convert the density from texture space to solid angle
+            pdf /= 2 * sqr(Pi) * sinTheta;
             return {
                 .wi = direction,
-                .weight = E.value / Inv4Pi,
+                .weight = m_texture->evaluate(uv) / pdf,
                 .distance = Infinity,
+                .pdf = pdf,
             };
         }
 
+        float pdf(const Vector &direction) const override
+        {
+            Vector local_dir = direction;
+            if (m_transform)
+            {
+                local_dir = m_transform->inverse(direction).normalized();
+            }
+            float sinTheta;
+            const Point2 uv = directionToUv(local_dir, sinTheta);
+            if (sinTheta == 0)
+            {
+                return 0;
+            }
+            return m_distribution.pdf(uv) / (2 * sqr(Pi) * sinTheta);
+        }
+
         std::string toString() const override
         {
             return tfm::format("EnvironmentMap[\n"
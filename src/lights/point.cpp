@@ -27,8 +27,33 @@ namespace lightwave
             return Li;
         }
 
+        EmissionSample sampleEmission(const Bounds &sceneBounds, Sampler &rng) const override
+        {
+            // the intensity is divided by the density of uniformly sampling a direction
+            return {
+                .ray = Ray(pLight, squareToUniformSphere(rng.next2D())),
+                .weight = Power,
+                .surface = SurfaceEvent(),
+            };
+        }
+
         bool canBeIntersected() const override { return false; }
 
+        Color power(const Bounds &sceneBounds) const override
+        {
+            return Power;
+        }
+
+        std::optional<LightBounds> bounds() const override
+        {
+            return LightBounds{
+                .bounds = Bounds(pLight, pLight),
+                .cosThetaO = -1,
+                .cosThetaE = 0,
+                .phi = Power.luminance(),
+            };
+        }
+
         std::string toString() const override
         {
             return tfm::format("PointLight[\n"
@@ -0,0 +1,217 @@
+#include <lightwave.hpp>
+
+#include <array>
+#include <cmath>
+#include <vector>
+#include "pcg32.h"
+
+namespace lightwave {
+
+namespace {
+
+/// @brief The resolution of the (square) blue noise mask, which is tiled over the image.
+constexpr int MaskSize = 64;
+constexpr int MaskPixels = MaskSize * MaskSize;
+
+/**
+ * @brief A tileable blue noise mask, i.e., a permutation of the values 0 to @c MaskPixels - 1 whose low values (and
+ * high values) are evenly spread out over the mask with no low-frequency clumping.
+ * The mask is generated by the void-and-cluster method by Ulichney ("The void-and-cluster method for dither array
+ * generation"), which only takes a few milliseconds and hence is done on first use instead of shipping the data.
+ */
+class BlueNoiseMask {
+    /// @brief The rank of each pixel, in the form of 32-bit fixed point numbers in [0,1).
+    std::array<uint32_t, MaskPixels> m_values;
+
+    /// @brief Finds the set pixel with the highest energy (or the unset pixel with the lowest energy).
+    static int extremum(const std::vector<float> &energy, const std::vector<bool> &pattern, bool set) {
+        int best = -1;
+        for (int i = 0; i < MaskPixels; i++) {
+            if (pattern[i] != set)
+                continue;
+            if (best < 0 || (set ? energy[i] > energy[best] : energy[i] < energy[best]))
+                best = i;
+        }
+        return best;
+    }
+
+    /// @brief Adds (or removes) the toroidal Gaussian energy of a set pixel.
+    static void splat(std::vector<float> &energy, const std::vector<float> &kernel, int pixel, float sign) {
+        const int px = pixel % MaskSize, py = pixel / MaskSize;
+        for (int y = 0; y < MaskSize; y++) {
+            const int dy = (y - py + MaskSize) % MaskSize;
+            for (int x = 0; x < MaskSize; x++) {
+                const int dx = (x - px + MaskSize) % MaskSize;
+                energy[y * MaskSize + x] += sign * kernel[dy * MaskSize + dx];
+            }
+        }
+    }
+
+public:
+    BlueNoiseMask() {
+        // the energy contributed by a set pixel at the given toroidal offset
+        constexpr float Sigma = 1.5f;
+        std::vector<float> kernel(MaskPixels);
+        for (int dy = 0; dy < MaskSize; dy++) {
+            for (int dx = 0; dx < MaskSize; dx++) {
+                const int wx = std::min(dx, MaskSize - dx), wy = std::min(dy, MaskSize - dy);
+                kernel[dy * MaskSize + dx] = std::exp(-float(wx * wx + wy * wy) / (2 * Sigma * Sigma));
+            }
+        }
+
+        // start with a random pattern of minority pixels and move them from the tightest cluster into the largest
+        // void until the pattern is evenly distributed
+        constexpr int InitialCount = MaskPixels / 10;
+        pcg32 rng;
+        std::vector<bool> initial(MaskPixels, false);
+        std::vector<float> initialEnergy(MaskPixels, 0.f);
+        for (int count = 0; count < InitialCount;) {
+            const int pixel = int(rng.nextUInt(MaskPixels));
+            if (initial[pixel])
+                continue;
+            initial[pixel] = true;
+            splat(initialEnergy, kernel, pixel, +1);
+            count++;
+        }
+        while (true) {
+            const int cluster = extremum(initialEnergy, initial, true);
+            initial[cluster] = false;
+            splat(initialEnergy, kernel, cluster, -1);
+            const int hole = extremum(initialEnergy, initial, false);
+            initial[hole] = true;
+            splat(initialEnergy, kernel, hole, +1);
+            if (hole == cluster)
+                break;
+        }
+
+        std::vector<int> rank(MaskPixels);
+
+        // the initial pixels receive the lowest ranks, in the order in which removing them leaves the pattern even
+        std::vector<bool> pattern = initial;
+        std::vector<float> energy = initialEnergy;
+        for (int r = InitialCount - 1; r >= 0; r--) {
+            const int cluster = extremum(energy, pattern, true);
+            pattern[cluster] = false;
+            splat(energy, kernel, cluster, -1);
+            rank[cluster] = r;
+        }
+
+        // all other pixels are ranked in the order in which they fill the largest remaining void
+        pattern = std::move(initial);
+        energy = std::move(initialEnergy);
+        for (int r = InitialCount; r < MaskPixels; r++) {
+            const int hole = extremum(energy, pattern, false);
+            pattern[hole] = true;
+            splat(energy, kernel, hole, +1);
+            rank[hole] = r;
+        }
+
+        for (int i = 0; i < MaskPixels; i++) {
+            m_values[i] = uint32_t((uint64_t(2 * rank[i] + 1) << 32) / (2 * MaskPixels));
+        }
+    }
+
+    /// @brief Returns the value of the mask at the given pixel (wrapping around at the borders).
+    uint32_t operator()(int x, int y) const {
+        return m_values[(y & (MaskSize - 1)) * MaskSize + (x & (MaskSize - 1))];
+    }
+
+    /// @brief Returns the mask shared by all samplers, which is generated on first use.
+    static const BlueNoiseMask &get() {
+        static const BlueNoiseMask mask;
+        return mask;
+    }
+};
+
+/// @brief The 1D golden ratio sequence and the 2D R2 sequence by Roberts, as 32-bit fixed point increments.
+constexpr uint32_t Golden = 0x9e3779b9u;
+constexpr uint32_t R2X = 0xc13fa9a9u;
+constexpr uint32_t R2Y = 0x91e10da5u;
+
+inline float toFloat(uint32_t v) {
+    return std::min(float(v) * 0x1p-32f, 0x1.fffffep-1f);
+}
+
+}
+
+/**
+ * @brief Generates samples whose error is distributed as blue noise in screen space, which looks much less
+ * objectionable than white noise at low sample counts and is easier to denoise.
+ * Each dimension (or pair of dimensions for @ref next2D ) looks up a randomly shifted copy of a tiled blue noise mask
+ * at the pixel, which provides the value of the first sample. Further samples of the same pixel advance along the
+ * golden ratio sequence (or the R2 sequence in 2D), which keeps them stratified while retaining the blue noise
+ * distribution across pixels for every sample count (cf. Wolfe et al., "Spatiotemporal Blue Noise Masks").
+ */
+class BlueNoise : public Sampler {
+    uint64_t m_seed;
+
+    Point2i m_pixel;
+    uint32_t m_sampleIndex;
+    /// @brief The next dimension of the current sample that will be consumed.
+    int m_dimension;
+
+    /// @brief Looks up the blue noise mask at the current pixel, shifted randomly for the given dimension.
+    uint32_t mask(int dimension) const {
+        pcg32 rng(m_seed, uint64_t(dimension));
+        const uint32_t shift = rng.nextUInt();
+        return BlueNoiseMask::get()(m_pixel.x() + int(shift & 0xffff), m_pixel.y() + int(shift >> 16));
+    }
+
+public:
+    BlueNoise(const Properties &properties)
+    : Sampler(properties) {
+        m_seed = properties.get<int>("seed", 1337);
+        m_pixel = Point2i(0, 0);
+        m_sampleIndex = 0;
+        m_dimension = 0;
+        // generate the mask upfront instead of during rendering
+        BlueNoiseMask::get();
+    }
+
+    void seed(int sampleIndex) override {
+        seed(Point2i(0, 0), sampleIndex);
+    }
+
+    void seed(const Point2i &pixel, int sampleIndex) override {
+        m_pixel = pixel;
+        m_sampleIndex = uint32_t(sampleIndex);
+        m_dimension = 0;
+    }
+
+    void skipToDimension(int dimension) override {
+        m_dimension = std::max(m_dimension, dimension);
+    }
+
+    float next() override {
+        const uint32_t offset = mask(m_dimension++);
+        return toFloat(offset + m_sampleIndex * Golden);
+    }
+
+    Point2 next2D() override {
+        const uint32_t offsetX = mask(m_dimension++);
+        const uint32_t offsetY = mask(m_dimension++);
+        return {
+            toFloat(offsetX + m_sampleIndex * R2X),
+            toFloat(offsetY + m_sampleIndex * R2Y),
+        };
+    }
+
+    ref<Sampler> clone() const override {
+        return std::make_shared<BlueNoise>(*this);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "BlueNoise[\n"
+            "  count = %d,\n"
+            "  seed = %d\n"
+            "]",
+            m_samplesPerPixel,
+            m_seed
+        );
+    }
+};
+
+}
+
+REGISTER_SAMPLER(BlueNoise, "bluenoise")
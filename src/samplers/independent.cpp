@@ -15,6 +15,8 @@ namespace lightwave {
 class Independent : public Sampler {
     uint64_t m_seed;
     pcg32 m_pcg;
+    /// @brief The number of random numbers consumed since the sampler was seeded.
+    int m_dimension = 0;
 
 public:
     Independent(const Properties &properties)
@@ -24,15 +26,26 @@ public:
 
     void seed(int sampleIndex) override {
         m_pcg.seed(m_seed, sampleIndex);
+        m_dimension = 0;
     }
 
     void seed(const Point2i &pixel, int sampleIndex) override {
         const uint64_t a = (uint64_t(pixel.x()) << 32) ^ pixel.y();
         m_pcg.seed(m_seed, a);
         m_pcg.seed(m_pcg.nextUInt(), sampleIndex);
+        m_dimension = 0;
+    }
+
+    void skipToDimension(int dimension) override {
+        // jumping ahead lets integrators that seed a sample again continue it with fresh random numbers
+        if (dimension > m_dimension) {
+            m_pcg.advance(int64_t(dimension) - m_dimension);
+            m_dimension = dimension;
+        }
     }
 
     float next() override {
+        m_dimension++;
         return m_pcg.nextFloat();
     }
 
@@ -0,0 +1,125 @@
+#include <lightwave.hpp>
+
+#include "philox.h"
+
+namespace lightwave {
+
+/**
+ * @brief Generates independent random numbers uniformly distributed in [0,1), like the @ref Independent sampler, but
+ * using the counter-based Philox generator instead of a sequential one.
+ * Every random number is a pure function of the pixel, the sample index and its dimension (i.e., its position in the
+ * sequence of random numbers of that sample). This makes samples reproducible regardless of which random numbers
+ * were consumed before, and allows generating batches of random numbers with SIMD instructions via @ref nextN .
+ */
+class Philox : public Sampler {
+    /// @brief The number of random numbers that are generated together by a single Philox invocation.
+    static constexpr int BlockSize = 4;
+    /// @brief The number of Philox invocations that are computed at once in @ref nextN .
+    static constexpr int Lanes = 4;
+
+    philox4x32::key_type m_key;
+    /// @brief The counter of the current sample, whose first word is replaced by the index of the block.
+    philox4x32::counter_type m_counter;
+    /// @brief The next dimension of the current sample that will be consumed.
+    uint32_t m_dimension;
+
+    /// @brief The random numbers of the most recently generated block (to serve consecutive calls of @ref next ).
+    philox4x32::counter_type m_block;
+    uint32_t m_blockIndex;
+
+    uint32_t nextUInt() {
+        const uint32_t blockIndex = m_dimension / BlockSize;
+        if (blockIndex != m_blockIndex) {
+            philox4x32::counter_type counter = m_counter;
+            counter[0] = blockIndex;
+            m_block = philox4x32::generate(counter, m_key);
+            m_blockIndex = blockIndex;
+        }
+        return m_block[m_dimension++ % BlockSize];
+    }
+
+    void reset() {
+        m_dimension = 0;
+        m_blockIndex = ~0u;
+    }
+
+public:
+    Philox(const Properties &properties)
+    : Sampler(properties) {
+        const uint64_t seed = uint64_t(properties.get<int>("seed", 1337));
+        m_key = { uint32_t(seed), uint32_t(seed >> 32) };
+        m_counter = { 0, 0, ~0u, ~0u };
+        reset();
+    }
+
+    void seed(int sampleIndex) override {
+        // streams that are not associated with a pixel use an invalid pixel coordinate to not collide with those that are
+        m_counter = { 0, uint32_t(sampleIndex), ~0u, ~0u };
+        reset();
+    }
+
+    void seed(const Point2i &pixel, int sampleIndex) override {
+        m_counter = { 0, uint32_t(sampleIndex), uint32_t(pixel.x()), uint32_t(pixel.y()) };
+        reset();
+    }
+
+    void skipToDimension(int dimension) override {
+        m_dimension = std::max(m_dimension, uint32_t(dimension));
+    }
+
+    float next() override {
+        return philox4x32::toFloat(nextUInt());
+    }
+
+    Point2 next2D() override {
+        const float x = next();
+        return { x, next() };
+    }
+
+    void nextN(std::span<float> values) override {
+        size_t i = 0;
+        // finish the current block so that the remaining values start at a block boundary
+        while (i < values.size() && m_dimension % BlockSize != 0) {
+            values[i++] = next();
+        }
+
+        constexpr size_t BatchSize = BlockSize * Lanes;
+        while (values.size() - i >= BatchSize) {
+            uint32_t counters[BlockSize][Lanes], block[BlockSize][Lanes];
+            for (int lane = 0; lane < Lanes; lane++) {
+                counters[0][lane] = m_dimension / BlockSize + lane;
+                counters[1][lane] = m_counter[1];
+                counters[2][lane] = m_counter[2];
+                counters[3][lane] = m_counter[3];
+            }
+            philox4x32::generate<Lanes>(counters, m_key, block);
+            for (int lane = 0; lane < Lanes; lane++) {
+                for (int word = 0; word < BlockSize; word++) {
+                    values[i++] = philox4x32::toFloat(block[word][lane]);
+                }
+            }
+            m_dimension += BatchSize;
+        }
+
+        while (i < values.size()) {
+            values[i++] = next();
+        }
+    }
+
+    ref<Sampler> clone() const override {
+        return std::make_shared<Philox>(*this);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "Philox[\n"
+            "  count = %d\n"
+            "]",
+            m_samplesPerPixel
+        );
+    }
+};
+
+}
+
+REGISTER_SAMPLER(Philox, "philox")
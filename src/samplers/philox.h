@@ -0,0 +1,91 @@
+/*
+ * Philox4x32-10 counter-based random number generator.
+ *
+ * Philox was developed by John K. Salmon, Mark A. Moraes, Ron O. Dror and
+ * David E. Shaw, "Parallel Random Numbers: As Easy as 1, 2, 3" (SC 2011).
+ * Unlike a sequential generator, every output is a pure function of a
+ * 128-bit counter and a 64-bit key, hence arbitrary elements of a stream can
+ * be generated independently (and many of them at once).
+ */
+
+#pragma once
+
+#include <inttypes.h>
+#include <array>
+
+/// Philox4x32-10 counter-based pseudorandom number generator
+struct philox4x32 {
+    using counter_type = std::array<uint32_t, 4>;
+    using key_type = std::array<uint32_t, 2>;
+
+    static constexpr uint32_t M0 = 0xD2511F53u;
+    static constexpr uint32_t M1 = 0xCD9E8D57u;
+    static constexpr uint32_t W0 = 0x9E3779B9u;
+    static constexpr uint32_t W1 = 0xBB67AE85u;
+    static constexpr int Rounds = 10;
+
+    /// Compute the four 32-bit random numbers belonging to the given counter
+    static counter_type generate(counter_type ctr, key_type key) {
+        for (int round = 0; round < Rounds; round++) {
+            const uint64_t p0 = uint64_t(M0) * ctr[0];
+            const uint64_t p1 = uint64_t(M1) * ctr[2];
+            ctr = {
+                uint32_t(p1 >> 32) ^ ctr[1] ^ key[0],
+                uint32_t(p1),
+                uint32_t(p0 >> 32) ^ ctr[3] ^ key[1],
+                uint32_t(p0),
+            };
+            key[0] += W0;
+            key[1] += W1;
+        }
+        return ctr;
+    }
+
+    /**
+     * \brief Compute the random numbers of several counters at once
+     *
+     * The counters are stored as structure of arrays (ctr[word][lane]), which
+     * allows the compiler to process all lanes in SIMD registers. The results
+     * are written to out[word][lane].
+     */
+    template <int Lanes>
+    static void generate(const uint32_t (&ctr)[4][Lanes], key_type key, uint32_t (&out)[4][Lanes]) {
+        uint32_t c0[Lanes], c1[Lanes], c2[Lanes], c3[Lanes];
+        for (int lane = 0; lane < Lanes; lane++) {
+            c0[lane] = ctr[0][lane];
+            c1[lane] = ctr[1][lane];
+            c2[lane] = ctr[2][lane];
+            c3[lane] = ctr[3][lane];
+        }
+        for (int round = 0; round < Rounds; round++) {
+            for (int lane = 0; lane < Lanes; lane++) {
+                const uint64_t p0 = uint64_t(M0) * c0[lane];
+                const uint64_t p1 = uint64_t(M1) * c2[lane];
+                c0[lane] = uint32_t(p1 >> 32) ^ c1[lane] ^ key[0];
+                c1[lane] = uint32_t(p1);
+                c2[lane] = uint32_t(p0 >> 32) ^ c3[lane] ^ key[1];
+                c3[lane] = uint32_t(p0);
+            }
+            key[0] += W0;
+            key[1] += W1;
+        }
+        for (int lane = 0; lane < Lanes; lane++) {
+            out[0][lane] = c0[lane];
+            out[1][lane] = c1[lane];
+            out[2][lane] = c2[lane];
+            out[3][lane] = c3[lane];
+        }
+    }
+
+    /// Convert a 32-bit random number to a single precision value on the interval [0, 1)
+    static float toFloat(uint32_t v) {
+        /* Same trick as pcg32::nextFloat: generate an uniformly distributed
+           single precision number in [1,2) and subtract 1. */
+        union {
+            uint32_t u;
+            float f;
+        } x;
+        x.u = (v >> 9) | 0x3f800000u;
+        return x.f - 1.0f;
+    }
+};
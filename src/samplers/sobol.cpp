@@ -0,0 +1,221 @@
+#include <lightwave.hpp>
+
+#include <array>
+#include <bit>
+
+namespace lightwave {
+
+namespace {
+
+/// @brief The number of index bits that contribute to a 32-bit Sobol sample of the first two dimensions.
+constexpr int SobolMatrixSize = 32;
+
+/// @brief Computes the generator matrix of the given (one of the first two) Sobol dimension in 32-bit precision.
+constexpr std::array<uint32_t, SobolMatrixSize> sobolMatrix(int dimension) {
+    std::array<uint32_t, SobolMatrixSize> matrix {};
+    // the first dimension is the van der Corput sequence, the second dimension is generated by the primitive
+    // polynomial x + 1 (with direction numbers m_1 = 1 and m_k = 2 m_{k-1} ^ m_{k-1})
+    uint32_t m = 1;
+    for (int k = 0; k < SobolMatrixSize; k++) {
+        matrix[k] = (dimension == 0 ? 1u : m) << (SobolMatrixSize - 1 - k);
+        m = (m << 1) ^ m;
+    }
+    return matrix;
+}
+
+constexpr std::array<std::array<uint32_t, SobolMatrixSize>, 2> SobolMatrices = {
+    sobolMatrix(0),
+    sobolMatrix(1),
+};
+
+/// @brief A 64-bit finalizer with good avalanche behavior (from MurmurHash3 / splitmix64).
+inline uint64_t mixBits(uint64_t v) {
+    v ^= (v >> 31);
+    v *= 0x7fb5d329728ea185ull;
+    v ^= (v >> 27);
+    v *= 0x81dadef4bc2dd44dull;
+    v ^= (v >> 33);
+    return v;
+}
+
+inline uint64_t hash(uint64_t a, uint64_t b) {
+    return mixBits(a ^ mixBits(b + 0x9e3779b97f4a7c15ull));
+}
+
+inline uint32_t reverseBits(uint32_t v) {
+    v = ((v >> 1) & 0x55555555u) | ((v & 0x55555555u) << 1);
+    v = ((v >> 2) & 0x33333333u) | ((v & 0x33333333u) << 2);
+    v = ((v >> 4) & 0x0f0f0f0fu) | ((v & 0x0f0f0f0fu) << 4);
+    v = ((v >> 8) & 0x00ff00ffu) | ((v & 0x00ff00ffu) << 8);
+    return (v >> 16) | (v << 16);
+}
+
+/// @brief Inserts a zero bit between each of the lower 16 bits of the given number.
+inline uint64_t spreadBits(uint32_t v) {
+    uint64_t x = v & 0xffffu;
+    x = (x | (x << 8)) & 0x00ff00ffu;
+    x = (x | (x << 4)) & 0x0f0f0f0fu;
+    x = (x | (x << 2)) & 0x33333333u;
+    x = (x | (x << 1)) & 0x55555555u;
+    return x;
+}
+
+/**
+ * @brief Owen scrambling of a 32-bit fixed point number, i.e., a random permutation of each digit that only depends
+ * on the preceding digits, using the hash-based approximation by Laine and Karras.
+ */
+inline uint32_t owenScramble(uint32_t v, uint32_t seed) {
+    v = reverseBits(v);
+    v ^= v * 0x3d20adeau;
+    v += seed;
+    v *= (seed >> 16) | 1;
+    v ^= v * 0x05526c56u;
+    v ^= v * 0x53a22864u;
+    return reverseBits(v);
+}
+
+/// @brief Computes an Owen scrambled sample of the first or second Sobol dimension.
+inline float sobolSample(uint32_t index, int dimension, uint32_t seed) {
+    uint32_t v;
+    if (dimension == 0) {
+        v = reverseBits(index);
+    } else {
+        v = 0;
+        for (; index != 0; index &= index - 1) {
+            v ^= SobolMatrices[1][std::countr_zero(index)];
+        }
+    }
+    v = owenScramble(v, seed);
+    return std::min(float(v) * 0x1p-32f, 0x1.fffffep-1f);
+}
+
+}
+
+/**
+ * @brief Generates low-discrepancy samples from the Owen scrambled Sobol sequence, following the ZSobol sampler by
+ * Ahmed and Wonka ("Screen-Space Blue-Noise Diffusion of Monte Carlo Sampling Error via Hierarchical Ordering of
+ * Pixels") as implemented in pbrt-v4.
+ * The samples of all pixels are taken from one global sequence, indexed by the Morton code of the pixel followed by
+ * the sample index. The digits of that index are randomly permuted per dimension, which keeps the samples of each
+ * pixel well stratified while decorrelating neighboring pixels (and distributing their error as blue noise).
+ * Each dimension (or pair of dimensions for @ref next2D ) uses the first (two) Sobol dimension(s) with its own
+ * scrambling, which avoids the poor projections of higher Sobol dimensions.
+ * @note The number of samples per pixel is rounded up to the next power of two, as only those are stratified.
+ */
+class Sobol : public Sampler {
+    int m_log2SamplesPerPixel;
+    uint64_t m_seed;
+
+    /// @brief The Morton code of the current pixel, followed by the bits of the current sample index.
+    uint64_t m_mortonIndex;
+    /// @brief The next dimension of the current sample that will be consumed.
+    int m_dimension;
+
+    /**
+     * @brief Permutes the digits of the Morton index for the current dimension.
+     * Only the digits that affect the lowest 32 bits of the result are computed, as higher bits of the index do not
+     * contribute to a 32-bit Sobol sample.
+     */
+    uint32_t sampleIndex() const {
+        // all 24 permutations of four elements
+        static constexpr uint8_t permutations[24][4] = {
+            { 0, 1, 2, 3 }, { 0, 1, 3, 2 }, { 0, 2, 1, 3 }, { 0, 2, 3, 1 }, { 0, 3, 2, 1 }, { 0, 3, 1, 2 },
+            { 1, 0, 2, 3 }, { 1, 0, 3, 2 }, { 1, 2, 0, 3 }, { 1, 2, 3, 0 }, { 1, 3, 2, 0 }, { 1, 3, 0, 2 },
+            { 2, 1, 0, 3 }, { 2, 1, 3, 0 }, { 2, 0, 1, 3 }, { 2, 0, 3, 1 }, { 2, 3, 0, 1 }, { 2, 3, 1, 0 },
+            { 3, 1, 2, 0 }, { 3, 1, 0, 2 }, { 3, 2, 1, 0 }, { 3, 2, 0, 1 }, { 3, 0, 2, 1 }, { 3, 0, 1, 2 },
+        };
+
+        // with an odd number of sample bits, the lowest digit only has a single bit
+        const int offset = m_log2SamplesPerPixel & 1;
+        const uint64_t dimensionHash = 0x55555555u * uint64_t(m_dimension);
+
+        // all digits above the most significant digit of the Morton index are zero and have no higher digits, hence
+        // they are all mapped to the same digit
+        const int topDigit = (SobolMatrixSize - 1 + offset) / 2;
+        const int highestDigit = m_mortonIndex ? (std::bit_width(m_mortonIndex) - 1 + offset) / 2 : -1;
+        const uint64_t leadingDigit = permutations[(mixBits(dimensionHash) >> 24) % 24][0];
+
+        uint64_t index = 0;
+        for (int digit = topDigit; digit >= offset; digit--) {
+            const int shift = 2 * digit - offset;
+            if (digit > highestDigit) {
+                index |= leadingDigit << shift;
+                continue;
+            }
+            const uint64_t higherDigits = m_mortonIndex >> (shift + 2);
+            const int permutation = int((mixBits(higherDigits ^ dimensionHash) >> 24) % 24);
+            index |= uint64_t(permutations[permutation][(m_mortonIndex >> shift) & 3]) << shift;
+        }
+        if (offset) {
+            index |= (m_mortonIndex & 1) ^ (mixBits((m_mortonIndex >> 1) ^ dimensionHash) & 1);
+        }
+        return uint32_t(index);
+    }
+
+public:
+    Sobol(const Properties &properties)
+    : Sampler(properties) {
+        m_seed = properties.get<int>("seed", 1337);
+
+        m_log2SamplesPerPixel = std::bit_width(uint32_t(std::max(m_samplesPerPixel, 1) - 1));
+        if (m_samplesPerPixel != 1 << m_log2SamplesPerPixel) {
+            logger(EWarn, "sobol sampler: rounding the sample count of %d up to %d",
+                m_samplesPerPixel, 1 << m_log2SamplesPerPixel);
+            m_samplesPerPixel = 1 << m_log2SamplesPerPixel;
+        }
+
+        m_mortonIndex = 0;
+        m_dimension = 0;
+    }
+
+    void seed(int sampleIndex) override {
+        seed(Point2i(0, 0), sampleIndex);
+    }
+
+    void seed(const Point2i &pixel, int sampleIndex) override {
+        const uint64_t morton = spreadBits(uint32_t(pixel.x())) | (spreadBits(uint32_t(pixel.y())) << 1);
+        m_mortonIndex = (morton << m_log2SamplesPerPixel) |
+            (uint64_t(sampleIndex) & ((uint64_t(1) << m_log2SamplesPerPixel) - 1));
+        m_dimension = 0;
+    }
+
+    void skipToDimension(int dimension) override {
+        // never go back, so that a bounce that consumed more dimensions than expected does not reuse them
+        m_dimension = std::max(m_dimension, dimension);
+    }
+
+    float next() override {
+        const uint32_t index = sampleIndex();
+        m_dimension++;
+        return sobolSample(index, 0, uint32_t(hash(m_dimension, m_seed)));
+    }
+
+    Point2 next2D() override {
+        const uint32_t index = sampleIndex();
+        m_dimension += 2;
+        const uint64_t bits = hash(m_dimension, m_seed);
+        return {
+            sobolSample(index, 0, uint32_t(bits)),
+            sobolSample(index, 1, uint32_t(bits >> 32)),
+        };
+    }
+
+    ref<Sampler> clone() const override {
+        return std::make_shared<Sobol>(*this);
+    }
+
+    std::string toString() const override {
+        return tfm::format(
+            "Sobol[\n"
+            "  count = %d,\n"
+            "  seed = %d\n"
+            "]",
+            m_samplesPerPixel,
+            m_seed
+        );
+    }
+};
+
+}
+
+REGISTER_SAMPLER(Sobol, "sobol")
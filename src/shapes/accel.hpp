@@ -4,7 +4,9 @@
 #include <lightwave/math.hpp>
 #include <lightwave/shape.hpp>
 
+#include <memory>
 #include <numeric>
+#include <span>
 
 namespace lightwave {
 
@@ -75,7 +77,7 @@ class AccelerationStructure : public Shape {
         }
     };
 
-    /// @brief A list of all BVH nodes.
+    /// @brief A list of all BVH nodes (only used while building).
     std::vector<Node> m_nodes;
     /**
      * @brief Mapping from internal @c NodeIndex to @c primitiveIndex as used by
@@ -88,10 +90,36 @@ class AccelerationStructure : public Shape {
      */
     std::vector<int> m_primitiveIndices;
 
+    /// @brief Stores the nodes and primitive indices of a BVH once it is built.
+    struct HierarchyStorage {
+        std::vector<Node> nodes;
+        std::vector<int> primitiveIndices;
+    };
+
+protected:
+    /**
+     * @brief A built BVH, which does not need to be owned by this shape: it
+     * can be shared by shapes with identical primitives (see @ref AssetCache ),
+     * or point directly into a memory mapped file.
+     */
+    struct Hierarchy {
+        std::span<const Node> nodes;
+        std::span<const int> primitiveIndices;
+        /// @brief Keeps the memory referenced by @c nodes and
+        /// @c primitiveIndices alive.
+        std::shared_ptr<const void> storage;
+    };
+    /// @brief The node type of the BVH, for shapes that store BVHs in files.
+    using BvhNode = Node;
+
+private:
+    /// @brief The BVH used for traversal.
+    Hierarchy m_hierarchy;
+
     /// @brief Returns the root BVH node.
     const Node &rootNode() const {
-        // by convention, this is always the first element of m_nodes
-        return m_nodes.front();
+        // by convention, this is always the first element of the nodes
+        return m_hierarchy.nodes.front();
     }
 
     /**
@@ -106,39 +134,39 @@ class AccelerationStructure : public Shape {
 
         bool wasIntersected = false;
         if (node.isLeaf()) {
-            for (NodeIndex i = 0; i < node.primitiveCount; i++) {
-                // update the statistic tracking how many children have been
-                // tested for intersection
-                its.stats.primCounter++;
-                // test the child for intersection
-                wasIntersected |= intersect(
-                    m_primitiveIndices[node.leftFirst + i], ray, its, rng);
-            }
+            // update the statistic tracking how many children have been
+            // tested for intersection
+            its.stats.primCounter += node.primitiveCount;
+            // test the children for intersection
+            wasIntersected = intersectLeaf(
+                m_hierarchy.primitiveIndices.subspan(node.leftFirst,
+                                                     node.primitiveCount),
+                ray, its, rng);
         } else { // internal node
             // test which bounding box is intersected first by the ray.
             // this allows us to traverse the children in the order they are
             // intersected in, which can help prune a lot of unnecessary
             // intersection tests.
             const auto leftT =
-                intersectAABB(m_nodes[node.leftChildIndex()].aabb, ray);
+                intersectAABB(m_hierarchy.nodes[node.leftChildIndex()].aabb, ray);
             const auto rightT =
-                intersectAABB(m_nodes[node.rightChildIndex()].aabb, ray);
+                intersectAABB(m_hierarchy.nodes[node.rightChildIndex()].aabb, ray);
             if (leftT < rightT) { // left child is hit first; test left child
                                   // first, then right child
                 if (leftT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.leftChildIndex()], ray, its, rng);
+                        m_hierarchy.nodes[node.leftChildIndex()], ray, its, rng);
                 if (rightT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.rightChildIndex()], ray, its, rng);
+                        m_hierarchy.nodes[node.rightChildIndex()], ray, its, rng);
             } else { // right child is hit first; test right child first, then
                      // left child
                 if (rightT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.rightChildIndex()], ray, its, rng);
+                        m_hierarchy.nodes[node.rightChildIndex()], ray, its, rng);
                 if (leftT < its.t)
                     wasIntersected |= intersectNode(
-                        m_nodes[node.leftChildIndex()], ray, its, rng);
+                        m_hierarchy.nodes[node.leftChildIndex()], ray, its, rng);
             }
         }
         return wasIntersected;
@@ -252,7 +280,7 @@ class AccelerationStructure : public Shape {
     /// @brief Attempts to subdivide a given BVH node.
     void subdivide(Node &parent) {
         // only subdivide if enough children are available.
-        if (parent.primitiveCount <= 2) {
+        if (parent.primitiveCount <= maxLeafSize()) {
             return;
         }
 
@@ -339,6 +367,40 @@ class AccelerationStructure : public Shape {
     }
 
 protected:
+    /// @brief Returns the built BVH, which can be shared without copying it.
+    const Hierarchy &hierarchy() const { return m_hierarchy; }
+    /// @brief Adopts a previously built BVH instead of building it again.
+    void setHierarchy(Hierarchy hierarchy) {
+        m_hierarchy = std::move(hierarchy);
+    }
+    /**
+     * @brief Returns whether a BVH that has not been built by this class (e.g., because it was read from a file) only
+     * references existing nodes and primitives, and stores child nodes after their parents (which rules out cycles).
+     * @note Requires @ref numberOfPrimitives to be available.
+     */
+    bool isValidHierarchy(const Hierarchy &hierarchy) const {
+        if (hierarchy.nodes.empty())
+            return false;
+        const int64_t primitiveCount = int64_t(hierarchy.primitiveIndices.size());
+        for (size_t index = 0; index < hierarchy.nodes.size(); index++) {
+            const Node &node = hierarchy.nodes[index];
+            if (node.primitiveCount < 0)
+                return false;
+            if (node.isLeaf()) {
+                if (node.firstPrimitiveIndex() < 0 ||
+                    int64_t(node.firstPrimitiveIndex()) + node.primitiveCount > primitiveCount)
+                    return false;
+            } else if (primitiveCount > 0) {
+                if (size_t(node.leftChildIndex()) <= index ||
+                    size_t(node.rightChildIndex()) >= hierarchy.nodes.size())
+                    return false;
+            }
+        }
+        const int count = numberOfPrimitives();
+        return std::all_of(hierarchy.primitiveIndices.begin(), hierarchy.primitiveIndices.end(),
+                           [&](int primitiveIndex) { return primitiveIndex >= 0 && primitiveIndex < count; });
+    }
+
     /// @brief Returns the number of children (individual shapes) that are part
     /// of this acceleration structure.
     virtual int numberOfPrimitives() const = 0;
@@ -351,6 +413,44 @@ protected:
     /// @brief Returns the centroid of the given child.
     virtual Point getCentroid(int primitiveIndex) const = 0;
 
+    /**
+     * @brief Intersects all children of a leaf node with the given ray.
+     * Shapes can override this to test the children of a leaf in a batch
+     * (see @ref leafOrder ).
+     */
+    virtual bool intersectLeaf(std::span<const int> primitiveIndices,
+                               const Ray &ray, Intersection &its,
+                               Sampler &rng) const {
+        bool wasIntersected = false;
+        for (const int primitiveIndex : primitiveIndices)
+            wasIntersected |= intersect(primitiveIndex, ray, its, rng);
+        return wasIntersected;
+    }
+    /// @brief The number of children up to which nodes are not subdivided
+    /// further.
+    virtual int maxLeafSize() const { return 2; }
+
+    /**
+     * @brief Returns the order in which the children are referenced by the
+     * leaf nodes of the built BVH.
+     * Shapes can re-order their children accordingly, so that the children of
+     * each leaf are contiguous in memory, and then call
+     * @ref adoptLeafOrder .
+     */
+    std::span<const int> leafOrder() const {
+        return m_hierarchy.primitiveIndices;
+    }
+    /// @brief Renumbers the children to match their order in the leaf nodes,
+    /// i.e., the i-th child in @ref leafOrder becomes child i.
+    void adoptLeafOrder() {
+        auto storage = std::make_shared<HierarchyStorage>(HierarchyStorage{
+            { m_hierarchy.nodes.begin(), m_hierarchy.nodes.end() },
+            std::vector<int>(m_hierarchy.primitiveIndices.size()) });
+        std::iota(storage->primitiveIndices.begin(),
+                  storage->primitiveIndices.end(), 0);
+        setHierarchy({ storage->nodes, storage->primitiveIndices, storage });
+    }
+
     /// @brief Builds the acceleration structure.
     void buildAccelerationStructure() {
         Timer buildTimer;
@@ -369,12 +469,18 @@ protected:
         logger(EInfo, "built BVH with %ld nodes for %ld primitives in %.1f ms",
                m_nodes.size(), numberOfPrimitives(),
                buildTimer.getElapsedTime() * 1000);
+
+        auto storage = std::make_shared<HierarchyStorage>(
+            HierarchyStorage{ std::move(m_nodes), std::move(m_primitiveIndices) });
+        m_nodes            = {};
+        m_primitiveIndices = {};
+        setHierarchy({ storage->nodes, storage->primitiveIndices, storage });
     }
 
 public:
     bool intersect(const Ray &ray, Intersection &its,
                    Sampler &rng) const override {
-        if (m_primitiveIndices.empty())
+        if (m_hierarchy.primitiveIndices.empty())
             return false; // exit early if no children exist
         if (intersectAABB(rootNode().aabb, ray) <
             its.t) // test root bounding box for potential hit
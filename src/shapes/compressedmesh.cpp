@@ -0,0 +1,160 @@
+#include "compressedmesh.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <limits>
+
+namespace lightwave {
+
+namespace {
+
+constexpr uint64_t PositionSteps = (uint64_t(1) << 21) - 1;
+
+/// @brief Converts a float to a half precision float, rounding to the nearest representable value.
+uint16_t floatToHalf(float value) {
+    const uint32_t bits = std::bit_cast<uint32_t>(value);
+    const uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+    const int exponent = int((bits >> 23) & 0xff) - 127 + 15;
+    uint32_t mantissa = bits & 0x7fffff;
+
+    if (((bits >> 23) & 0xff) == 0xff) // infinity or NaN
+        return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+    if (exponent >= 31) // too large, becomes infinity
+        return sign | 0x7c00;
+    if (exponent <= 0) {
+        // subnormal half precision numbers (or zero)
+        if (exponent < -10)
+            return sign;
+        mantissa |= 0x800000;
+        const int shift = 14 - exponent;
+        uint32_t half = mantissa >> shift;
+        const uint32_t remainder = mantissa & ((1u << shift) - 1);
+        const uint32_t halfway = 1u << (shift - 1);
+        if (remainder > halfway || (remainder == halfway && (half & 1)))
+            half++;
+        return sign | uint16_t(half);
+    }
+
+    uint32_t half = (uint32_t(exponent) << 10) | (mantissa >> 13);
+    const uint32_t remainder = mantissa & 0x1fff;
+    // rounding up may carry into the exponent, which yields the correct result
+    if (remainder > 0x1000 || (remainder == 0x1000 && (half & 1)))
+        half++;
+    return sign | uint16_t(half);
+}
+
+float halfToFloat(uint16_t half) {
+    const uint32_t sign = uint32_t(half & 0x8000) << 16;
+    const uint32_t exponent = (half >> 10) & 0x1f;
+    const uint32_t mantissa = half & 0x3ff;
+
+    if (exponent == 0) {
+        const float magnitude = std::ldexp(float(mantissa), -24);
+        return sign ? -magnitude : magnitude;
+    }
+    if (exponent == 31)
+        return std::bit_cast<float>(sign | 0x7f800000 | (mantissa << 13));
+    return std::bit_cast<float>(sign | ((exponent + 112) << 23) | (mantissa << 13));
+}
+
+uint32_t quantizeSigned(float value) {
+    return uint32_t(std::lround((std::clamp(value, -1.f, 1.f) + 1) * 0.5f * 65535));
+}
+
+float dequantizeSigned(uint32_t value) {
+    return float(value) / 65535 * 2 - 1;
+}
+
+/// @brief Maps a unit vector onto the octahedron, whose faces are unfolded onto the square [-1,1]^2.
+uint32_t encodeOctahedral(const Vector &normal) {
+    const float norm = std::abs(normal.x()) + std::abs(normal.y()) + std::abs(normal.z());
+    if (!(norm > 0))
+        return encodeOctahedral(Vector(0, 0, 1));
+
+    float x = normal.x() / norm;
+    float y = normal.y() / norm;
+    if (normal.z() < 0) {
+        const float foldedX = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+        const float foldedY = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = foldedX;
+        y = foldedY;
+    }
+    return quantizeSigned(x) | (quantizeSigned(y) << 16);
+}
+
+Vector decodeOctahedral(uint32_t bits) {
+    float x = dequantizeSigned(bits & 0xffff);
+    float y = dequantizeSigned(bits >> 16);
+    const float z = 1 - std::abs(x) - std::abs(y);
+    if (z < 0) {
+        const float unfoldedX = (1 - std::abs(y)) * (x >= 0 ? 1 : -1);
+        const float unfoldedY = (1 - std::abs(x)) * (y >= 0 ? 1 : -1);
+        x = unfoldedX;
+        y = unfoldedY;
+    }
+    return Vector(x, y, z).normalized();
+}
+
+}
+
+CompressedMesh::CompressedMesh(std::span<const Vector3i> triangles, std::span<const Point> positions,
+                               std::span<const Vector> normals, std::span<const Vector2> texcoords) {
+    Bounds bounds;
+    for (const Point &position : positions) {
+        bounds.extend(position);
+    }
+    m_origin = positions.empty() ? Point(0) : bounds.min();
+    const Vector extent = positions.empty() ? Vector(0) : bounds.diagonal();
+    m_scale = extent / float(PositionSteps);
+
+    m_vertices.reserve(positions.size());
+    for (size_t i = 0; i < positions.size(); i++) {
+        uint64_t position = 0;
+        for (int dim = 0; dim < 3; dim++) {
+            const float relative = extent[dim] > 0 ? (positions[i][dim] - m_origin[dim]) / extent[dim] : 0;
+            const uint64_t step = uint64_t(std::lround(std::clamp(relative, 0.f, 1.f) * float(PositionSteps)));
+            position |= std::min(step, PositionSteps) << (21 * dim);
+        }
+        m_vertices.push_back({
+            .position = position,
+            .normal = encodeOctahedral(normals[i]),
+            .texcoords = { floatToHalf(texcoords[i].x()), floatToHalf(texcoords[i].y()) },
+        });
+    }
+
+    const bool shortIndices = positions.size() <= size_t(std::numeric_limits<uint16_t>::max()) + 1;
+    if (shortIndices) {
+        m_indices16.reserve(3 * triangles.size());
+    } else {
+        m_indices32.reserve(3 * triangles.size());
+    }
+    for (const Vector3i &triangle : triangles) {
+        for (int corner = 0; corner < 3; corner++) {
+            if (shortIndices) {
+                m_indices16.push_back(uint16_t(triangle[corner]));
+            } else {
+                m_indices32.push_back(uint32_t(triangle[corner]));
+            }
+        }
+    }
+}
+
+int CompressedMesh::triangleCount() const {
+    return int((m_indices16.size() + m_indices32.size()) / 3);
+}
+
+size_t CompressedMesh::memoryUsage() const {
+    return m_vertices.size() * sizeof(CompressedVertex) + m_indices16.size() * sizeof(uint16_t) +
+           m_indices32.size() * sizeof(uint32_t);
+}
+
+Vertex CompressedMesh::vertex(int index) const {
+    const CompressedVertex &compressed = m_vertices[index];
+    return {
+        .position = position(index),
+        .texcoords = Vector2(halfToFloat(compressed.texcoords[0]), halfToFloat(compressed.texcoords[1])),
+        .normal = decodeOctahedral(compressed.normal),
+    };
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+
+#include <span>
+#include <vector>
+
+namespace lightwave {
+
+/**
+ * @brief A compact copy of the vertex and index buffers of a triangle mesh, which needs less than half of the memory.
+ * - Positions are quantized to 21 bits per component relative to the bounds of the mesh.
+ * - Normals are stored in an octahedral encoding with 16 bits per component.
+ * - Texture coordinates are stored with half precision.
+ * - Indices use 16 bits if the mesh has few enough vertices.
+ *
+ * Only positions are needed to find intersections, hence the remaining attributes are only decoded for the closest
+ * hit (see @ref Shape::computeSurfaceInteraction ).
+ */
+class CompressedMesh {
+    struct CompressedVertex {
+        /// @brief The quantized position, with 21 bits per component (x in the lowest bits).
+        uint64_t position;
+        /// @brief The octahedral encoding of the normal, with 16 bits per component.
+        uint32_t normal;
+        /// @brief The texture coordinates as half precision floats.
+        uint16_t texcoords[2];
+    };
+
+    Point m_origin;
+    /// @brief The extent of one quantization step along each axis.
+    Vector m_scale;
+    std::vector<CompressedVertex> m_vertices;
+    /// @brief The index buffer (three indices per triangle), of which only one is used depending on the vertex count.
+    std::vector<uint16_t> m_indices16;
+    std::vector<uint32_t> m_indices32;
+
+public:
+    CompressedMesh(std::span<const Vector3i> triangles, std::span<const Point> positions,
+                   std::span<const Vector> normals, std::span<const Vector2> texcoords);
+
+    int triangleCount() const;
+    int vertexCount() const { return int(m_vertices.size()); }
+    /// @brief The number of bytes used by the vertex and index buffers.
+    size_t memoryUsage() const;
+
+    /// @brief Returns the vertex indices of a triangle.
+    Vector3i triangle(int index) const {
+        const size_t first = 3 * size_t(index);
+        if (!m_indices16.empty())
+            return { m_indices16[first], m_indices16[first + 1], m_indices16[first + 2] };
+        return { int(m_indices32[first]), int(m_indices32[first + 1]), int(m_indices32[first + 2]) };
+    }
+
+    /// @brief Decodes the position of a vertex.
+    Point position(int index) const {
+        constexpr uint64_t Mask = (uint64_t(1) << 21) - 1;
+        const uint64_t bits = m_vertices[index].position;
+        return {
+            m_origin.x() + m_scale.x() * float(bits & Mask),
+            m_origin.y() + m_scale.y() * float((bits >> 21) & Mask),
+            m_origin.z() + m_scale.z() * float((bits >> 42) & Mask),
+        };
+    }
+
+    /// @brief Decodes all attributes of a vertex.
+    Vertex vertex(int index) const;
+};
+
+}
@@ -18,7 +18,14 @@ protected:
     }
 
     bool intersect(int primitiveIndex, const Ray &ray, Intersection &its, Sampler &rng) const override {
-        return m_children[primitiveIndex]->intersect(ray, its, rng);
+        // only instances report themselves, hence the instance of a previous hit is cleared so that a closer hit of a
+        // plain shape is not attributed to it
+        const Instance *previousInstance = its.instance;
+        its.instance = nullptr;
+        if (m_children[primitiveIndex]->intersect(ray, its, rng))
+            return true;
+        its.instance = previousInstance;
+        return false;
     }
 
     Bounds getBoundingBox(int primitiveIndex) const override {
@@ -39,6 +46,14 @@ public:
         for (auto &child : m_children) child->markAsVisible();
     }
 
+    void assignInstanceIndices(int &nextIndex) override {
+        for (auto &child : m_children) child->assignInstanceIndices(nextIndex);
+    }
+
+    void countAssetUses(std::unordered_map<const void *, int> &uses) const override {
+        for (auto &child : m_children) child->countAssetUses(uses);
+    }
+
     AreaSample sampleArea(Sampler &rng) const override {
         int childIndex = int(rng.next() * m_children.size());
         childIndex = std::min(childIndex, int(m_children.size()) - 1);
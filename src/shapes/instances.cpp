@@ -0,0 +1,295 @@
+#include <lightwave.hpp>
+
+#include "../core/mappedfile.hpp"
+#include "accel.hpp"
+
+#include <atomic>
+#include <cstring>
+
+namespace lightwave
+{
+
+    /**
+     * @brief Places many copies of a single prototype shape (e.g., vegetation or crowds), with transforms that are read
+     * from a binary file instead of one @c <instance> with its own @ref Transform per copy.
+     * The file consists of one affine transform (from prototype to scene coordinates) per copy, stored as the upper
+     * three rows of a 4x4 matrix in row-major order (i.e., twelve floats).
+     * Materials are assigned by wrapping this shape in an instance, hence the prototype needs to be a plain shape (such
+     * as a mesh or a group).
+     */
+    class Instances : public AccelerationStructure
+    {
+        /// @brief An affine transform stored as the upper three rows of a 4x4 matrix.
+        using Matrix3x4 = TMatrix<float, 3, 4>;
+        static_assert(sizeof(Matrix3x4) == 48);
+
+        /// @brief The shape that is placed by each copy.
+        ref<Shape> m_shape;
+        /**
+         * @brief The inverse transforms (from scene to prototype coordinates) of all copies, which are all that is
+         * needed for intersection tests. The forward transform is only computed for the closest hit.
+         * The copies are ordered like the leaves of the BVH.
+         */
+        std::vector<Matrix3x4> m_inverses;
+        /// @brief The bounding boxes of all copies, which are only kept while building the BVH.
+        std::vector<Bounds> m_bounds;
+        /// @brief The file the transforms were loaded from, for logging and debugging purposes.
+        std::filesystem::path m_originalPath;
+
+        static Matrix4x4 expand(const Matrix3x4 &matrix)
+        {
+            Matrix4x4 result = Matrix4x4::identity();
+            for (int row = 0; row < 3; row++)
+                for (int column = 0; column < 4; column++)
+                    result(row, column) = matrix(row, column);
+            return result;
+        }
+
+        static Matrix3x4 truncate(const Matrix4x4 &matrix)
+        {
+            Matrix3x4 result;
+            for (int row = 0; row < 3; row++)
+                for (int column = 0; column < 4; column++)
+                    result(row, column) = matrix(row, column);
+            return result;
+        }
+
+        static Point applyPoint(const Matrix3x4 &m, const Point &p)
+        {
+            return {
+                m(0, 0) * p.x() + m(0, 1) * p.y() + m(0, 2) * p.z() + m(0, 3),
+                m(1, 0) * p.x() + m(1, 1) * p.y() + m(1, 2) * p.z() + m(1, 3),
+                m(2, 0) * p.x() + m(2, 1) * p.y() + m(2, 2) * p.z() + m(2, 3),
+            };
+        }
+
+        static Vector applyVector(const Matrix3x4 &m, const Vector &v)
+        {
+            return {
+                m(0, 0) * v.x() + m(0, 1) * v.y() + m(0, 2) * v.z(),
+                m(1, 0) * v.x() + m(1, 1) * v.y() + m(1, 2) * v.z(),
+                m(2, 0) * v.x() + m(2, 1) * v.y() + m(2, 2) * v.z(),
+            };
+        }
+
+        /// @brief Transforms a ray into the coordinates of a copy, returning the factor by which distances change.
+        float toLocal(int placementIndex, const Ray &ray, Ray &localRay) const
+        {
+            const Matrix3x4 &inverse = m_inverses[placementIndex];
+            localRay = ray;
+            localRay.origin = applyPoint(inverse, ray.origin);
+            localRay.direction = applyVector(inverse, ray.direction);
+            const float scale = localRay.direction.length();
+            localRay.direction = localRay.direction / scale;
+            return scale;
+        }
+
+        /// @brief Transforms a surface from the coordinates of a copy to scene coordinates (see @ref Instance ).
+        void toScene(int placementIndex, SurfaceEvent &surf) const
+        {
+            const Matrix3x4 forward = truncate(invert(expand(m_inverses[placementIndex])).value());
+            const Vector tangent = applyVector(forward, surf.frame.tangent);
+            const Vector bitangent = applyVector(forward, surf.frame.bitangent);
+            // the area density changes by the factor the transform scales the surface element spanned by tangent and
+            // bitangent
+            const float areaScale = tangent.cross(bitangent).length();
+
+            surf.position = applyPoint(forward, surf.position);
+            surf.frame.tangent = tangent.normalized();
+            surf.frame.bitangent = (bitangent - surf.frame.tangent.dot(bitangent) * surf.frame.tangent).normalized();
+            // mirroring transforms change the handedness of the frame
+            if (forward.submatrix<3, 3>(0, 0).determinant() < 0)
+                surf.frame.bitangent = -surf.frame.bitangent;
+            surf.frame.normal = surf.frame.tangent.cross(surf.frame.bitangent).normalized();
+            surf.pdf /= areaScale;
+        }
+
+        /// @brief Reads the transforms of all copies, computing their inverses and bounding boxes.
+        void load()
+        {
+            logger(EInfo, "loading instances %s", m_originalPath);
+            const MappedFile file(m_originalPath);
+            constexpr size_t Stride = sizeof(Matrix3x4);
+            if (file.size() % Stride != 0)
+                lightwave_throw("%s does not consist of 3x4 matrices", m_originalPath);
+            if (file.size() / Stride > size_t(std::numeric_limits<int>::max()))
+                lightwave_throw("%s contains too many instances", m_originalPath);
+
+            const int count = int(file.size() / Stride);
+            const Bounds prototypeBounds = m_shape->getBoundingBox();
+            if (prototypeBounds.isUnbounded())
+                lightwave_throw("the prototype of instances needs to be bounded");
+
+            m_inverses.resize(count);
+            m_bounds.resize(count);
+            std::atomic<bool> invertible = true;
+            for_each_parallel(ChunkedRange(count, 16384), [&](Range chunk) {
+                for (int i : chunk)
+                {
+                    Matrix3x4 forward;
+                    std::memcpy(&forward, file.data() + size_t(i) * Stride, Stride);
+                    const auto inverse = invert(expand(forward));
+                    if (!inverse)
+                    {
+                        invertible = false;
+                        return;
+                    }
+                    m_inverses[i] = truncate(*inverse);
+
+                    Bounds bounds;
+                    for (int corner = 0; corner < 8; corner++)
+                    {
+                        Point p = prototypeBounds.min();
+                        for (int dim = 0; dim < p.Dimension; dim++)
+                        {
+                            if ((corner >> dim) & 1)
+                                p[dim] = prototypeBounds.max()[dim];
+                        }
+                        bounds.extend(applyPoint(forward, p));
+                    }
+                    m_bounds[i] = bounds;
+                }
+            });
+            if (!invertible)
+                lightwave_throw("%s contains transforms that cannot be inverted", m_originalPath);
+        }
+
+    protected:
+        int numberOfPrimitives() const override
+        {
+            return int(m_inverses.size());
+        }
+
+        bool intersect(int primitiveIndex, const Ray &ray, Intersection &its, Sampler &rng) const override
+        {
+            Ray localRay;
+            const float scale = toLocal(primitiveIndex, ray, localRay);
+            const float previousT = its.t;
+            const Shape *previousPlacedShape = its.placedShape;
+            const Instance *previousInstance = its.instance;
+            its.t *= scale;
+            its.placedShape = nullptr;
+            its.instance = nullptr;
+
+            if (!m_shape->intersect(localRay, its, rng))
+            {
+                its.t = previousT;
+                its.placedShape = previousPlacedShape;
+                its.instance = previousInstance;
+                return false;
+            }
+
+            if (its.instance)
+            {
+                // the prototype contains an <instance> whose transform is not known anymore once this hit is
+                // recorded, hence its surface is computed right away (in the coordinates of this copy), and the hit is
+                // attributed to whichever instance wraps these copies
+                its.instance->computeSurfaceInteraction(localRay, its);
+                its.instance = nullptr;
+                its.shape = nullptr;
+            }
+            else if (its.placedShape)
+            {
+                // the prototype contains instances itself, whose copy is not known anymore once this hit is recorded,
+                // hence the surface is computed right away (in the coordinates of this copy)
+                its.shape->computeSurfaceInteraction(localRay, its);
+                its.shape = nullptr;
+            }
+            // the transform is only applied to the surface of the closest hit
+            its.placedShape = its.shape;
+            its.shape = this;
+            its.placementIndex = primitiveIndex;
+            its.t /= scale;
+            return true;
+        }
+
+        Bounds getBoundingBox(int primitiveIndex) const override
+        {
+            return m_bounds[primitiveIndex];
+        }
+
+        Point getCentroid(int primitiveIndex) const override
+        {
+            return m_bounds[primitiveIndex].center();
+        }
+
+    public:
+        Instances(const Properties &properties)
+        {
+            m_originalPath = properties.get<std::filesystem::path>("filename");
+            m_shape = properties.getChild<Shape>();
+            if (dynamic_cast<const Instance *>(m_shape.get()))
+                lightwave_throw("the prototype of instances cannot be an instance (wrap the instances in one instead)");
+
+            load();
+            buildAccelerationStructure();
+
+            // store the transforms in the order of the BVH leaves, which keeps the copies of a leaf close in memory
+            std::vector<Matrix3x4> inverses(m_inverses.size());
+            const std::span<const int> order = leafOrder();
+            for (size_t i = 0; i < inverses.size(); i++)
+                inverses[i] = m_inverses[order[i]];
+            m_inverses = std::move(inverses);
+            adoptLeafOrder();
+            m_bounds = {};
+            logger(EInfo, "loaded %d instances", m_inverses.size());
+        }
+
+        void computeSurfaceInteraction(const Ray &ray, Intersection &its) const override
+        {
+            if (its.placedShape)
+            {
+                Ray localRay;
+                const float scale = toLocal(its.placementIndex, ray, localRay);
+                const float worldT = its.t;
+                its.t = worldT * scale;
+                its.placedShape->computeSurfaceInteraction(localRay, its);
+                its.t = worldT;
+            }
+            toScene(its.placementIndex, its);
+            // copies are picked uniformly by sampleArea
+            its.pdf /= numberOfPrimitives();
+        }
+
+        void markAsVisible() override
+        {
+            m_shape->markAsVisible();
+        }
+
+        void assignInstanceIndices(int &nextIndex) override
+        {
+            m_shape->assignInstanceIndices(nextIndex);
+        }
+
+        void countAssetUses(std::unordered_map<const void *, int> &uses) const override
+        {
+            m_shape->countAssetUses(uses);
+        }
+
+        AreaSample sampleArea(Sampler &rng) const override
+        {
+            const int count = numberOfPrimitives();
+            const int placementIndex = std::min(int(rng.next() * count), count - 1);
+            AreaSample sample = m_shape->sampleArea(rng);
+            toScene(placementIndex, sample);
+            sample.pdf /= count;
+            return sample;
+        }
+
+        std::string toString() const override
+        {
+            return tfm::format(
+                "Instances[\n"
+                "  count = %d,\n"
+                "  shape = %s,\n"
+                "  filename = \"%s\"\n"
+                "]",
+                m_inverses.size(),
+                indent(m_shape),
+                m_originalPath.generic_string());
+        }
+    };
+
+}
+
+REGISTER_SHAPE(Instances, "instances")
@@ -0,0 +1,65 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+
+#include <filesystem>
+
+namespace lightwave {
+
+/**
+ * @brief The sections of an ".lwmesh" file, which is the native mesh format of lightwave.
+ * Each section holds one buffer of the mesh in exactly the layout that @ref TriangleMesh uses in memory, so that a
+ * mesh can be memory mapped and rendered directly from the file without parsing or copying anything.
+ * Mapped files are backed by the page cache of the operating system, hence concurrent render processes that load the
+ * same file share its memory.
+ */
+enum class LwMeshSection : uint32_t {
+    Positions,     ///< one @c Point per vertex
+    Normals,       ///< one @c Vector per vertex
+    Texcoords,     ///< one @c Vector2 per vertex
+    Triangles,     ///< one @c Vector3i per triangle
+    BvhNodes,      ///< the nodes of the BVH (may be empty, in which case the BVH is built when loading)
+    BvhPrimitives, ///< the primitive indices referenced by the BVH leaves
+    Count,
+};
+
+/// @brief The location of a section within an ".lwmesh" file.
+struct LwMeshSectionEntry {
+    /// @brief The offset of the section from the start of the file, a multiple of @ref LwMeshHeader::Alignment .
+    uint64_t offset;
+    /// @brief The size of the section in bytes.
+    uint64_t size;
+};
+
+/**
+ * @brief The header at the start of an ".lwmesh" file.
+ * All values are stored in the byte order of the machine that wrote the file, which is detected by @c byteOrder .
+ * Files are not portable between builds with different BVH node layouts, which is detected by @c bvhNodeSize .
+ */
+struct LwMeshHeader {
+    static constexpr char Magic[8] = { 'L', 'W', 'M', 'E', 'S', 'H', '\0', '\0' };
+    static constexpr uint32_t CurrentVersion = 1;
+    static constexpr uint32_t ByteOrderMark  = 0x01020304;
+    /// @brief The alignment of all sections, which matches the size of a cache line.
+    static constexpr uint64_t Alignment = 64;
+
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint64_t vertexCount;
+    uint64_t triangleCount;
+    uint32_t bvhNodeSize;
+    uint32_t reserved;
+    LwMeshSectionEntry sections[size_t(LwMeshSection::Count)];
+
+    const LwMeshSectionEntry &section(LwMeshSection section) const { return sections[size_t(section)]; }
+    LwMeshSectionEntry &section(LwMeshSection section) { return sections[size_t(section)]; }
+};
+
+/**
+ * @brief Converts a PLY file into an ".lwmesh" file, including the BVH built for it.
+ * @note This is implemented alongside @ref TriangleMesh (in shapes/mesh.cpp), which also reads the format.
+ */
+void convertToLwMesh(const std::filesystem::path &input, const std::filesystem::path &output);
+
+}
@@ -1,11 +1,86 @@
 #include <lightwave.hpp>
 
+#include "../core/geometrypager.hpp"
+#include "../core/mappedfile.hpp"
 #include "../core/plyparser.hpp"
 #include "accel.hpp"
+#include "compressedmesh.hpp"
+#include "lwmesh.hpp"
+#include "simplify.hpp"
+
+#include <array>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <unordered_map>
 
 namespace lightwave
 {
 
+    /**
+     * @brief Intersects a ray with a single triangle (using the Möller-Trumbore algorithm).
+     * @param t Receives the distance of the hit along the ray.
+     * @param barycentrics Receives the barycentric coordinates of the hit with respect to the second and third vertex.
+     * @return @c true if the triangle is hit in front of the ray origin (the distance still needs to be compared against
+     * the closest hit so far).
+     */
+    static inline bool intersectTriangle(const Point &p0, const Point &p1, const Point &p2, const Ray &ray, float &t,
+                                         Vector2 &barycentrics)
+    {
+        // mullard trumbore
+        Vector v0 = (Vector)p0;
+        Vector v1 = (Vector)p1;
+        Vector v2 = (Vector)p2;
+
+        Vector edge1, edge2, T, P, Q;
+        // following scratchpixel
+        edge1 = v1 - v0;
+        edge2 = v2 - v0;
+        P = ray.direction.cross(edge2);
+        float det = P.dot(edge1);
+        // for mesh inside to pass, yes we need backward facing intersections as well
+        if (fabs(det) < 1e-8) // for this we need a different epsilon than the self intersection which is quite loose
+            return false;     // inputs from tut on 23/11
+        T = Vector(ray.origin) - v0;
+        Q = T.cross(edge1);
+
+        float denom = 1 / det;
+        float u = P.dot(T) * denom;
+        if (u < 0.f || u > 1.f)
+            return false;
+        float v = Q.dot(ray.direction) * denom;
+        if (v < 0.f || u + v > 1.f)
+            return false;
+
+        // Vector hitPoint = (1 - u - v) * v0 + u * v1 + v * v2;
+        t = Q.dot(edge2) * denom;
+        if (t < 1e-4f)
+        { // self intersection check
+            return false;
+        }
+        barycentrics = Vector2(u, v);
+        return true;
+    }
+
+    /// @brief Computes the surface of the closest hit on a triangle, given its vertices and whether to interpolate the
+    /// vertex normals (instead of using the geometric normal).
+    static inline void completeTriangle(const Vertex &A, const Vertex &B, const Vertex &C, bool smoothNormals,
+                                        const Ray &ray, Intersection &its)
+    {
+        its.position = ray(its.t);
+        const Vertex interpolated = Vertex::interpolate(its.barycentrics, A, B, C);
+        if (smoothNormals)
+        {
+            its.frame = Frame(interpolated.normal.normalized());
+        }
+        else
+        {
+            const Vector N = (B.position - A.position).cross(C.position - A.position);
+            its.frame = Frame(N.normalized());
+        }
+        its.uv = Point2(interpolated.texcoords);
+    }
+
     /**
      * @brief A shape consisting of many (potentially millions) of triangles, which share an index and vertex buffer.
      * Since individual triangles are rarely needed (and would pose an excessive amount of overhead), collections of
@@ -16,25 +91,417 @@ namespace lightwave
         /**
          * @brief The index buffer of the triangles.
          * The n-th element corresponds to the n-th triangle, and each component of the element corresponds to one
-         * vertex index (into @c m_vertices ) of the triangle.
+         * vertex index (into the vertex buffers) of the triangle.
          * This list will always contain as many elements as there are triangles.
          */
-        std::vector<Vector3i> m_triangles;
+        std::span<const Vector3i> m_triangles;
         /**
-         * @brief The vertex buffer of the triangles, indexed by m_triangles.
+         * @brief The vertex buffers of the triangles (one element per vertex each), indexed by m_triangles.
          * Note that multiple triangles can share vertices, hence there can also be fewer than @code 3 * numTriangles @endcode
          * vertices.
          */
-        std::vector<Vertex> m_vertices;
+        std::span<const Point> m_positions;
+        std::span<const Vector> m_normals;
+        std::span<const Vector2> m_texcoords;
+        /// @brief Keeps the memory referenced by the index and vertex buffers alive, which is either owned by a
+        /// @ref MeshBuffers object or a memory mapped ".lwmesh" file.
+        std::shared_ptr<const void> m_storage;
         /// @brief The file this mesh was loaded from, for logging and debugging purposes.
         std::filesystem::path m_originalPath;
-        /// @brief Whether to interpolate the normals from m_vertices, or report the geometric normal instead.
-        bool m_smoothNormals;
+        /// @brief Whether to interpolate the normals from the vertex buffer, or report the geometric normal instead.
+        bool m_smoothNormals = true;
+        /// @brief Whether the vertex and index buffers are stored in compressed form.
+        bool m_compress = false;
+        /// @brief The compressed vertex and index buffers, which replace the uncompressed buffers if compression
+        /// is enabled.
+        std::shared_ptr<const CompressedMesh> m_compressed;
+        /// @brief Tracks the use of the mapped ".lwmesh" file (if any), so that it can be released from memory when the
+        /// geometry exceeds its budget (see @ref GeometryPager ).
+        std::shared_ptr<GeometryPager::Region> m_paging;
+
+        /// @brief Index and vertex buffers that are read from a PLY file.
+        struct MeshBuffers
+        {
+            std::vector<Vector3i> triangles;
+            std::vector<Point> positions;
+            std::vector<Vector> normals;
+            std::vector<Vector2> texcoords;
+        };
+
+        /// @brief The geometry and BVH of a mesh file, which are shared by all meshes loaded from the file (the smooth
+        /// flag only affects shading, hence it does not need to be part of the key).
+        struct MeshAsset
+        {
+            std::span<const Vector3i> triangles;
+            std::span<const Point> positions;
+            std::span<const Vector> normals;
+            std::span<const Vector2> texcoords;
+            std::shared_ptr<const void> storage;
+            std::shared_ptr<const CompressedMesh> compressed;
+            std::shared_ptr<GeometryPager::Region> paging;
+            Hierarchy bvh;
+        };
+        /// @brief The geometry of this mesh, which is shared with all other meshes loaded from the same file.
+        std::shared_ptr<const MeshAsset> m_asset;
+
+        /// @brief The maximum number of simplified versions of a mesh.
+        static constexpr int MaxLevelsOfDetail = 8;
+        /// @brief The number of triangles below which meshes are not simplified any further.
+        static constexpr int MinLevelOfDetailTriangles = 64;
+        /// @brief The geometry and BVHs of the simplified versions of a mesh file, where level n (stored at index
+        /// n - 1) has a quarter of the triangles of level n - 1 (i.e., suffices when seen at half the size).
+        struct LevelsOfDetail
+        {
+            std::vector<MeshAsset> levels;
+        };
+        /// @brief The simplified versions of this mesh, which are generated on demand while the scene is loaded (see
+        /// @ref levelOfDetail ) and shared with all other meshes loaded from the same file.
+        mutable std::shared_ptr<const LevelsOfDetail> m_levelAssets;
+        /// @brief The meshes that use the simplified versions, which are created on demand.
+        mutable std::array<ref<Shape>, MaxLevelsOfDetail> m_levels;
+
+        /// @brief Returns the number of triangles that level of detail @c level aims for.
+        int levelTriangleCount(int level) const
+        {
+            return numberOfPrimitives() >> (2 * level);
+        }
+
+        /// @brief Returns the buffers and BVH of this mesh, so that they can be shared with other meshes.
+        MeshAsset asset() const
+        {
+            return MeshAsset{ m_triangles, m_positions, m_normals, m_texcoords, m_storage, m_compressed, m_paging,
+                              hierarchy() };
+        }
+
+        /// @brief Uses the buffers and BVH of a mesh that has been loaded before.
+        void adopt(std::shared_ptr<const MeshAsset> asset)
+        {
+            m_asset = std::move(asset);
+            m_triangles = m_asset->triangles;
+            m_positions = m_asset->positions;
+            m_normals = m_asset->normals;
+            m_texcoords = m_asset->texcoords;
+            m_storage = m_asset->storage;
+            m_compressed = m_asset->compressed;
+            m_paging = m_asset->paging;
+            setHierarchy(m_asset->bvh);
+        }
+
+        /// @brief Simplifies this mesh to all levels of detail (see @ref simplifyMesh ) and builds their BVHs.
+        LevelsOfDetail simplify() const
+        {
+            logger(EInfo, "simplifying mesh %s", m_originalPath);
+            std::vector<Vector3i> triangles(numberOfPrimitives());
+            std::vector<Vertex> vertices(vertexCount());
+            for (int i = 0; i < int(triangles.size()); i++)
+                triangles[i] = triangle(i);
+            for (int i = 0; i < int(vertices.size()); i++)
+                vertices[i] = vertex(i);
+
+            std::vector<int> targets;
+            for (int level = 1; level <= MaxLevelsOfDetail; level++)
+            {
+                if (levelTriangleCount(level) < MinLevelOfDetailTriangles)
+                    break;
+                targets.push_back(levelTriangleCount(level));
+            }
+
+            LevelsOfDetail result;
+            for (SimplifiedMesh &level : simplifyMesh(triangles, vertices, targets))
+            {
+                TriangleMesh simplified;
+                simplified.m_originalPath = m_originalPath;
+                simplified.setBuffers(std::move(level.triangles), level.vertices);
+                simplified.buildAccelerationStructure();
+                logger(EInfo, "simplified level of detail %d to %d triangles", result.levels.size() + 1,
+                       simplified.numberOfPrimitives());
+                result.levels.push_back(simplified.asset());
+            }
+            return result;
+        }
+
+        /// @brief Returns the simplified version of this mesh at the given level (starting at 1), generating the
+        /// levels if needed.
+        const ref<Shape> &level(int index) const
+        {
+            if (!m_levelAssets)
+                m_levelAssets = AssetCache::global().get<LevelsOfDetail>(m_originalPath, "lods", [&]()
+                                                                         { return simplify(); });
+            index = min(index, int(m_levelAssets->levels.size()));
+
+            ref<Shape> &level = m_levels[index - 1];
+            if (!level)
+            {
+                auto simplified = ref<TriangleMesh>(new TriangleMesh());
+                simplified->m_originalPath = m_originalPath;
+                simplified->m_smoothNormals = m_smoothNormals;
+                // the simplified mesh keeps all levels alive, which are only a fraction of the size of the full mesh
+                simplified->adopt({ m_levelAssets, &m_levelAssets->levels[index - 1] });
+                level = simplified;
+            }
+            return level;
+        }
+
+        /// @brief Uses the given index and vertex buffers, splitting the vertices into one buffer per attribute.
+        void setBuffers(std::vector<Vector3i> &&triangles, const std::vector<Vertex> &vertices)
+        {
+            auto buffers = std::make_shared<MeshBuffers>();
+            buffers->triangles = std::move(triangles);
+            buffers->positions.reserve(vertices.size());
+            buffers->normals.reserve(vertices.size());
+            buffers->texcoords.reserve(vertices.size());
+            for (const Vertex &vertex : vertices)
+            {
+                buffers->positions.push_back(vertex.position);
+                buffers->normals.push_back(vertex.normal);
+                buffers->texcoords.push_back(vertex.texcoords);
+            }
+
+            m_triangles = buffers->triangles;
+            m_positions = buffers->positions;
+            m_normals = buffers->normals;
+            m_texcoords = buffers->texcoords;
+            m_storage = std::move(buffers);
+        }
+
+        /// @brief Reads a PLY file.
+        void loadPly()
+        {
+            std::vector<Vector3i> triangles;
+            std::vector<Vertex> vertices;
+            readPLY(m_originalPath.string(), triangles, vertices);
+            setBuffers(std::move(triangles), vertices);
+        }
+
+        /// @brief Returns a section of a mapped ".lwmesh" file as a buffer, after checking that it is well formed.
+        template <typename T>
+        static std::span<const T> mappedSection(const MappedFile &file, const LwMeshHeader &header,
+                                                LwMeshSection section, size_t count)
+        {
+            static_assert(std::is_trivially_copyable_v<T>);
+            const LwMeshSectionEntry &entry = header.section(section);
+            if (entry.size != count * sizeof(T) || entry.offset % alignof(T) != 0 ||
+                entry.offset > file.size() || entry.size > file.size() - entry.offset)
+                lightwave_throw("section %d of the file is malformed", int(section));
+            return { reinterpret_cast<const T *>(file.data() + entry.offset), count };
+        }
+
+        /**
+         * @brief Maps an ".lwmesh" file and uses its buffers in place.
+         * @returns Whether the file contains a BVH that was adopted.
+         */
+        bool loadNative()
+        {
+            logger(EInfo, "mapping mesh %s", m_originalPath);
+            auto file = std::make_shared<const MappedFile>(m_originalPath);
+
+            LwMeshHeader header;
+            if (file->size() < sizeof(header))
+                lightwave_throw("%s is not a valid lwmesh file", m_originalPath);
+            std::memcpy(&header, file->data(), sizeof(header));
+            if (std::memcmp(header.magic, LwMeshHeader::Magic, sizeof(header.magic)) != 0)
+                lightwave_throw("%s is not a valid lwmesh file", m_originalPath);
+            if (header.byteOrder != LwMeshHeader::ByteOrderMark)
+                lightwave_throw("%s was written on a machine with a different byte order", m_originalPath);
+            if (header.version != LwMeshHeader::CurrentVersion)
+                lightwave_throw("%s has unsupported version %d (expected %d)", m_originalPath, header.version,
+                                LwMeshHeader::CurrentVersion);
+            if (header.vertexCount > uint64_t(std::numeric_limits<int>::max()) ||
+                header.triangleCount > uint64_t(std::numeric_limits<int>::max()))
+                lightwave_throw("%s has too many vertices or triangles", m_originalPath);
+
+            try
+            {
+                m_positions = mappedSection<Point>(*file, header, LwMeshSection::Positions, header.vertexCount);
+                m_normals = mappedSection<Vector>(*file, header, LwMeshSection::Normals, header.vertexCount);
+                m_texcoords = mappedSection<Vector2>(*file, header, LwMeshSection::Texcoords, header.vertexCount);
+                m_triangles = mappedSection<Vector3i>(*file, header, LwMeshSection::Triangles, header.triangleCount);
+            }
+            catch (...)
+            {
+                lightwave_throw_nested("while mapping %s", m_originalPath);
+            }
+            // the file is validated once, so that intersecting it never reads outside of the mapped buffers
+            const int vertexCount = int(header.vertexCount);
+            const auto isOutOfRange = [&](const Vector3i &triangle)
+            {
+                for (int corner = 0; corner < 3; corner++)
+                {
+                    if (triangle[corner] < 0 || triangle[corner] >= vertexCount)
+                        return true;
+                }
+                return false;
+            };
+            if (std::any_of(m_triangles.begin(), m_triangles.end(), isOutOfRange))
+                lightwave_throw("%s contains triangles that reference vertices out of range", m_originalPath);
+            const bool hasHierarchy = loadNativeHierarchy(file, header);
+
+            m_storage = file;
+            // validating has read most of the file, which is released again so that the pager only accounts for the
+            // parts of the geometry that rays reach
+            file->release();
+            m_paging = GeometryPager::global().add(file);
+            return hasHierarchy;
+        }
+
+        /// @brief Adopts the BVH stored in an ".lwmesh" file (if there is one that fits this build).
+        bool loadNativeHierarchy(const std::shared_ptr<const MappedFile> &file, const LwMeshHeader &header)
+        {
+            const size_t nodeBytes = header.section(LwMeshSection::BvhNodes).size;
+            if (nodeBytes == 0)
+                return false;
+            if (header.bvhNodeSize != sizeof(BvhNode))
+            {
+                logger(EWarn, "ignoring the BVH stored in %s, which was written with a different node layout",
+                       m_originalPath);
+                return false;
+            }
+            Hierarchy bvh;
+            try
+            {
+                bvh = {
+                    mappedSection<BvhNode>(*file, header, LwMeshSection::BvhNodes, nodeBytes / sizeof(BvhNode)),
+                    mappedSection<int>(*file, header, LwMeshSection::BvhPrimitives, header.triangleCount),
+                    file,
+                };
+            }
+            catch (...)
+            {
+                lightwave_throw_nested("while mapping %s", m_originalPath);
+            }
+            if (!isValidHierarchy(bvh))
+                lightwave_throw("%s contains a BVH that references nodes or triangles out of range", m_originalPath);
+            setHierarchy(std::move(bvh));
+            return true;
+        }
+
+        /// @brief Reads the mesh file and builds the BVH for it (unless it is stored in the file).
+        void load()
+        {
+            bool hasHierarchy = false;
+            if (m_originalPath.extension() == ".lwmesh")
+                hasHierarchy = loadNative();
+            else
+                loadPly();
+            logger(EInfo, "loaded mesh with %d triangles, %d vertices",
+                   m_triangles.size(),
+                   m_positions.size());
+            if (m_compress)
+            {
+                const size_t uncompressedSize = m_triangles.size_bytes() + m_positions.size_bytes() +
+                                                m_normals.size_bytes() + m_texcoords.size_bytes();
+                m_compressed = std::make_shared<CompressedMesh>(m_triangles, m_positions, m_normals, m_texcoords);
+                m_triangles = {};
+                m_positions = {};
+                m_normals = {};
+                m_texcoords = {};
+                m_storage = nullptr;
+                m_paging = nullptr;
+                logger(EInfo, "compressed mesh from %d KiB to %d KiB", uncompressedSize / 1024, m_compressed->memoryUsage() / 1024);
+                // the stored BVH does not account for quantized positions
+                hasHierarchy = false;
+            }
+            if (!hasHierarchy)
+                buildAccelerationStructure();
+        }
+
+        /// @brief Writes the buffers and BVH of this mesh to an ".lwmesh" file.
+        void save(const std::filesystem::path &path) const
+        {
+            if (m_compressed)
+                lightwave_throw("compressed meshes cannot be saved");
+
+            const auto align = [](uint64_t offset)
+            {
+                return (offset + LwMeshHeader::Alignment - 1) / LwMeshHeader::Alignment * LwMeshHeader::Alignment;
+            };
+
+            const Hierarchy &bvh = hierarchy();
+            const std::pair<LwMeshSection, std::span<const std::byte>> sections[] = {
+                { LwMeshSection::Positions, std::as_bytes(m_positions) },
+                { LwMeshSection::Normals, std::as_bytes(m_normals) },
+                { LwMeshSection::Texcoords, std::as_bytes(m_texcoords) },
+                { LwMeshSection::Triangles, std::as_bytes(m_triangles) },
+                { LwMeshSection::BvhNodes, std::as_bytes(bvh.nodes) },
+                { LwMeshSection::BvhPrimitives, std::as_bytes(bvh.primitiveIndices) },
+            };
+
+            LwMeshHeader header = {};
+            std::memcpy(header.magic, LwMeshHeader::Magic, sizeof(header.magic));
+            header.version = LwMeshHeader::CurrentVersion;
+            header.byteOrder = LwMeshHeader::ByteOrderMark;
+            header.vertexCount = m_positions.size();
+            header.triangleCount = m_triangles.size();
+            header.bvhNodeSize = sizeof(BvhNode);
+            uint64_t offset = align(sizeof(header));
+            for (const auto &[section, bytes] : sections)
+            {
+                header.section(section) = { offset, bytes.size() };
+                offset = align(offset + bytes.size());
+            }
+
+            std::ofstream file(path, std::ios::binary);
+            if (!file)
+                lightwave_throw("could not open %s for writing", path);
+            const auto write = [&](const void *data, size_t size, uint64_t end)
+            {
+                static const char padding[LwMeshHeader::Alignment] = {};
+                file.write(static_cast<const char *>(data), std::streamsize(size));
+                file.write(padding, std::streamsize(end - uint64_t(file.tellp())));
+            };
+            write(&header, sizeof(header), align(sizeof(header)));
+            for (const auto &[section, bytes] : sections)
+                write(bytes.data(), bytes.size(), align(header.section(section).offset + bytes.size()));
+            if (!file)
+                lightwave_throw("could not write %s", path);
+        }
+
+        /// @brief Creates an empty mesh, which is filled by the caller.
+        TriangleMesh() = default;
+
+        /// @brief Loads a PLY file with default settings, as used by @ref convertToLwMesh .
+        explicit TriangleMesh(const std::filesystem::path &filename)
+        {
+            m_originalPath = filename;
+            load();
+        }
+
+        friend void lightwave::convertToLwMesh(const std::filesystem::path &, const std::filesystem::path &);
+        friend class FlattenedGroup;
+
+        /// @brief Returns the vertex indices of a triangle.
+        Vector3i triangle(int primitiveIndex) const
+        {
+            return m_compressed ? m_compressed->triangle(primitiveIndex) : m_triangles[primitiveIndex];
+        }
+
+        /// @brief Returns the position of a vertex, which is all that is needed to test for intersections.
+        Point position(int vertexIndex) const
+        {
+            return m_compressed ? m_compressed->position(vertexIndex) : m_positions[vertexIndex];
+        }
+
+        /// @brief Returns all attributes of a vertex.
+        Vertex vertex(int vertexIndex) const
+        {
+            if (m_compressed)
+                return m_compressed->vertex(vertexIndex);
+            return {
+                .position = m_positions[vertexIndex],
+                .texcoords = m_texcoords[vertexIndex],
+                .normal = m_normals[vertexIndex],
+            };
+        }
+
+        int vertexCount() const
+        {
+            return m_compressed ? m_compressed->vertexCount() : int(m_positions.size());
+        }
 
     protected:
         int numberOfPrimitives() const override
         {
-            return int(m_triangles.size());
+            return m_compressed ? m_compressed->triangleCount() : int(m_triangles.size());
         }
 
         bool intersect(int primitiveIndex, const Ray &ray, Intersection &its, Sampler &rng) const override
@@ -42,118 +509,121 @@ namespace lightwave
 
             // hints:
             // * use m_triangles[primitiveIndex] to get the vertex indices of the triangle that should be intersected
-            // * if m_smoothNormals is true, interpolate the vertex normals from m_vertices
+            // * if m_smoothNormals is true, interpolate the vertex normals from m_normals
             //   * make sure that your shading frame stays orthonormal!
             // * if m_smoothNormals is false, use the geometrical normal (can be computed from the vertex positions)
 
-            // mullard trumbore
-            Vector3i triangle = m_triangles[primitiveIndex];
-            Vertex A = m_vertices[triangle[0]];
-            Vertex B = m_vertices[triangle[1]];
-            Vertex C = m_vertices[triangle[2]];
-
-            Vector v0 = (Vector)A.position;
-            Vector v1 = (Vector)B.position;
-            Vector v2 = (Vector)C.position;
-
-            Vector2 v0t = A.texcoords;
-            Vector2 v1t = B.texcoords;
-            Vector2 v2t = C.texcoords;
-
-            Vector edge1, edge2, T, P, Q;
-            // following scratchpixel
-            edge1 = v1 - v0;
-            edge2 = v2 - v0;
-            P = ray.direction.cross(edge2);
-            float det = P.dot(edge1);
-            Vector N = edge1.cross(edge2).normalized();
-            // for mesh inside to pass, yes we need backward facing intersections as well
-            if (fabs(det) < 1e-8) // for this we need a different epsilon than the self intersection which is quite loose
-                return false;     // inputs from tut on 23/11
-            T = Vector(ray.origin) - v0;
-            Q = T.cross(edge1);
-
-            float denom = 1 / det;
-            float u = P.dot(T) * denom;
-            if (u < 0.f || u > 1.f)
+            const Vector3i indices = triangle(primitiveIndex);
+            float t;
+            Vector2 barycentrics;
+            if (!intersectTriangle(position(indices[0]), position(indices[1]), position(indices[2]), ray, t,
+                                   barycentrics))
                 return false;
-            float v = Q.dot(ray.direction) * denom;
-            if (v < 0.f || u + v > 1.f)
-                return false;
-
-            // Vector hitPoint = (1 - u - v) * v0 + u * v1 + v * v2;
-            float t = Q.dot(edge2) * denom;
 
             // we take the closest t, and if the ray intersects a triangle behind the one we just did, then its
             // not visible to the camera
-            if (t < 1e-4f)
-            { // self intersection check
-                return false;
-            }
             if (t > its.t)
             {
                 return false;
             }
             if (its.alphaMasking)
             {
-                Point2 uv = Point2((1 - u - v) * v0t + u * v1t + v * v2t);
+                const float u = barycentrics.x();
+                const float v = barycentrics.y();
+                Point2 uv = Point2((1 - u - v) * vertex(indices[0]).texcoords + u * vertex(indices[1]).texcoords + v * vertex(indices[2]).texcoords);
                 if (its.alphaMasking->scalar(uv) < rng.next())
                 {
                     return false;
                 }
             }
+            // the shading frame and texture coordinates are only computed for the closest hit
             its.t = t;
-            its.position = ray(its.t);
-            // populate(its, ray(its.t));
-            Vector2 bary{u, v};
-            if (m_smoothNormals == true)
-            {
-                Vertex barycentric_normal = Vertex::interpolate(bary, A, B, C);
-                its.frame.normal = barycentric_normal.normal.normalized();
-                its.frame = Frame(its.frame.normal);
-            }
-            else
-            {
-                its.frame.normal = N.normalized();
-                its.frame = Frame(its.frame.normal);
-            }
-            its.uv = Point2((1 - u - v) * v0t + u * v1t + v * v2t);
-
+            its.shape = this;
+            its.primitiveIndex = primitiveIndex;
+            its.barycentrics = barycentrics;
             return true;
         }
 
         Bounds getBoundingBox(int primitiveIndex) const override
         {
             // m_vertices.at(0)
-            Vector3i triangle = m_triangles[primitiveIndex];
-            Vertex v1 = m_vertices[triangle[0]];
-            Vertex v2 = m_vertices[triangle[1]];
-            Vertex v3 = m_vertices[triangle[2]];
+            const Vector3i indices = triangle(primitiveIndex);
+            Point v1 = position(indices[0]);
+            Point v2 = position(indices[1]);
+            Point v3 = position(indices[2]);
 
-            Point b0 = elementwiseMin(elementwiseMin(v1.position, v2.position), v3.position);
-            Point b1 = elementwiseMax(elementwiseMax(v1.position, v2.position), v3.position);
+            Point b0 = elementwiseMin(elementwiseMin(v1, v2), v3);
+            Point b1 = elementwiseMax(elementwiseMax(v1, v2), v3);
             return Bounds(b0, b1);
         }
 
         Point getCentroid(int primitiveIndex) const override
         {
-            Vector3i triangle = m_triangles[primitiveIndex];
-            Vector v1 = (Vector)m_vertices[triangle[0]].position;
-            Vector v2 = (Vector)m_vertices[triangle[1]].position;
-            Vector v3 = (Vector)m_vertices[triangle[2]].position;
+            const Vector3i indices = triangle(primitiveIndex);
+            Vector v1 = (Vector)position(indices[0]);
+            Vector v2 = (Vector)position(indices[1]);
+            Vector v3 = (Vector)position(indices[2]);
             return Vector((v1 + v2 + v3) * 0.3333f);
         }
 
     public:
+        void computeSurfaceInteraction(const Ray &ray, Intersection &its) const override
+        {
+            const Vector3i indices = triangle(its.primitiveIndex);
+            completeTriangle(vertex(indices[0]), vertex(indices[1]), vertex(indices[2]), m_smoothNormals, ray, its);
+        }
+
         TriangleMesh(const Properties &properties)
         {
             m_originalPath = properties.get<std::filesystem::path>("filename");
             m_smoothNormals = properties.get<bool>("smooth", true);
-            readPLY(m_originalPath.string(), m_triangles, m_vertices);
-            logger(EInfo, "loaded ply with %d triangles, %d vertices",
-                   m_triangles.size(),
-                   m_vertices.size());
-            buildAccelerationStructure();
+            m_compress = properties.get<bool>("compress", false);
+
+            // meshes are shared by all shapes that reference the same file (as long as they are in use), and cached
+            // when rendering in batch mode
+            bool loaded = false;
+            auto shared = AssetCache::global().get<MeshAsset>(m_originalPath, m_compress ? "compressed" : "", [&]()
+                                                              {
+                load();
+                loaded = true;
+                return asset(); });
+            if (loaded)
+            {
+                m_asset = std::move(shared);
+            }
+            else
+            {
+                adopt(std::move(shared));
+                logger(EInfo, "sharing mesh %s with %d triangles", m_originalPath, numberOfPrimitives());
+            }
+        }
+
+        bool intersect(const Ray &ray, Intersection &its, Sampler &rng) const override
+        {
+            if (m_paging)
+                m_paging->touch();
+            return AccelerationStructure::intersect(ray, its, rng);
+        }
+
+        void countAssetUses(std::unordered_map<const void *, int> &uses) const override
+        {
+            uses[m_asset.get()]++;
+        }
+
+        ref<Shape> levelOfDetail(float pixelArea) const override
+        {
+            // the coarsest level that still has at least one triangle per pixel (scaled by the quality) is used
+            int index = 0;
+            while (index < MaxLevelsOfDetail)
+            {
+                const int triangles = levelTriangleCount(index + 1);
+                if (triangles < pixelArea || triangles < MinLevelOfDetailTriangles)
+                    break;
+                index++;
+            }
+            if (index == 0)
+                return nullptr;
+            return level(index);
         }
 
         AreaSample sampleArea(Sampler &rng) const override{
@@ -166,14 +636,271 @@ namespace lightwave
                 "Mesh[\n"
                 "  vertices = %d,\n"
                 "  triangles = %d,\n"
+                "  compressed = %s,\n"
                 "  filename = \"%s\"\n"
                 "]",
-                m_vertices.size(),
-                m_triangles.size(),
+                vertexCount(),
+                numberOfPrimitives(),
+                m_compressed != nullptr,
                 m_originalPath.generic_string());
         }
     };
 
+    /**
+     * @brief The union of the shapes of a scene (like a group), in which meshes that are only used by a single instance
+     * are baked into world coordinates. Their triangles share one BVH with all remaining shapes, which saves the
+     * transform and the separate BVH that every instance would otherwise traverse.
+     * Meshes that are used by several instances (including meshes loaded from the same file) remain instanced, as
+     * baking them would duplicate their geometry.
+     * @note This is used by @ref Scene if flattening is enabled, and implemented alongside @ref TriangleMesh since it
+     * reads the buffers of meshes.
+     */
+    class FlattenedGroup final : public AccelerationStructure
+    {
+        /// @brief The shapes that have not been flattened, which are the first primitives of the BVH.
+        std::vector<ref<Shape>> m_children;
+        /// @brief The instances whose meshes have been flattened, which still provide the materials of their
+        /// triangles.
+        std::vector<ref<Instance>> m_instances;
+        /// @brief Whether the triangles of each flattened instance interpolate their vertex normals.
+        std::vector<bool> m_smoothNormals;
+
+        /// @brief The index and vertex buffers of all flattened triangles (in world coordinates), which are the
+        /// primitives of the BVH that follow the children.
+        std::vector<Vector3i> m_triangles;
+        std::vector<Point> m_positions;
+        std::vector<Vector> m_normals;
+        std::vector<Vector2> m_texcoords;
+        /// @brief The index (into m_instances) of the instance each flattened triangle belongs to.
+        std::vector<int> m_owners;
+        /// @brief The index of the first flattened triangle of each flattened instance (followed by the total number
+        /// of flattened triangles), since the triangles of an instance are stored contiguously.
+        std::vector<int> m_firstTriangles;
+
+        /// @brief Appends the triangles of a mesh to the flattened buffers, transformed into world coordinates.
+        void bake(const TriangleMesh &mesh, const Transform *transform, int owner)
+        {
+            const int vertexOffset = int(m_positions.size());
+            for (int i = 0; i < mesh.vertexCount(); i++)
+            {
+                const Vertex vertex = mesh.vertex(i);
+                // normals are not renormalized, since interpolating them before or after the transform is equivalent
+                m_positions.push_back(transform ? transform->apply(vertex.position) : vertex.position);
+                m_normals.push_back(transform ? transform->adj(vertex.normal) : vertex.normal);
+                m_texcoords.push_back(vertex.texcoords);
+            }
+
+            // mirroring transforms flip the geometric normal, which instances correct for (see @ref Instance )
+            const bool mirrored = transform && transform->determinant() < 0;
+            for (int i = 0; i < mesh.numberOfPrimitives(); i++)
+            {
+                const Vector3i indices = mesh.triangle(i);
+                m_triangles.push_back(mirrored ? Vector3i(indices[0], indices[2], indices[1]) + Vector3i(vertexOffset)
+                                               : indices + Vector3i(vertexOffset));
+                m_owners.push_back(owner);
+            }
+        }
+
+        Vertex vertex(int vertexIndex) const
+        {
+            return {
+                .position = m_positions[vertexIndex],
+                .texcoords = m_texcoords[vertexIndex],
+                .normal = m_normals[vertexIndex],
+            };
+        }
+
+    protected:
+        int numberOfPrimitives() const override
+        {
+            return int(m_children.size() + m_triangles.size());
+        }
+
+        bool intersect(int primitiveIndex, const Ray &ray, Intersection &its, Sampler &rng) const override
+        {
+            if (primitiveIndex < int(m_children.size()))
+                return m_children[primitiveIndex]->intersect(ray, its, rng);
+
+            // flattened instances use no alpha masks, hence no masks of previously visited instances apply either
+            const int triangleIndex = primitiveIndex - int(m_children.size());
+            const Vector3i indices = m_triangles[triangleIndex];
+            float t;
+            Vector2 barycentrics;
+            if (!intersectTriangle(m_positions[indices[0]], m_positions[indices[1]], m_positions[indices[2]], ray, t,
+                                   barycentrics))
+                return false;
+            if (t > its.t)
+                return false;
+
+            // the hit is reported like a hit of the original instance, which completes it through this shape
+            its.t = t;
+            its.shape = this;
+            its.instance = m_instances[m_owners[triangleIndex]].get();
+            its.primitiveIndex = triangleIndex;
+            its.barycentrics = barycentrics;
+            return true;
+        }
+
+        Bounds getBoundingBox(int primitiveIndex) const override
+        {
+            if (primitiveIndex < int(m_children.size()))
+                return m_children[primitiveIndex]->getBoundingBox();
+
+            const Vector3i indices = m_triangles[primitiveIndex - m_children.size()];
+            const Point &v1 = m_positions[indices[0]];
+            const Point &v2 = m_positions[indices[1]];
+            const Point &v3 = m_positions[indices[2]];
+            return Bounds(elementwiseMin(elementwiseMin(v1, v2), v3), elementwiseMax(elementwiseMax(v1, v2), v3));
+        }
+
+        Point getCentroid(int primitiveIndex) const override
+        {
+            if (primitiveIndex < int(m_children.size()))
+                return m_children[primitiveIndex]->getCentroid();
+
+            const Vector3i indices = m_triangles[primitiveIndex - m_children.size()];
+            return Vector((Vector(m_positions[indices[0]]) + Vector(m_positions[indices[1]]) +
+                           Vector(m_positions[indices[2]])) / 3);
+        }
+
+    public:
+        FlattenedGroup(const Properties &properties)
+        {
+            const std::vector<ref<Shape>> children = properties.getChildren<Shape>();
+            const auto flattenableMesh = [](const ref<Shape> &child) -> const TriangleMesh *
+            {
+                const Instance *instance = dynamic_cast<const Instance *>(child.get());
+                return instance ? dynamic_cast<const TriangleMesh *>(instance->shape()) : nullptr;
+            };
+
+            // meshes loaded from the same file share their geometry, hence uses are counted per file (including
+            // the uses within groups and the prototypes of instance sets, which cannot be flattened themselves)
+            std::unordered_map<const void *, int> uses;
+            for (const auto &child : children)
+                child->countAssetUses(uses);
+
+            for (const auto &child : children)
+            {
+                const auto instance = std::dynamic_pointer_cast<Instance>(child);
+                const TriangleMesh *mesh = flattenableMesh(child);
+                if (!mesh || !instance->isFlattenable() || uses[mesh->m_asset.get()] > 1)
+                {
+                    m_children.push_back(child);
+                    continue;
+                }
+                if (m_triangles.size() + mesh->numberOfPrimitives() + children.size() >
+                    size_t(std::numeric_limits<int>::max()))
+                    lightwave_throw("the scene contains too many triangles to be flattened");
+
+                m_firstTriangles.push_back(int(m_triangles.size()));
+                bake(*mesh, instance->transform(), int(m_instances.size()));
+                m_smoothNormals.push_back(mesh->m_smoothNormals);
+                m_instances.push_back(instance);
+                instance->flatten();
+            }
+
+            m_firstTriangles.push_back(int(m_triangles.size()));
+
+            logger(EInfo, "flattened %d of %d shapes into %d triangles", m_instances.size(), children.size(),
+                   m_triangles.size());
+            buildAccelerationStructure();
+        }
+
+        void computeSurfaceInteraction(const Ray &ray, Intersection &its) const override
+        {
+            const Vector3i indices = m_triangles[its.primitiveIndex];
+            completeTriangle(vertex(indices[0]), vertex(indices[1]), vertex(indices[2]),
+                             m_smoothNormals[m_owners[its.primitiveIndex]], ray, its);
+        }
+
+        void markAsVisible() override
+        {
+            for (auto &child : m_children)
+                child->markAsVisible();
+            for (auto &instance : m_instances)
+                instance->markAsVisible();
+        }
+
+        void assignInstanceIndices(int &nextIndex) override
+        {
+            for (auto &child : m_children)
+                child->assignInstanceIndices(nextIndex);
+            for (auto &instance : m_instances)
+                instance->assignInstanceIndices(nextIndex);
+        }
+
+        void countAssetUses(std::unordered_map<const void *, int> &uses) const override
+        {
+            // flattened instances own copies of their geometry
+            for (auto &child : m_children)
+                child->countAssetUses(uses);
+        }
+
+        AreaSample sampleArea(Sampler &rng) const override
+        {
+            // like a group, each child and each flattened instance is chosen with equal probability
+            const int count = int(m_children.size() + m_instances.size());
+            if (count == 0)
+                return AreaSample::invalid();
+            const int entityIndex = std::min(int(rng.next() * count), count - 1);
+            if (entityIndex < int(m_children.size()))
+            {
+                AreaSample sample = m_children[entityIndex]->sampleArea(rng);
+                sample.pdf /= count;
+                return sample;
+            }
+
+            // the flattened triangles are in world coordinates already, and are chosen uniformly within their instance
+            const int owner = entityIndex - int(m_children.size());
+            const int first = m_firstTriangles[owner];
+            const int triangleCount = m_firstTriangles[owner + 1] - first;
+            if (triangleCount == 0)
+                return AreaSample::invalid();
+            const int triangleIndex = first + std::min(int(rng.next() * triangleCount), triangleCount - 1);
+
+            Point2 barycentrics = rng.next2D();
+            if (barycentrics.x() + barycentrics.y() > 1)
+                barycentrics = Point2(1 - barycentrics.x(), 1 - barycentrics.y());
+
+            const Vector3i indices = m_triangles[triangleIndex];
+            const Vertex A = vertex(indices[0]), B = vertex(indices[1]), C = vertex(indices[2]);
+            const Vector N = (B.position - A.position).cross(C.position - A.position);
+            const float area = N.length() / 2;
+            if (area <= 0)
+                return AreaSample::invalid();
+
+            const Vertex interpolated = Vertex::interpolate(Vector2(barycentrics), A, B, C);
+            AreaSample sample;
+            sample.position = interpolated.position;
+            sample.frame = Frame(m_smoothNormals[owner] ? interpolated.normal.normalized() : N.normalized());
+            sample.uv = Point2(interpolated.texcoords);
+            sample.pdf = 1 / (area * triangleCount * count);
+            return sample;
+        }
+
+        std::string toString() const override
+        {
+            std::stringstream oss;
+            oss << "FlattenedGroup[" << std::endl;
+            oss << "  flattened instances = " << m_instances.size() << "," << std::endl;
+            oss << "  flattened triangles = " << m_triangles.size() << "," << std::endl;
+            for (auto &entity : m_children)
+            {
+                oss << "  " << indent(entity) << "," << std::endl;
+            }
+            oss << "]";
+            return oss.str();
+        }
+    };
+
+    void convertToLwMesh(const std::filesystem::path &input, const std::filesystem::path &output)
+    {
+        const TriangleMesh mesh{input};
+        mesh.save(output);
+        logger(EInfo, "wrote %s", output);
+    }
+
 }
 
 REGISTER_SHAPE(TriangleMesh, "mesh")
+REGISTER_SHAPE(FlattenedGroup, "flattened")
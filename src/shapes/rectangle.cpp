@@ -55,10 +55,14 @@ public:
         // if (its.alphaMasking->scalar(uv) < 0.5){return false;}
         // we have determined there was an intersection! we are now free to change the intersection object and return true.
         its.t = t;
-        populate(its, position); // compute the shading frame, texture coordinates and area pdf (same as sampleArea)
+        its.shape = this;
         return true;
     }
 
+    void computeSurfaceInteraction(const Ray &ray, Intersection &its) const override {
+        populate(its, ray(its.t)); // compute the shading frame, texture coordinates and area pdf (same as sampleArea)
+    }
+
     Bounds getBoundingBox() const override {
         return Bounds(Point { -1, -1, 0 }, Point { +1, +1, 0 });
     }
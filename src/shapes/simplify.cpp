@@ -0,0 +1,310 @@
+#include "simplify.hpp"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+#include <queue>
+#include <unordered_map>
+
+namespace lightwave {
+
+namespace {
+
+/// @brief How much more moving away from an open boundary costs compared to moving away from the surface.
+constexpr double BoundaryWeight = 1000;
+/// @brief The minimum cosine between the normals of a triangle before and after a collapse.
+constexpr float MinNormalCosine = 0.2f;
+
+/**
+ * @brief Measures the sum of squared distances of a point to a set of (weighted) planes, stored as the upper triangle
+ * of a symmetric 4x4 matrix. Quadrics are computed in double precision, as their entries span many magnitudes.
+ */
+struct Quadric {
+    /// @brief The entries aa, ab, ac, ad, bb, bc, bd, cc, cd, dd of the matrix.
+    std::array<double, 10> m {};
+
+    /// @brief The quadric of the plane with the given unit normal passing through the given point.
+    static Quadric plane(const Vector &normal, const Point &point, double weight) {
+        const double a = normal.x(), b = normal.y(), c = normal.z();
+        const double d = -(a * point.x() + b * point.y() + c * point.z());
+        Quadric q;
+        q.m = { a * a, a * b, a * c, a * d, b * b, b * c, b * d, c * c, c * d, d * d };
+        for (double &entry : q.m)
+            entry *= weight;
+        return q;
+    }
+
+    Quadric &operator+=(const Quadric &other) {
+        for (size_t i = 0; i < m.size(); i++)
+            m[i] += other.m[i];
+        return *this;
+    }
+
+    /// @brief Returns the weighted sum of squared distances of the point to the planes.
+    double error(const Point &p) const {
+        const double x = p.x(), y = p.y(), z = p.z();
+        return m[0] * x * x + 2 * m[1] * x * y + 2 * m[2] * x * z + 2 * m[3] * x + m[4] * y * y +
+               2 * m[5] * y * z + 2 * m[6] * y + m[7] * z * z + 2 * m[8] * z + m[9];
+    }
+
+    /// @brief Finds the point with the smallest error, which fails if it is not unique (e.g., on flat surfaces).
+    bool minimize(Point &result) const {
+        // solves the linear system given by the upper 3x3 block using Cramer's rule
+        const double a = m[0], b = m[1], c = m[2], e = m[4], f = m[5], i = m[7];
+        const double det = a * (e * i - f * f) - b * (b * i - f * c) + c * (b * f - e * c);
+        const double trace = a + e + i;
+        if (std::abs(det) <= 1e-9 * trace * trace * trace)
+            return false;
+
+        const double rx = -m[3], ry = -m[6], rz = -m[8];
+        const double x = (rx * (e * i - f * f) - b * (ry * i - f * rz) + c * (ry * f - e * rz)) / det;
+        const double y = (a * (ry * i - rz * f) - rx * (b * i - f * c) + c * (b * rz - ry * c)) / det;
+        const double z = (a * (e * rz - f * ry) - b * (b * rz - ry * c) + rx * (b * f - e * c)) / det;
+        result = Point(float(x), float(y), float(z));
+        return true;
+    }
+};
+
+/// @brief A candidate edge collapse, which is valid as long as neither vertex has changed since it was computed.
+struct Collapse {
+    double cost;
+    int keep;
+    int remove;
+    int keepVersion;
+    int removeVersion;
+    Point target;
+
+    bool operator>(const Collapse &other) const { return cost > other.cost; }
+};
+
+uint64_t edgeKey(int a, int b) {
+    return (uint64_t(uint32_t(min(a, b))) << 32) | uint32_t(max(a, b));
+}
+
+class Simplifier {
+    std::vector<Vector3i> m_triangles;
+    std::vector<Vertex> m_vertices;
+
+    std::vector<Quadric> m_quadrics;
+    /// @brief The triangles adjacent to each vertex (which can contain triangles that have been removed since).
+    std::vector<std::vector<int>> m_adjacency;
+    std::vector<bool> m_triangleRemoved;
+    std::vector<bool> m_vertexRemoved;
+    /// @brief Incremented whenever a vertex changes, which invalidates all collapses computed for it.
+    std::vector<int> m_versions;
+    std::priority_queue<Collapse, std::vector<Collapse>, std::greater<>> m_queue;
+    int m_triangleCount;
+
+    /// @brief Computes the (area weighted) normal of a triangle, with one vertex optionally moved elsewhere.
+    Vector normal(int triangle, int movedVertex = -1, const Point &movedTo = Point()) const {
+        Point p[3];
+        for (int corner = 0; corner < 3; corner++) {
+            const int vertex = m_triangles[triangle][corner];
+            p[corner] = vertex == movedVertex ? movedTo : m_vertices[vertex].position;
+        }
+        return (p[1] - p[0]).cross(p[2] - p[0]);
+    }
+
+    /// @brief Computes the quadrics of all vertices, and enqueues the collapses of all edges.
+    void initialize() {
+        m_quadrics.assign(m_vertices.size(), Quadric());
+        std::unordered_map<uint64_t, std::pair<int, int>> edges; // edge -> (number of triangles, last triangle)
+        for (int t = 0; t < int(m_triangles.size()); t++) {
+            const Vector n = normal(t);
+            const float length = n.length();
+            if (length == 0)
+                continue;
+            const Quadric q = Quadric::plane(n / length, m_vertices[m_triangles[t][0]].position, length / 2);
+            for (int corner = 0; corner < 3; corner++) {
+                m_quadrics[m_triangles[t][corner]] += q;
+                auto &edge = edges[edgeKey(m_triangles[t][corner], m_triangles[t][(corner + 1) % 3])];
+                edge.first++;
+                edge.second = t;
+            }
+        }
+
+        // edges with only one adjacent triangle lie on a boundary, which is preserved by a plane perpendicular to the
+        // triangle that contains the edge
+        for (const auto &[key, edge] : edges) {
+            if (edge.first != 1)
+                continue;
+            const int a = int(key >> 32), b = int(key & 0xffffffff);
+            const Vector along = m_vertices[b].position - m_vertices[a].position;
+            const Vector perpendicular = along.cross(normal(edge.second));
+            const float length = perpendicular.length();
+            if (length == 0)
+                continue;
+            const Quadric q = Quadric::plane(
+                perpendicular / length, m_vertices[a].position, BoundaryWeight * along.lengthSquared());
+            m_quadrics[a] += q;
+            m_quadrics[b] += q;
+        }
+
+        for (const auto &[key, edge] : edges)
+            enqueue(int(key >> 32), int(key & 0xffffffff));
+    }
+
+    void enqueue(int keep, int remove) {
+        const Point &a = m_vertices[keep].position;
+        const Point &b = m_vertices[remove].position;
+        Quadric q = m_quadrics[keep];
+        q += m_quadrics[remove];
+
+        Collapse collapse { 0, keep, remove, m_versions[keep], m_versions[remove], a };
+        // the optimal point is only used if it stays close to the edge, as it is unstable for nearly flat surfaces
+        Point optimum;
+        const float edgeLength = (b - a).length();
+        if (q.minimize(optimum) && (optimum - (a + (b - a) / 2)).length() <= edgeLength) {
+            collapse.target = optimum;
+            collapse.cost = q.error(optimum);
+        } else {
+            collapse.cost = std::numeric_limits<double>::infinity();
+            for (const Point &candidate : { a, b, a + (b - a) / 2 }) {
+                const double error = q.error(candidate);
+                if (error < collapse.cost) {
+                    collapse.cost = error;
+                    collapse.target = candidate;
+                }
+            }
+        }
+        m_queue.push(collapse);
+    }
+
+    /// @brief Checks that no triangle that remains after collapsing an edge is flipped or degenerates.
+    bool preservesOrientation(int vertex, int other, const Point &target) const {
+        for (int t : m_adjacency[vertex]) {
+            if (m_triangleRemoved[t])
+                continue;
+            const Vector3i &indices = m_triangles[t];
+            if (indices[0] == other || indices[1] == other || indices[2] == other)
+                continue; // removed by the collapse
+            const Vector before = normal(t);
+            const Vector after = normal(t, vertex, target);
+            const float lengths = before.length() * after.length();
+            if (lengths == 0 || before.dot(after) < MinNormalCosine * lengths)
+                return false;
+        }
+        return true;
+    }
+
+    void collapse(const Collapse &collapse) {
+        const int keep = collapse.keep;
+        const int remove = collapse.remove;
+
+        for (int t : m_adjacency[remove]) {
+            if (m_triangleRemoved[t])
+                continue;
+            Vector3i &indices = m_triangles[t];
+            if (indices[0] == keep || indices[1] == keep || indices[2] == keep) {
+                m_triangleRemoved[t] = true;
+                m_triangleCount--;
+                continue;
+            }
+            for (int corner = 0; corner < 3; corner++) {
+                if (indices[corner] == remove)
+                    indices[corner] = keep;
+            }
+            m_adjacency[keep].push_back(t);
+        }
+        std::erase_if(m_adjacency[keep], [&](int t) { return m_triangleRemoved[t]; });
+        m_adjacency[remove] = {};
+
+        // the attributes are interpolated at the position of the target along the edge
+        Vertex &kept = m_vertices[keep];
+        const Vertex &removed = m_vertices[remove];
+        const Vector edge = removed.position - kept.position;
+        const float weight = edge.lengthSquared() > 0
+                                 ? saturate((collapse.target - kept.position).dot(edge) / edge.lengthSquared())
+                                 : 0;
+        const Vector normal = kept.normal + weight * (removed.normal - kept.normal);
+        kept.normal = normal.lengthSquared() > 0 ? normal.normalized() : kept.normal;
+        kept.texcoords = kept.texcoords + weight * (removed.texcoords - kept.texcoords);
+        kept.position = collapse.target;
+
+        m_quadrics[keep] += m_quadrics[remove];
+        m_vertexRemoved[remove] = true;
+        m_versions[keep]++;
+        m_versions[remove]++;
+
+        std::vector<int> neighbors;
+        for (int t : m_adjacency[keep]) {
+            for (int corner = 0; corner < 3; corner++) {
+                if (m_triangles[t][corner] != keep)
+                    neighbors.push_back(m_triangles[t][corner]);
+            }
+        }
+        std::sort(neighbors.begin(), neighbors.end());
+        neighbors.erase(std::unique(neighbors.begin(), neighbors.end()), neighbors.end());
+        for (int neighbor : neighbors)
+            enqueue(keep, neighbor);
+    }
+
+    /// @brief Copies the current state of the mesh, without collapsed triangles and unreferenced vertices.
+    SimplifiedMesh snapshot() const {
+        std::vector<int> remap(m_vertices.size(), -1);
+        SimplifiedMesh result;
+        std::vector<Vertex> &vertices = result.vertices;
+        std::vector<Vector3i> &triangles = result.triangles;
+        triangles.reserve(m_triangleCount);
+        for (int t = 0; t < int(m_triangles.size()); t++) {
+            if (m_triangleRemoved[t])
+                continue;
+            Vector3i indices = m_triangles[t];
+            for (int corner = 0; corner < 3; corner++) {
+                int &index = remap[indices[corner]];
+                if (index < 0) {
+                    index = int(vertices.size());
+                    vertices.push_back(m_vertices[indices[corner]]);
+                }
+                indices[corner] = index;
+            }
+            triangles.push_back(indices);
+        }
+        return result;
+    }
+
+public:
+    Simplifier(const std::vector<Vector3i> &triangles, const std::vector<Vertex> &vertices)
+        : m_triangles(triangles), m_vertices(vertices) {}
+
+    std::vector<SimplifiedMesh> run(const std::vector<int> &targetTriangleCounts) {
+        m_triangleCount = int(m_triangles.size());
+        m_triangleRemoved.assign(m_triangles.size(), false);
+        m_vertexRemoved.assign(m_vertices.size(), false);
+        m_versions.assign(m_vertices.size(), 0);
+        m_adjacency.assign(m_vertices.size(), {});
+        for (int t = 0; t < int(m_triangles.size()); t++) {
+            for (int corner = 0; corner < 3; corner++)
+                m_adjacency[m_triangles[t][corner]].push_back(t);
+        }
+
+        initialize();
+
+        std::vector<SimplifiedMesh> result;
+        for (int targetTriangleCount : targetTriangleCounts) {
+            while (m_triangleCount > targetTriangleCount && !m_queue.empty()) {
+                const Collapse candidate = m_queue.top();
+                m_queue.pop();
+                if (m_vertexRemoved[candidate.keep] || m_vertexRemoved[candidate.remove] ||
+                    m_versions[candidate.keep] != candidate.keepVersion ||
+                    m_versions[candidate.remove] != candidate.removeVersion)
+                    continue;
+                if (!preservesOrientation(candidate.keep, candidate.remove, candidate.target) ||
+                    !preservesOrientation(candidate.remove, candidate.keep, candidate.target))
+                    continue;
+                collapse(candidate);
+            }
+            result.push_back(snapshot());
+        }
+        return result;
+    }
+};
+
+}
+
+std::vector<SimplifiedMesh> simplifyMesh(const std::vector<Vector3i> &triangles, const std::vector<Vertex> &vertices,
+                                         const std::vector<int> &targetTriangleCounts) {
+    return Simplifier(triangles, vertices).run(targetTriangleCounts);
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <lightwave/core.hpp>
+#include <lightwave/math.hpp>
+
+#include <vector>
+
+namespace lightwave {
+
+/// @brief The index and vertex buffers of a simplified mesh.
+struct SimplifiedMesh {
+    std::vector<Vector3i> triangles;
+    std::vector<Vertex> vertices;
+};
+
+/**
+ * @brief Simplifies a triangle mesh by repeatedly collapsing the edge whose removal changes the surface the least, as
+ * measured by the quadric error metric (Garland and Heckbert, "Surface Simplification Using Quadric Error Metrics").
+ * - Open boundaries (including seams at which vertices are split due to differing attributes) are preserved by
+ *   penalizing any movement away from them.
+ * - Collapses that would flip triangles are rejected.
+ * - Normals and texture coordinates are interpolated along the collapsed edges.
+ *
+ * @param targetTriangleCounts The numbers of triangles (in decreasing order) for which a copy of the mesh is taken
+ * while it is being simplified, which yields all levels of detail at the cost of simplifying the mesh once.
+ * @return One simplified mesh per target. Meshes keep more triangles than targeted if they cannot be simplified
+ * further without flipping triangles.
+ */
+std::vector<SimplifiedMesh> simplifyMesh(const std::vector<Vector3i> &triangles, const std::vector<Vertex> &vertices,
+                                         const std::vector<int> &targetTriangleCounts);
+
+}
@@ -16,7 +16,7 @@ namespace lightwave
             surf.frame = Frame(normal);
 
             // since we sample the area uniformly, the pdf is given by 1/surfaceArea
-            surf.pdf = 0;
+            surf.pdf = Inv4Pi;
         }
         inline Point2 sphere_uv_coord(const Vector &hitpoint) const
         {
@@ -75,11 +75,15 @@ namespace lightwave
                 }
             }
             its.t = t0;
-            Point position = ray(its.t);
-            populate(its, position);
+            its.shape = this;
             return true;
         }
 
+        void computeSurfaceInteraction(const Ray &ray, Intersection &its) const override
+        {
+            populate(its, ray(its.t));
+        }
+
         Bounds
         getBoundingBox() const override
         {
@@ -104,7 +108,6 @@ namespace lightwave
             AreaSample result;
             result.position = samplePoint;
             populate(result, samplePoint);
-            result.pdf = 1.0 / (4.0 * Pi);
             return result;
         }
 
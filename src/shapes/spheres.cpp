@@ -0,0 +1,294 @@
+#include <lightwave.hpp>
+
+#include "../core/mappedfile.hpp"
+#include "../core/plyparser.hpp"
+#include "accel.hpp"
+
+#include <cstring>
+#include <mutex>
+
+namespace lightwave
+{
+
+    /**
+     * @brief A large set of spheres (e.g., particles or the points of a point cloud), which are stored in a single
+     * shape instead of one instanced @ref Sphere per particle.
+     * The centers and radii are read from a PLY file (using the "x", "y", "z" and optional "radius" properties of its
+     * vertices) or from a binary file consisting of four floats (x, y, z, radius) per sphere.
+     * PLY files can also give each sphere a color (using the "red", "green" and "blue" properties), which tints the
+     * material and emission of the spheres.
+     */
+    class Spheres : public AccelerationStructure
+    {
+        /// @brief The number of spheres that are tested for intersection at once, which matches the maximum size of
+        /// BVH leaves.
+        static constexpr int BatchSize = 8;
+        /// @brief The minimum distance of intersections, to avoid self intersections.
+        static constexpr float MinDistance = 1e-4f;
+
+        /**
+         * @brief The centers and radii of the spheres, stored as one array per component so that batches of spheres
+         * can be intersected with SIMD instructions.
+         * The spheres are ordered like the leaves of the BVH, and each array is padded so that full batches can be
+         * read at the end.
+         */
+        std::vector<float> m_centerX;
+        std::vector<float> m_centerY;
+        std::vector<float> m_centerZ;
+        std::vector<float> m_radius;
+        /// @brief The color of each sphere (in the same order), or empty if the spheres are not colored.
+        std::vector<Color> m_color;
+        /// @brief The number of spheres (excluding padding).
+        int m_count;
+        /// @brief The file the spheres were loaded from, for logging and debugging purposes.
+        std::filesystem::path m_originalPath;
+        /// @brief Picks spheres proportional to their surface area for @ref sampleArea , which is only built once the
+        /// spheres are sampled (as it would waste memory for the many sphere sets that do not emit light).
+        mutable AliasTable m_areaDistribution;
+        mutable std::once_flag m_areaDistributionBuilt;
+        /// @brief The total surface area of all spheres.
+        double m_totalArea = 0;
+
+        /// @brief Reads a binary file of (x, y, z, radius) tuples.
+        static void readBinary(const std::filesystem::path &path, std::vector<Point> &centers,
+                               std::vector<float> &radii)
+        {
+            logger(EInfo, "loading points %s", path);
+            const MappedFile file(path);
+            constexpr size_t Stride = 4 * sizeof(float);
+            if (file.size() % Stride != 0)
+                lightwave_throw("%s does not consist of (x, y, z, radius) tuples", path);
+
+            const size_t count = file.size() / Stride;
+            centers.resize(count);
+            radii.resize(count);
+            for (size_t i = 0; i < count; i++)
+            {
+                float values[4];
+                std::memcpy(values, file.data() + i * Stride, Stride);
+                centers[i] = { values[0], values[1], values[2] };
+                radii[i] = values[3];
+            }
+        }
+
+        Point center(int index) const
+        {
+            return { m_centerX[index], m_centerY[index], m_centerZ[index] };
+        }
+
+        /// @brief Computes the texture coordinates for a normal, matching the parametrization of @ref Sphere .
+        static Point2 sphereUv(const Vector &normal)
+        {
+            const float theta = atan2f(normal.x(), normal.z());
+            const float phi = safe_acos(normal.y());
+            return { (theta + Pi) / (2 * Pi), phi / Pi };
+        }
+
+        /**
+         * @brief Intersects a batch of up to @c BatchSize spheres that are contiguous in memory.
+         * The distances of all spheres are computed without any branches, which allows the compiler to process the
+         * spheres in SIMD registers. Only the closest hits are then processed one by one (e.g., for alpha masking).
+         */
+        bool intersectBatch(int first, int count, const Ray &ray, Intersection &its, Sampler &rng) const
+        {
+            const float *centerX = m_centerX.data() + first;
+            const float *centerY = m_centerY.data() + first;
+            const float *centerZ = m_centerZ.data() + first;
+            const float *radius = m_radius.data() + first;
+
+            const float dx = ray.direction.x();
+            const float dy = ray.direction.y();
+            const float dz = ray.direction.z();
+            const float a = dx * dx + dy * dy + dz * dz;
+            const float invA = 1 / a;
+
+            float hitT[BatchSize];
+            for (int lane = 0; lane < BatchSize; lane++)
+            {
+                const float ox = ray.origin.x() - centerX[lane];
+                const float oy = ray.origin.y() - centerY[lane];
+                const float oz = ray.origin.z() - centerZ[lane];
+                const float b = ox * dx + oy * dy + oz * dz;
+                // the distance of the center to the ray is computed explicitly, which avoids the cancellation of the
+                // textbook discriminant for small and distant spheres
+                const float px = ox - b * invA * dx;
+                const float py = oy - b * invA * dy;
+                const float pz = oz - b * invA * dz;
+                const float discriminant = a * (radius[lane] * radius[lane] - (px * px + py * py + pz * pz));
+                const float root = std::sqrt(std::max(discriminant, 0.f));
+                const float tNear = (-b - root) * invA;
+                const float tFar = (-b + root) * invA;
+                const float t = tNear >= MinDistance ? tNear : tFar;
+                hitT[lane] = lane < count && discriminant >= 0 && t >= MinDistance ? t : Infinity;
+            }
+
+            bool wasIntersected = false;
+            for (int lane = 0; lane < count; lane++)
+            {
+                if (!(hitT[lane] < its.t))
+                    continue;
+                if (its.alphaMasking)
+                {
+                    const Vector normal = (ray(hitT[lane]) - center(first + lane)).normalized();
+                    if (its.alphaMasking->scalar(sphereUv(normal)) < rng.next())
+                        continue;
+                }
+                // the shading frame and texture coordinates are only computed for the closest hit
+                its.t = hitT[lane];
+                its.shape = this;
+                its.primitiveIndex = first + lane;
+                wasIntersected = true;
+            }
+            return wasIntersected;
+        }
+
+    protected:
+        int numberOfPrimitives() const override
+        {
+            return m_count;
+        }
+
+        int maxLeafSize() const override
+        {
+            return BatchSize;
+        }
+
+        bool intersectLeaf(std::span<const int> primitiveIndices, const Ray &ray, Intersection &its,
+                           Sampler &rng) const override
+        {
+            // the spheres are stored in leaf order, hence the spheres of a leaf are contiguous
+            const int first = primitiveIndices.front();
+            const int count = int(primitiveIndices.size());
+            bool wasIntersected = false;
+            // leaves can exceed the batch size if their spheres cannot be separated
+            for (int offset = 0; offset < count; offset += BatchSize)
+            {
+                wasIntersected |= intersectBatch(first + offset, min(BatchSize, count - offset), ray, its, rng);
+            }
+            return wasIntersected;
+        }
+
+        bool intersect(int primitiveIndex, const Ray &ray, Intersection &its, Sampler &rng) const override
+        {
+            return intersectBatch(primitiveIndex, 1, ray, its, rng);
+        }
+
+        Bounds getBoundingBox(int primitiveIndex) const override
+        {
+            const Vector extent = Vector(std::abs(m_radius[primitiveIndex]));
+            return Bounds(center(primitiveIndex) - extent, center(primitiveIndex) + extent);
+        }
+
+        Point getCentroid(int primitiveIndex) const override
+        {
+            return center(primitiveIndex);
+        }
+
+    public:
+        Spheres(const Properties &properties)
+        {
+            m_originalPath = properties.get<std::filesystem::path>("filename");
+            const float defaultRadius = properties.get<float>("radius", 1);
+
+            std::vector<Point> centers;
+            std::vector<float> radii;
+            std::vector<Color> colors;
+            if (m_originalPath.extension() == ".ply")
+                readPLYPoints(m_originalPath, centers, radii, colors);
+            else
+                readBinary(m_originalPath, centers, radii);
+            if (radii.empty())
+                radii.resize(centers.size(), defaultRadius);
+            if (centers.size() > size_t(std::numeric_limits<int>::max()) - BatchSize)
+                lightwave_throw("%s contains too many spheres", m_originalPath);
+            m_count = int(centers.size());
+
+            const auto fill = [&](const auto &order)
+            {
+                const size_t paddedSize = size_t(m_count) + BatchSize - 1;
+                m_centerX.assign(paddedSize, 0);
+                m_centerY.assign(paddedSize, 0);
+                m_centerZ.assign(paddedSize, 0);
+                m_radius.assign(paddedSize, 0);
+                m_color.resize(colors.size());
+                for (int i = 0; i < m_count; i++)
+                {
+                    const int source = order(i);
+                    m_centerX[i] = centers[source].x();
+                    m_centerY[i] = centers[source].y();
+                    m_centerZ[i] = centers[source].z();
+                    m_radius[i] = radii[source];
+                    if (!colors.empty())
+                        m_color[i] = colors[source];
+                }
+            };
+
+            fill([](int i)
+                 { return i; });
+            buildAccelerationStructure();
+            // store the spheres in the order of the BVH leaves, so that the spheres of each leaf can be read at once
+            const std::span<const int> order = leafOrder();
+            fill([&](int i)
+                 { return order[i]; });
+            adoptLeafOrder();
+            for (int i = 0; i < m_count; i++)
+            {
+                m_totalArea += 4 * Pi * sqr(m_radius[i]);
+            }
+            logger(EInfo, "loaded %d spheres", m_count);
+        }
+
+        void computeSurfaceInteraction(const Ray &ray, Intersection &its) const override
+        {
+            its.position = ray(its.t);
+            const Vector normal = (its.position - center(its.primitiveIndex)).normalized();
+            its.frame = Frame(normal);
+            its.uv = sphereUv(normal);
+            its.pdf = float(1 / m_totalArea); // same as sampleArea
+            if (!m_color.empty())
+                its.tint = Vector(m_color[its.primitiveIndex].data());
+        }
+
+        AreaSample sampleArea(Sampler &rng) const override
+        {
+            if (!(m_totalArea > 0))
+                return AreaSample::invalid();
+            std::call_once(m_areaDistributionBuilt, [&]
+                           {
+                std::vector<float> areas(m_count);
+                for (int i = 0; i < m_count; i++)
+                {
+                    areas[i] = 4 * Pi * sqr(m_radius[i]);
+                }
+                m_areaDistribution = AliasTable(areas); });
+
+            const int index = m_areaDistribution.sample(rng.next());
+            const Vector normal = squareToUniformSphere(rng.next2D());
+            AreaSample result;
+            result.position = center(index) + std::abs(m_radius[index]) * normal;
+            result.frame = Frame(normal);
+            result.uv = sphereUv(normal);
+            // spheres are picked proportional to their area, hence all points on the set are equally likely
+            result.pdf = float(1 / m_totalArea);
+            if (!m_color.empty())
+                result.tint = Vector(m_color[index].data());
+            return result;
+        }
+
+        std::string toString() const override
+        {
+            return tfm::format(
+                "Spheres[\n"
+                "  count = %d,\n"
+                "  colored = %s,\n"
+                "  filename = \"%s\"\n"
+                "]",
+                m_count,
+                m_color.empty() ? "false" : "true",
+                m_originalPath.generic_string());
+        }
+    };
+
+}
+
+REGISTER_SHAPE(Spheres, "spheres")
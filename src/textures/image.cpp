@@ -55,7 +55,9 @@ namespace lightwave
             auto u = uv.x();
             auto v = (1 - uv.y());
             Color c;
-            Point2i im_res = m_image->resolution();
+            // the pixels are read through a const reference, so that images shared with the asset cache are not copied
+            const Image &image = *m_image;
+            Point2i im_res = image.resolution();
 
             if (m_filter == FilterMode::Nearest)
             {
@@ -78,7 +80,7 @@ namespace lightwave
                 lattice_uv.x() = min(floor(bordered_cord.x()), im_res.x() - 1);
                 lattice_uv.y() = min(floor(bordered_cord.y()), im_res.y() - 1);
 
-                c = (*m_image)(lattice_uv);
+                c = image(lattice_uv);
                 c *= m_exposure;
             }
             else
@@ -117,15 +119,20 @@ namespace lightwave
                     lv1 = lv1 - floor(lv1 / im_res.y()) * im_res.y();
                 }
 
-                c = (1 - fu) * (1 - fv) * (*m_image)(lattice_cord) +
-                    (1 - fu) * fv * (*m_image)(Point2i(lattice_cord.x(), lv1)) +
-                    fu * (1 - fv) * (*m_image)(Point2i(lu1, lattice_cord.y())) +
-                    fu * fv * (*m_image)(Point2i(lu1, lv1));
+                c = (1 - fu) * (1 - fv) * image(lattice_cord) +
+                    (1 - fu) * fv * image(Point2i(lattice_cord.x(), lv1)) +
+                    fu * (1 - fv) * image(Point2i(lu1, lattice_cord.y())) +
+                    fu * fv * image(Point2i(lu1, lv1));
                 c *= m_exposure;
             }
             return c;
         }
 
+        Point2i resolution() const override
+        {
+            return m_image->resolution();
+        }
+
         std::string toString() const override
         {
             return tfm::format("ImageTexture[\n"
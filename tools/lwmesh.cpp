@@ -0,0 +1,51 @@
+#include <lightwave/core.hpp>
+#include <lightwave/logger.hpp>
+
+#include "../src/shapes/lwmesh.hpp"
+
+#include <string>
+#include <vector>
+
+using namespace lightwave;
+
+void print_exception(const std::exception &e, int level = 0) {
+    logger(EError, "%s%s", std::string(2 * level, ' '), e.what());
+    try {
+        std::rethrow_if_nested(e);
+    } catch(const std::exception& nestedException) {
+        print_exception(nestedException, level + 1);
+    } catch(...) {}
+}
+
+/// @brief Converts PLY files into .lwmesh files, which are written next to them (or to the given output path).
+int main(int argc, const char *argv[]) {
+    if (argc < 2) {
+        logger(EError, "usage: lwmesh <mesh.ply>...  or  lwmesh -o <output.lwmesh> <mesh.ply>");
+        return -1;
+    }
+
+    std::vector<std::pair<std::filesystem::path, std::filesystem::path>> conversions;
+    if (std::string(argv[1]) == "-o") {
+        if (argc != 4) {
+            logger(EError, "usage: lwmesh -o <output.lwmesh> <mesh.ply>");
+            return -1;
+        }
+        conversions.emplace_back(argv[3], argv[2]);
+    } else {
+        for (int i = 1; i < argc; i++) {
+            const std::filesystem::path input = argv[i];
+            conversions.emplace_back(input, std::filesystem::path(input).replace_extension(".lwmesh"));
+        }
+    }
+
+    int result = 0;
+    for (const auto &[input, output] : conversions) {
+        try {
+            convertToLwMesh(input, output);
+        } catch (const std::exception &e) {
+            print_exception(e);
+            result = 1;
+        }
+    }
+    return result;
+}